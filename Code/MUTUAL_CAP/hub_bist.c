@@ -0,0 +1,215 @@
+/*******************************************************************************
+* File Name:   hub_bist.c
+*
+* Description: Background CAPSENSE built-in self-test, see hub_bist.h
+*
+*******************************************************************************/
+#include "cy_pdl.h"
+#include "cycfg_capsense.h"
+#include "hub_bist.h"
+
+static hub_regmap_t *bist_map;
+static uint16_t bist_interval = HUB_BIST_INTERVAL;
+static uint16_t bist_frames;
+static bool bist_pending;
+
+/* Electrode under test, and the results of the pass in progress */
+static uint32_t bist_widget;
+static uint32_t bist_eltd;
+static uint16_t bist_flags[NUM_OF_SENSORS];
+static uint16_t bist_cp[NUM_OF_SENSORS];
+
+#if (CY_CAPSENSE_BIST_EN)
+/*******************************************************************************
+* Function Name: bist_record
+********************************************************************************
+* Summary:
+*  Adds the result of one electrode to the sensors it belongs to. In
+*  one-dimensional widgets each electrode is one sensor; in CSX and matrix
+*  widgets an electrode is shared, so its result applies to every sensor of
+*  the widget and the largest electrode Cp is kept.
+*
+*******************************************************************************/
+static void bist_record(const cy_stc_capsense_widget_config_t *wd, uint16_t flags, uint16_t cp)
+{
+	uint32_t first = (uint32_t)(wd->ptrSnsContext - cy_capsense_tuner.sensorContext);
+	uint32_t count = wd->numSns;
+
+	if(0u == wd->numRows)
+	{
+		first += bist_eltd;
+		count = 1u;
+	}
+
+	for(uint32_t i = first; (i < (first + count)) && (i < NUM_OF_SENSORS); i++)
+	{
+		bist_flags[i] |= flags;
+		if(cp > bist_cp[i])
+		{
+			bist_cp[i] = cp;
+		}
+	}
+}
+
+/*******************************************************************************
+* Function Name: bist_publish
+********************************************************************************
+* Summary:
+*  Copies the results of a finished pass into the register map and rebuilds
+*  the health bitmap, then starts the next pass from scratch.
+*
+*******************************************************************************/
+static void bist_publish(void)
+{
+	uint32_t health = 0u;
+
+	for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+	{
+		bist_map->sensor[i].bist = bist_flags[i];
+		bist_map->sensor[i].cp = bist_cp[i];
+		if((i < 32u) && (HUB_BIST_TESTED == bist_flags[i]))
+		{
+			health |= (1uL << i);
+		}
+		bist_flags[i] = 0u;
+		bist_cp[i] = 0u;
+	}
+
+	bist_map->stats.health = health;
+	if(bist_map->stats.bist_passes < UINT16_MAX)
+	{
+		bist_map->stats.bist_passes++;
+	}
+}
+
+#endif /* CY_CAPSENSE_BIST_EN */
+
+/*******************************************************************************
+* Function Name: hub_bist_init
+********************************************************************************
+* Summary:
+*  Sets up the register map pointer, no sensor counts as healthy before the
+*  first pass has finished.
+*
+*******************************************************************************/
+void hub_bist_init(hub_regmap_t *map)
+{
+	bist_map = map;
+	bist_map->stats.health = 0u;
+}
+
+/*******************************************************************************
+* Function Name: hub_bist_set_interval
+********************************************************************************
+* Summary:
+*  Changes the step interval. Disabling drops a pending step, but keeps the
+*  results of the pass in progress.
+*
+*******************************************************************************/
+void hub_bist_set_interval(uint16_t frames)
+{
+	bist_interval = frames;
+	bist_frames = 0u;
+	if(0u == frames)
+	{
+		bist_pending = false;
+	}
+}
+
+/*******************************************************************************
+* Function Name: hub_bist_frame
+********************************************************************************
+* Summary:
+*  Called for every published frame, schedules a step every bist_interval
+*  frames.
+*
+*******************************************************************************/
+bool hub_bist_frame(void)
+{
+#if (CY_CAPSENSE_BIST_EN)
+	if(0u != bist_interval)
+	{
+		bist_frames++;
+		if(bist_frames >= bist_interval)
+		{
+			bist_frames = 0u;
+			bist_pending = true;
+		}
+	}
+#endif
+	return bist_pending;
+}
+
+/*******************************************************************************
+* Function Name: hub_bist_pending
+********************************************************************************
+* Summary:
+*  Reports whether a step waits for its slot.
+*
+*******************************************************************************/
+bool hub_bist_pending(void)
+{
+	return bist_pending;
+}
+
+/*******************************************************************************
+* Function Name: hub_bist_step
+********************************************************************************
+* Summary:
+*  Tests the current electrode and advances to the next one. Must only be
+*  called while no scan is running; the next regular scan reconfigures the
+*  hardware for sensing.
+*
+*******************************************************************************/
+void hub_bist_step(void)
+{
+#if (CY_CAPSENSE_BIST_EN)
+	const cy_stc_capsense_widget_config_t *wd = &cy_capsense_context.ptrWdConfig[bist_widget];
+	uint16_t flags = HUB_BIST_TESTED;
+	uint16_t cp = 0u;
+
+#if (CY_CAPSENSE_TST_WDGT_CRC_EN)
+	if((0u == bist_eltd) && (CY_CAPSENSE_BIST_SUCCESS_E != Cy_CapSense_CheckCRCWidget(bist_widget, &cy_capsense_context)))
+	{
+		flags |= HUB_BIST_CRC_FAIL;
+	}
+#endif
+
+#if (CY_CAPSENSE_TST_SNS_SHORT_EN)
+	if(CY_CAPSENSE_BIST_SUCCESS_E != Cy_CapSense_CheckIntegritySensorPins(bist_widget, bist_eltd, &cy_capsense_context))
+	{
+		flags |= HUB_BIST_SHORT;
+	}
+#endif
+
+#if (CY_CAPSENSE_TST_ELTD_CAP_EN)
+	if(CY_CAPSENSE_BIST_SUCCESS_E == Cy_CapSense_MeasureCapacitanceSensorElectrode(bist_widget, bist_eltd, &cy_capsense_context))
+	{
+		/* Measured in fF, published in 10 fF steps */
+		uint32_t cp_10ff = wd->ptrEltdCapacitance[bist_eltd] / 10u;
+		cp = (cp_10ff > UINT16_MAX) ? UINT16_MAX : (uint16_t)cp_10ff;
+	}
+	else
+	{
+		flags |= HUB_BIST_CP_FAIL;
+	}
+#endif
+
+	bist_record(wd, flags, cp);
+	bist_pending = false;
+
+	bist_eltd++;
+	if(bist_eltd >= ((uint32_t)wd->numCols + wd->numRows))
+	{
+		bist_eltd = 0u;
+		bist_widget++;
+		if(bist_widget >= CY_CAPSENSE_WIDGET_COUNT)
+		{
+			bist_widget = 0u;
+			bist_publish();
+		}
+	}
+#else
+	bist_pending = false;
+#endif
+}
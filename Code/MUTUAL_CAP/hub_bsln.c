@@ -0,0 +1,119 @@
+/*******************************************************************************
+* File Name:   hub_bsln.c
+*
+* Description: Host control of the CAPSENSE baselines, see hub_bsln.h
+*
+*******************************************************************************/
+#include "cy_pdl.h"
+#include "cycfg_capsense.h"
+#include "hub_bsln.h"
+
+#define BSLN_FLAGS				(HUB_STATUS_BSLN_FROZEN | HUB_STATUS_BSLN_RESET | \
+								 HUB_STATUS_BSLN_CONVERGING | HUB_STATUS_BSLN_CONVERGED)
+
+static bool bsln_frozen;
+static bool bsln_reset_pending;
+static uint16_t bsln_converge_frames;
+static uint16_t bsln_flags;		/* BSLN_FLAGS of the frame being processed */
+
+/*******************************************************************************
+* Function Name: hub_bsln_init
+********************************************************************************
+* Summary:
+*  Starts the power-up converge window.
+*
+*******************************************************************************/
+void hub_bsln_init(hub_regmap_t *map)
+{
+	(void)map;
+	bsln_converge_frames = HUB_BSLN_CONVERGE_FRAMES;
+}
+
+/*******************************************************************************
+* Function Name: hub_bsln_freeze
+********************************************************************************
+* Summary:
+*  Stops or resumes baseline tracking from the next frame on.
+*
+*******************************************************************************/
+void hub_bsln_freeze(bool freeze)
+{
+	bsln_frozen = freeze;
+}
+
+/*******************************************************************************
+* Function Name: hub_bsln_reset
+********************************************************************************
+* Summary:
+*  Requests a baseline reset. It is done on the next finished scan, so the
+*  baselines start from fresh raw counts.
+*
+*******************************************************************************/
+void hub_bsln_reset(void)
+{
+	bsln_reset_pending = true;
+}
+
+/*******************************************************************************
+* Function Name: hub_bsln_converge
+********************************************************************************
+* Summary:
+*  Starts a new converge window, 0 ends a running one.
+*
+*******************************************************************************/
+void hub_bsln_converge(uint16_t frames)
+{
+	bsln_converge_frames = frames;
+}
+
+/*******************************************************************************
+* Function Name: hub_bsln_frame
+********************************************************************************
+* Summary:
+*  Called with every finished scan before processing. Resets take effect
+*  even while the baselines are frozen. The baseline flags of the frame are
+*  kept until hub_bsln_flags() adds them when the frame is published.
+*
+*******************************************************************************/
+uint32_t hub_bsln_frame(void)
+{
+	uint16_t flags = 0u;
+
+	if(bsln_reset_pending || (0u != bsln_converge_frames))
+	{
+		(void)Cy_CapSense_InitializeAllBaselines(&cy_capsense_context);
+		if(bsln_reset_pending)
+		{
+			flags |= HUB_STATUS_BSLN_RESET;
+			bsln_reset_pending = false;
+		}
+		if(0u != bsln_converge_frames)
+		{
+			flags |= HUB_STATUS_BSLN_CONVERGING;
+			bsln_converge_frames--;
+		}
+	}
+	if(0u == (flags & HUB_STATUS_BSLN_CONVERGING))
+	{
+		flags |= HUB_STATUS_BSLN_CONVERGED;
+	}
+	if(bsln_frozen)
+	{
+		flags |= HUB_STATUS_BSLN_FROZEN;
+	}
+	bsln_flags = flags;
+
+	return bsln_frozen ? (CY_CAPSENSE_PROCESS_ALL & (uint32_t)~CY_CAPSENSE_PROCESS_BASELINE) : CY_CAPSENSE_PROCESS_ALL;
+}
+
+/*******************************************************************************
+* Function Name: hub_bsln_flags
+********************************************************************************
+* Summary:
+*  Replaces the baseline flags in the flags of the frame being published.
+*
+*******************************************************************************/
+uint16_t hub_bsln_flags(uint16_t frame_flags)
+{
+	return (uint16_t)((frame_flags & (uint16_t)~BSLN_FLAGS) | bsln_flags);
+}
@@ -0,0 +1,367 @@
+/*******************************************************************************
+* File Name:   hub_cal.c
+*
+* Description: Calibration cache and readiness, see hub_cal.h
+*
+*******************************************************************************/
+#include <stdbool.h>
+#include <string.h>
+#include "cy_pdl.h"
+#include "cycfg_capsense.h"
+#include "hub_bsln.h"
+#include "hub_cal.h"
+#include "hub_crc.h"
+#include "hub_irq.h"
+#include "hub_settings.h"
+#include "hub_time.h"
+
+#define CAL_MAGIC				(0x4343u)	/* "CC" */
+
+/* Flags a valid frame needs, and flags it must not have */
+#define CAL_VALID_SET			(HUB_STATUS_INIT_OK | HUB_STATUS_CAL_OK | HUB_STATUS_BSLN_CONVERGED)
+#define CAL_VALID_CLEAR			(HUB_STATUS_SCAN_ERROR | HUB_STATUS_OVERFLOW)
+
+/* Stored cache: header, baselines, widget contexts */
+typedef struct
+{
+	uint16_t magic;			/* CAL_MAGIC */
+	uint16_t config;		/* CRC of the generated widget contexts the cache belongs to */
+	uint16_t size;			/* bytes after the header */
+	uint16_t crc;			/* CRC-16/CCITT of the bytes after the header */
+} cal_header_t;
+
+/* Baselines of all frequency channels */
+#define CAL_SENSORS				(NUM_OF_SENSORS * HUB_HOP_CHANNELS)
+#define CAL_BSLN_SIZE			(sizeof(uint16_t) * CAL_SENSORS)
+#define CAL_WIDGET_SIZE			(sizeof(cy_capsense_tuner.widgetContext))
+#define CAL_SIZE				(sizeof(cal_header_t) + CAL_BSLN_SIZE + CAL_WIDGET_SIZE)
+#define CAL_ROWS				((CAL_SIZE + CY_FLASH_SIZEOF_ROW - 1u) / CY_FLASH_SIZEOF_ROW)
+
+CY_SECTION(".cy_em_eeprom") CY_ALIGN(CY_FLASH_SIZEOF_ROW)
+static const volatile uint8_t cal_storage[CAL_ROWS * CY_FLASH_SIZEOF_ROW] = {0u};
+
+static hub_regmap_t *cal_map;
+static uint16_t cal_config;
+static uint8_t cal_state;
+static bool cal_ready;
+
+/* INIT_OK and CAL_OK of the last CAPSENSE start */
+static uint16_t cal_flags;
+
+/* The last stall recovery started from the cache */
+static bool cal_recovered;
+
+/* Baselines of a restored cache, applied after Cy_CapSense_Enable() */
+static uint16_t cal_bsln[CAL_SENSORS];
+
+/*******************************************************************************
+* Function Name: cal_read
+********************************************************************************
+* Summary:
+*  Copies stored bytes out of flash and adds them to a running CRC.
+*
+*******************************************************************************/
+static uint16_t cal_read(uint8_t *dst, uint32_t offset, uint32_t len, uint16_t crc)
+{
+	for(uint32_t i = 0; i < len; i++)
+	{
+		dst[i] = cal_storage[offset + i];
+	}
+	return hub_crc16_update(crc, dst, len);
+}
+
+/*******************************************************************************
+* Function Name: cal_check
+********************************************************************************
+* Summary:
+*  Checks the stored cache against the running configuration and copies its
+*  baselines to cal_bsln. The widget contexts are only checked, a failed
+*  check must not leave parts of them behind.
+*
+*******************************************************************************/
+static bool cal_check(void)
+{
+	cal_header_t header;
+	uint8_t chunk[16];
+	uint16_t crc;
+
+	(void)cal_read((uint8_t *)&header, 0u, sizeof(header), 0u);
+	if((CAL_MAGIC != header.magic) || (cal_config != header.config) ||
+	   ((CAL_SIZE - sizeof(cal_header_t)) != header.size))
+	{
+		return false;
+	}
+
+	crc = cal_read((uint8_t *)cal_bsln, sizeof(header), CAL_BSLN_SIZE, 0xFFFFu);
+	for(uint32_t offset = 0; offset < CAL_WIDGET_SIZE; offset += sizeof(chunk))
+	{
+		uint32_t len = CAL_WIDGET_SIZE - offset;
+
+		crc = cal_read(chunk, sizeof(header) + CAL_BSLN_SIZE + offset,
+					   (len > sizeof(chunk)) ? sizeof(chunk) : len, crc);
+	}
+	return (crc == header.crc);
+}
+
+/*******************************************************************************
+* Function Name: cal_load
+********************************************************************************
+* Summary:
+*  Copies the checked widget parameters of the cache into the widget
+*  contexts.
+*
+*******************************************************************************/
+static void cal_load(void)
+{
+	uint8_t *dst = (uint8_t *)cy_capsense_tuner.widgetContext;
+
+	for(uint32_t i = 0; i < CAL_WIDGET_SIZE; i++)
+	{
+		dst[i] = cal_storage[sizeof(cal_header_t) + CAL_BSLN_SIZE + i];
+	}
+#if (CY_CAPSENSE_BIST_EN) && (CY_CAPSENSE_TST_WDGT_CRC_EN)
+	/* Keep the self-test from reporting the restored parameters as corrupted */
+	Cy_CapSense_UpdateAllWidgetCrc(&cy_capsense_context);
+#endif
+}
+
+/*******************************************************************************
+* Function Name: cal_status
+********************************************************************************
+* Summary:
+*  Takes INIT_OK and CAL_OK from the status of a CAPSENSE start. A failed
+*  calibration still leaves a working CAPSENSE, any other error does not.
+*
+*******************************************************************************/
+static void cal_status(uint32_t capsense_status)
+{
+	cal_flags = 0u;
+	if(0u == (capsense_status & (uint32_t)~CY_CAPSENSE_STATUS_CALIBRATION_FAIL))
+	{
+		cal_flags = HUB_STATUS_INIT_OK;
+		if(0u == (capsense_status & CY_CAPSENSE_STATUS_CALIBRATION_FAIL))
+		{
+			cal_flags |= HUB_STATUS_CAL_OK;
+		}
+	}
+}
+
+/*******************************************************************************
+* Function Name: cal_apply
+********************************************************************************
+* Summary:
+*  Sets the baselines of a restored cache and ends the converge window.
+*
+*******************************************************************************/
+static void cal_apply(void)
+{
+	for(uint32_t i = 0; i < CAL_SENSORS; i++)
+	{
+		cy_capsense_tuner.sensorContext[i].bsln = cal_bsln[i];
+	}
+	hub_bsln_converge(0u);
+}
+
+/*******************************************************************************
+* Function Name: hub_cal_restore
+********************************************************************************
+* Summary:
+*  Takes the fingerprint of the generated configuration and, in power-gated
+*  mode, loads the widget parameters of a matching cache.
+*
+*******************************************************************************/
+void hub_cal_restore(void)
+{
+	cal_config = hub_crc16((const uint8_t *)cy_capsense_tuner.widgetContext, CAL_WIDGET_SIZE);
+	cal_state = HUB_CAL_NONE;
+
+	if(!cal_check())
+	{
+		return;
+	}
+	cal_state = HUB_CAL_STORED;
+	if(HUB_POWER_GATED != hub_settings.power)
+	{
+		return;
+	}
+	cal_load();
+	cal_state = HUB_CAL_RESTORED;
+}
+
+/*******************************************************************************
+* Function Name: hub_cal_recover
+********************************************************************************
+* Summary:
+*  Loads the widget parameters of a matching cache after a stall, in either
+*  power mode. The fingerprint is taken again, the scan parameters may have
+*  changed since boot (see hub_tune.h).
+*
+*******************************************************************************/
+void hub_cal_recover(void)
+{
+	cal_config = hub_crc16((const uint8_t *)cy_capsense_tuner.widgetContext, CAL_WIDGET_SIZE);
+	cal_recovered = cal_check();
+	if(cal_recovered)
+	{
+		cal_load();
+	}
+}
+
+/*******************************************************************************
+* Function Name: hub_cal_init
+********************************************************************************
+* Summary:
+*  Applies the cached baselines and ends the converge window after a
+*  restore, and publishes the power mode and the cache state.
+*
+*******************************************************************************/
+void hub_cal_init(hub_regmap_t *map, uint32_t capsense_status)
+{
+	cal_map = map;
+	cal_status(capsense_status);
+	cal_map->status.flags |= cal_flags;
+	cal_map->stats.power = hub_settings.power;
+	cal_map->stats.cal_state = cal_state;
+
+	if(HUB_CAL_RESTORED == cal_state)
+	{
+		cal_apply();
+	}
+}
+
+/*******************************************************************************
+* Function Name: hub_cal_resume
+********************************************************************************
+* Summary:
+*  Like hub_cal_init() after a stall recovery. Without a cache the baselines
+*  come from the recalibrated sensors and converge like after power-up.
+*
+*******************************************************************************/
+void hub_cal_resume(uint32_t capsense_status)
+{
+	cal_status(capsense_status);
+	if(cal_recovered)
+	{
+		cal_apply();
+	}
+	else
+	{
+		hub_bsln_converge(HUB_BSLN_CONVERGE_FRAMES);
+	}
+}
+
+/*******************************************************************************
+* Function Name: hub_cal_frame
+********************************************************************************
+* Summary:
+*  The first frame outside of the power-up converge window makes the hub
+*  ready and stamps the boot time. Every frame gets its validity flag.
+*  Takes the flags of the frame being published and returns them completed,
+*  the caller stores them.
+*
+*******************************************************************************/
+uint16_t hub_cal_frame(uint16_t frame_flags)
+{
+	uint16_t flags = (uint16_t)((frame_flags &
+								 (uint16_t)~(HUB_STATUS_FRAME_VALID | HUB_STATUS_INIT_OK | HUB_STATUS_CAL_OK)) | cal_flags);
+
+	if(!cal_ready && (0u != (flags & HUB_STATUS_BSLN_CONVERGED)))
+	{
+		cal_ready = true;
+		cal_map->stats.boot_us = hub_time_cycles_to_us(hub_time_cycles());
+		flags |= HUB_STATUS_READY;
+	}
+	if((CAL_VALID_SET == (flags & CAL_VALID_SET)) && (0u == (flags & CAL_VALID_CLEAR)))
+	{
+		flags |= HUB_STATUS_FRAME_VALID;
+	}
+	return flags;
+}
+
+/*******************************************************************************
+* Function Name: hub_cal_set_power
+********************************************************************************
+* Summary:
+*  Stores the power mode of the next boots in the working settings.
+*
+*******************************************************************************/
+uint8_t hub_cal_set_power(uint8_t mode)
+{
+	if(mode > HUB_POWER_GATED)
+	{
+		return HUB_RESULT_BAD_ARG;
+	}
+	hub_settings.power = mode;
+	return HUB_RESULT_OK;
+}
+
+/*******************************************************************************
+* Function Name: hub_cal_save
+********************************************************************************
+* Summary:
+*  Writes header, baselines and widget contexts to flash, one row at a time
+*  through a row buffer.
+*
+*******************************************************************************/
+uint8_t hub_cal_save(void)
+{
+	uint16_t bsln[CAL_SENSORS];
+	cal_header_t header;
+	uint32_t row[CY_FLASH_SIZEOF_ROW / sizeof(uint32_t)];
+	uint8_t *row_bytes = (uint8_t *)row;
+	uint32_t fill = 0u;
+	uint32_t addr = (uint32_t)&cal_storage[0];
+
+	if(!cal_ready)
+	{
+		return HUB_RESULT_FAILED;
+	}
+
+	for(uint32_t i = 0; i < CAL_SENSORS; i++)
+	{
+		bsln[i] = cy_capsense_tuner.sensorContext[i].bsln;
+	}
+	header.magic = CAL_MAGIC;
+	header.config = cal_config;
+	header.size = (uint16_t)(CAL_SIZE - sizeof(header));
+	header.crc = hub_crc16_update(hub_crc16((const uint8_t *)bsln, CAL_BSLN_SIZE),
+										 (const uint8_t *)cy_capsense_tuner.widgetContext, CAL_WIDGET_SIZE);
+
+	const struct
+	{
+		const uint8_t *data;
+		uint32_t size;
+	} part[] =
+	{
+		{ (const uint8_t *)&header, sizeof(header) },
+		{ (const uint8_t *)bsln, CAL_BSLN_SIZE },
+		{ (const uint8_t *)cy_capsense_tuner.widgetContext, CAL_WIDGET_SIZE },
+	};
+
+	memset(row, 0, sizeof(row));
+	for(uint32_t p = 0; p < (sizeof(part) / sizeof(part[0])); p++)
+	{
+		for(uint32_t i = 0; i < part[p].size; i++)
+		{
+			row_bytes[fill++] = part[p].data[i];
+			if(CY_FLASH_SIZEOF_ROW == fill)
+			{
+				if(CY_FLASH_DRV_SUCCESS != hub_irq_flash_write_row(addr, row))
+				{
+					return HUB_RESULT_FAILED;
+				}
+				addr += CY_FLASH_SIZEOF_ROW;
+				fill = 0u;
+				memset(row, 0, sizeof(row));
+			}
+		}
+	}
+	if((0u != fill) && (CY_FLASH_DRV_SUCCESS != hub_irq_flash_write_row(addr, row)))
+	{
+		return HUB_RESULT_FAILED;
+	}
+
+	cal_state = (HUB_CAL_RESTORED == cal_state) ? HUB_CAL_RESTORED : HUB_CAL_STORED;
+	cal_map->stats.cal_state = cal_state;
+	return HUB_RESULT_OK;
+}
@@ -0,0 +1,245 @@
+/*******************************************************************************
+* File Name:   hub_cmd.c
+*
+* Description: Host command dispatcher, see hub_cmd.h
+*
+*******************************************************************************/
+#include "cy_pdl.h"
+#include "hub_bist.h"
+#include "hub_boot.h"
+#include "hub_bsln.h"
+#include "hub_cal.h"
+#include "hub_cmd.h"
+#include "hub_filter.h"
+#include "hub_noise.h"
+#include "hub_rate.h"
+#include "hub_rec.h"
+#include "hub_scan.h"
+#include "hub_settings.h"
+#include "hub_trace.h"
+#include "hub_tune.h"
+#include "hub_xtalk.h"
+
+/* Highest tuner address that still leaves room for the data address */
+#define HUB_I2C_ADDR_MIN		(0x08u)
+#define HUB_I2C_ADDR_MAX		(0x76u)
+
+/*******************************************************************************
+* Function Name: cmd_set_i2c_addr
+********************************************************************************
+* Summary:
+*  Stores a new tuner / data address pair in the working settings.
+*
+*******************************************************************************/
+static uint8_t cmd_set_i2c_addr(const hub_ctrl_t *ctrl)
+{
+	uint8_t addr = ctrl->arg[0];
+
+	if((0u != addr) && ((addr < HUB_I2C_ADDR_MIN) || (addr > HUB_I2C_ADDR_MAX)))
+	{
+		return HUB_RESULT_BAD_ARG;
+	}
+	hub_settings.i2c_addr = addr;
+	return HUB_RESULT_OK;
+}
+
+/*******************************************************************************
+* Function Name: cmd_set_sensor_mask
+********************************************************************************
+* Summary:
+*  Switches to a new sensor enable mask and keeps it in the working settings.
+*
+*******************************************************************************/
+static uint8_t cmd_set_sensor_mask(const hub_ctrl_t *ctrl)
+{
+	uint32_t mask = (uint32_t)ctrl->arg[0] | ((uint32_t)ctrl->arg[1] << 8) |
+					((uint32_t)ctrl->arg[2] << 16) | ((uint32_t)ctrl->arg[3] << 24);
+
+	if(!hub_scan_set_mask(mask))
+	{
+		return HUB_RESULT_BAD_ARG;
+	}
+	hub_settings.sensor_mask = mask;
+	return HUB_RESULT_OK;
+}
+
+/*******************************************************************************
+* Function Name: cmd_set_scan_rate
+********************************************************************************
+* Summary:
+*  Sets the scan dividers of a range of sensors. Nothing changes unless the
+*  whole range is valid.
+*
+*******************************************************************************/
+static uint8_t cmd_set_scan_rate(const hub_ctrl_t *ctrl)
+{
+	uint32_t first = ctrl->arg[0];
+	uint32_t count = ctrl->arg[1];
+
+	if((0u == count) || (count > (HUB_CTRL_ARG_SIZE - 2u)) || ((first + count) > NUM_OF_SENSORS))
+	{
+		return HUB_RESULT_BAD_ARG;
+	}
+	for(uint32_t i = 0; i < count; i++)
+	{
+		if(0u == ctrl->arg[2u + i])
+		{
+			return HUB_RESULT_BAD_ARG;
+		}
+	}
+	for(uint32_t i = 0; i < count; i++)
+	{
+		(void)hub_scan_set_divider(first + i, ctrl->arg[2u + i]);
+	}
+	return HUB_RESULT_OK;
+}
+
+/*******************************************************************************
+* Function Name: hub_cmd_execute
+********************************************************************************
+* Summary:
+*  Dispatches the command written by the host. The result is written before
+*  the command register is cleared, so a host polling ctrl.cmd always reads
+*  the matching result.
+*
+*******************************************************************************/
+void hub_cmd_execute(hub_ctrl_t *ctrl)
+{
+	uint8_t result;
+
+	switch(ctrl->cmd)
+	{
+		case HUB_CMD_RESET:
+			NVIC_SystemReset();
+			break;
+
+		case HUB_CMD_SAVE_SETTINGS:
+			result = hub_settings_save() ? HUB_RESULT_OK : HUB_RESULT_FAILED;
+			break;
+
+		case HUB_CMD_SET_I2C_ADDR:
+			result = cmd_set_i2c_addr(ctrl);
+			break;
+
+		case HUB_CMD_SET_BIST:
+			hub_bist_set_interval((uint16_t)(ctrl->arg[0] | ((uint16_t)ctrl->arg[1] << 8)));
+			result = HUB_RESULT_OK;
+			break;
+
+		case HUB_CMD_SET_SENSOR_MASK:
+			result = cmd_set_sensor_mask(ctrl);
+			break;
+
+		case HUB_CMD_SET_SCAN_RATE:
+			result = cmd_set_scan_rate(ctrl);
+			break;
+
+		case HUB_CMD_SET_ADAPTIVE:
+			result = hub_rate_configure((uint16_t)(ctrl->arg[0] | ((uint16_t)ctrl->arg[1] << 8)),
+										(uint16_t)(ctrl->arg[2] | ((uint16_t)ctrl->arg[3] << 8)),
+										(uint16_t)(ctrl->arg[4] | ((uint16_t)ctrl->arg[5] << 8)))
+					 ? HUB_RESULT_OK : HUB_RESULT_BAD_ARG;
+			break;
+
+		case HUB_CMD_SET_FILTER:
+			result = hub_filter_configure(ctrl->arg[0],
+										  (uint32_t)ctrl->arg[1] | ((uint32_t)ctrl->arg[2] << 8) |
+										  ((uint32_t)ctrl->arg[3] << 16) | ((uint32_t)ctrl->arg[4] << 24))
+					 ? HUB_RESULT_OK : HUB_RESULT_BAD_ARG;
+			break;
+
+		case HUB_CMD_SET_XTALK:
+			result = ((ctrl->arg[1] <= ((HUB_CTRL_ARG_SIZE - 2u) / 2u)) &&
+					  hub_xtalk_set(ctrl->arg[0], ctrl->arg[1], &ctrl->arg[2]))
+					 ? HUB_RESULT_OK : HUB_RESULT_BAD_ARG;
+			break;
+
+		case HUB_CMD_BSLN_FREEZE:
+			hub_bsln_freeze(0u != ctrl->arg[0]);
+			result = HUB_RESULT_OK;
+			break;
+
+		case HUB_CMD_BSLN_RESET:
+			hub_bsln_reset();
+			result = HUB_RESULT_OK;
+			break;
+
+		case HUB_CMD_BSLN_CONVERGE:
+			hub_bsln_converge((uint16_t)(ctrl->arg[0] | ((uint16_t)ctrl->arg[1] << 8)));
+			result = HUB_RESULT_OK;
+			break;
+
+		case HUB_CMD_REC_CONFIG:
+			if(hub_rec_configure(0u != ctrl->arg[0], ctrl->arg[1]))
+			{
+				hub_settings.recorder = (uint8_t)(((0u != ctrl->arg[0]) ? 0x80u : 0u) | ctrl->arg[1]);
+				result = HUB_RESULT_OK;
+			}
+			else
+			{
+				result = HUB_RESULT_BAD_ARG;
+			}
+			break;
+
+		case HUB_CMD_REC_READ:
+			result = hub_rec_read((uint16_t)(ctrl->arg[0] | ((uint16_t)ctrl->arg[1] << 8)))
+					 ? HUB_RESULT_OK : HUB_RESULT_BAD_ARG;
+			break;
+
+		case HUB_CMD_BOOT_BEGIN:
+			result = hub_boot_begin((uint16_t)(ctrl->arg[0] | ((uint16_t)ctrl->arg[1] << 8)));
+			break;
+
+		case HUB_CMD_BOOT_WRITE:
+			result = hub_boot_write();
+			break;
+
+		case HUB_CMD_BOOT_COMMIT:
+			/* Resets into the new firmware on success */
+			result = hub_boot_commit();
+			break;
+
+		case HUB_CMD_SET_POWER:
+			result = hub_cal_set_power(ctrl->arg[0]);
+			break;
+
+		case HUB_CMD_CAL_SAVE:
+			result = hub_cal_save();
+			break;
+
+		case HUB_CMD_TUNE:
+			result = hub_tune_start((uint16_t)(ctrl->arg[0] | ((uint16_t)ctrl->arg[1] << 8)),
+									(uint16_t)(ctrl->arg[2] | ((uint16_t)ctrl->arg[3] << 8)));
+			break;
+
+		case HUB_CMD_NOISE:
+			result = hub_noise_start((uint16_t)(ctrl->arg[0] | ((uint16_t)ctrl->arg[1] << 8)),
+									 (uint16_t)(ctrl->arg[2] | ((uint16_t)ctrl->arg[3] << 8)));
+			break;
+
+		case HUB_CMD_NOISE_SAVE:
+			result = hub_noise_save();
+			break;
+
+		case HUB_CMD_TRACE:
+			result = hub_trace_configure(ctrl->arg[0],
+										 (uint32_t)ctrl->arg[1] | ((uint32_t)ctrl->arg[2] << 8) |
+										 ((uint32_t)ctrl->arg[3] << 16) | ((uint32_t)ctrl->arg[4] << 24));
+			break;
+
+		case HUB_CMD_TRACE_READ:
+			result = hub_trace_read((uint16_t)(ctrl->arg[0] | ((uint16_t)ctrl->arg[1] << 8)));
+			break;
+
+		case HUB_CMD_BOOT_ABORT:
+			result = hub_boot_abort();
+			break;
+
+		default:
+			result = HUB_RESULT_BAD_CMD;
+			break;
+	}
+
+	ctrl->result = result;
+	ctrl->cmd = HUB_CMD_NONE;
+}
@@ -0,0 +1,16 @@
+/*******************************************************************************
+* File Name:   hub_cmd.h
+*
+* Description: Executes host commands written to the control window of the
+* register map. The opcodes and arguments are documented in hub_regmap.h.
+*
+*******************************************************************************/
+#ifndef HUB_CMD_H
+#define HUB_CMD_H
+
+#include "hub_regmap.h"
+
+/* Runs the command in ctrl->cmd, sets ctrl->result and clears ctrl->cmd */
+void hub_cmd_execute(hub_ctrl_t *ctrl);
+
+#endif /* HUB_CMD_H */
@@ -0,0 +1,21 @@
+/*******************************************************************************
+* File Name:   hub_config.h
+*
+* Description: Build-time options of the Sensor Hub firmware. Override them
+* with DEFINES in the Makefile, e.g. DEFINES+=HUB_TUNER_ENABLE=0, or pick a
+* PROFILE there.
+*
+*******************************************************************************/
+#ifndef HUB_CONFIG_H
+#define HUB_CONFIG_H
+
+/* 1: expose cy_capsense_tuner on the first EZI2C address and run the Tuner
+ *    protocol once a Tuner has accessed it.
+ * 0: production build, no Tuner interface; the register map moves to the
+ *    only EZI2C address and Cy_CapSense_RunTuner is never called.
+ */
+#ifndef HUB_TUNER_ENABLE
+#define HUB_TUNER_ENABLE		(1u)
+#endif
+
+#endif /* HUB_CONFIG_H */
@@ -0,0 +1,40 @@
+/*******************************************************************************
+* File Name:   hub_crc.c
+*
+* Description: CRC-16/CCITT, see hub_crc.h
+*
+*******************************************************************************/
+#include "hub_crc.h"
+
+/*******************************************************************************
+* Function Name: hub_crc16_update
+********************************************************************************
+* Summary:
+*  Bitwise CRC-16/CCITT (poly 0x1021), small and fast enough for the few
+*  hundred bytes it covers at a time.
+*
+*******************************************************************************/
+uint16_t hub_crc16_update(uint16_t crc, const uint8_t *data, uint32_t len)
+{
+	for(uint32_t i = 0; i < len; i++)
+	{
+		crc ^= (uint16_t)((uint16_t)data[i] << 8);
+		for(uint32_t bit = 0; bit < 8u; bit++)
+		{
+			crc = (0u != (crc & 0x8000u)) ? (uint16_t)((crc << 1) ^ 0x1021u) : (uint16_t)(crc << 1);
+		}
+	}
+	return crc;
+}
+
+/*******************************************************************************
+* Function Name: hub_crc16
+********************************************************************************
+* Summary:
+*  CRC-16/CCITT with init 0xFFFF.
+*
+*******************************************************************************/
+uint16_t hub_crc16(const uint8_t *data, uint32_t len)
+{
+	return hub_crc16_update(0xFFFFu, data, len);
+}
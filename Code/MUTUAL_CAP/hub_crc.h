@@ -0,0 +1,19 @@
+/*******************************************************************************
+* File Name:   hub_crc.h
+*
+* Description: CRC-16/CCITT (poly 0x1021, init 0xFFFF) shared by the stored
+* settings and calibration, the firmware update rows and the SPI frames.
+*
+*******************************************************************************/
+#ifndef HUB_CRC_H
+#define HUB_CRC_H
+
+#include <stdint.h>
+
+/* CRC-16/CCITT of a block */
+uint16_t hub_crc16(const uint8_t *data, uint32_t len);
+
+/* Continues a CRC-16/CCITT over more data, for data in several pieces */
+uint16_t hub_crc16_update(uint16_t crc, const uint8_t *data, uint32_t len);
+
+#endif /* HUB_CRC_H */
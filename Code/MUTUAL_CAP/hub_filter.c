@@ -0,0 +1,211 @@
+/*******************************************************************************
+* File Name:   hub_filter.c
+*
+* Description: Spike rejection on the raw counts, see hub_filter.h
+*
+*******************************************************************************/
+#include "cy_pdl.h"
+#include "cycfg_capsense.h"
+#include "hub_filter.h"
+#include "hub_scan.h"
+
+#define FILTER_HISTORY			(4u)
+
+static hub_regmap_t *filter_map;
+static uint8_t filter_mode = HUB_FILTER_MODE;
+static uint32_t filter_mask = HUB_SENSOR_MASK_ALL;
+
+/* Previous raw counts per sensor, newest first. A sensor is primed once its
+ * history holds real samples.
+ */
+static uint16_t filter_history[NUM_OF_SENSORS][FILTER_HISTORY];
+static bool filter_primed[NUM_OF_SENSORS];
+
+#define SORT2(a, b)				do { if((a) > (b)) { uint16_t t_ = (a); (a) = (b); (b) = t_; } } while(0)
+
+/*******************************************************************************
+* Function Name: median3
+********************************************************************************
+* Summary:
+*  Median of three values.
+*
+*******************************************************************************/
+static uint16_t median3(uint16_t a, uint16_t b, uint16_t c)
+{
+	SORT2(a, b);
+	SORT2(b, c);
+	SORT2(a, b);
+	return b;
+}
+
+/*******************************************************************************
+* Function Name: median5
+********************************************************************************
+* Summary:
+*  Median of five values with a partial sorting network (7 compares).
+*
+*******************************************************************************/
+static uint16_t median5(uint16_t a, uint16_t b, uint16_t c, uint16_t d, uint16_t e)
+{
+	SORT2(a, b);
+	SORT2(d, e);
+	SORT2(a, d);	/* a is the smallest of a, b, d, e: out */
+	SORT2(b, e);	/* e is the largest of b, d, e: out */
+	SORT2(b, c);
+	SORT2(c, d);
+	SORT2(b, c);
+	return c;
+}
+
+/*******************************************************************************
+* Function Name: abs_diff
+********************************************************************************
+* Summary:
+*  Distance of two raw counts.
+*
+*******************************************************************************/
+static uint16_t abs_diff(uint16_t a, uint16_t b)
+{
+	return (a > b) ? (uint16_t)(a - b) : (uint16_t)(b - a);
+}
+
+/*******************************************************************************
+* Function Name: hampel
+********************************************************************************
+* Summary:
+*  Replaces x by the window median if it is an outlier by the Hampel rule.
+*
+*******************************************************************************/
+static uint16_t hampel(uint16_t x, const uint16_t *h)
+{
+	uint16_t med = median5(x, h[0], h[1], h[2], h[3]);
+	uint16_t mad = median5(abs_diff(x, med), abs_diff(h[0], med), abs_diff(h[1], med),
+						   abs_diff(h[2], med), abs_diff(h[3], med));
+	uint32_t limit = ((uint32_t)mad * HUB_FILTER_HAMPEL_K_Q8) >> 8;
+
+	if(limit < HUB_FILTER_SPIKE_MIN)
+	{
+		limit = HUB_FILTER_SPIKE_MIN;
+	}
+	return (abs_diff(x, med) > limit) ? med : x;
+}
+
+/*******************************************************************************
+* Function Name: filter_sensor
+********************************************************************************
+* Summary:
+*  Runs the selected filter on one raw count and updates the history with the
+*  unfiltered value, so a rejected spike stays visible to the next frames as
+*  the outlier it was.
+*
+*******************************************************************************/
+static uint16_t filter_sensor(uint32_t i, uint16_t x)
+{
+	uint16_t *h = filter_history[i];
+	uint16_t y = x;
+
+	if(!filter_primed[i])
+	{
+		for(uint32_t k = 0; k < FILTER_HISTORY; k++)
+		{
+			h[k] = x;
+		}
+		filter_primed[i] = true;
+	}
+
+	switch(filter_mode)
+	{
+		case HUB_FILTER_MEDIAN3:
+			y = median3(x, h[0], h[1]);
+			break;
+		case HUB_FILTER_MEDIAN5:
+			y = median5(x, h[0], h[1], h[2], h[3]);
+			break;
+		case HUB_FILTER_HAMPEL:
+			y = hampel(x, h);
+			break;
+		default:
+			break;
+	}
+
+	h[3] = h[2];
+	h[2] = h[1];
+	h[1] = h[0];
+	h[0] = x;
+	return y;
+}
+
+/*******************************************************************************
+* Function Name: hub_filter_init
+********************************************************************************
+* Summary:
+*  Publishes the initial filter mode.
+*
+*******************************************************************************/
+void hub_filter_init(hub_regmap_t *map)
+{
+	filter_map = map;
+	filter_map->stats.filter = filter_mode;
+}
+
+/*******************************************************************************
+* Function Name: hub_filter_configure
+********************************************************************************
+* Summary:
+*  Switches the filter. The histories restart from the next sample, so an old
+*  history does not leak into the new filter.
+*
+*******************************************************************************/
+bool hub_filter_configure(uint8_t mode, uint32_t mask)
+{
+	if(mode > HUB_FILTER_HAMPEL)
+	{
+		return false;
+	}
+
+	filter_mode = mode;
+	filter_mask = mask;
+	for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+	{
+		filter_primed[i] = false;
+	}
+	filter_map->stats.filter = mode;
+	return true;
+}
+
+/*******************************************************************************
+* Function Name: hub_filter_frame
+********************************************************************************
+* Summary:
+*  Filters the raw counts in the sensor context in place, before processing,
+*  and counts the rejected spikes per sensor and in total.
+*
+*******************************************************************************/
+void hub_filter_frame(void)
+{
+	if(HUB_FILTER_OFF == filter_mode)
+	{
+		return;
+	}
+
+	for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+	{
+		if(!hub_scan_sensor_updated(i) || ((i < 32u) && (0u == (filter_mask & (1uL << i)))))
+		{
+			continue;
+		}
+
+		cy_stc_capsense_sensor_context_t *sns = &cy_capsense_tuner.sensorContext[i];
+		uint16_t y = filter_sensor(i, sns->raw);
+
+		if(abs_diff(y, sns->raw) > HUB_FILTER_SPIKE_MIN)
+		{
+			if(filter_map->sensor[i].rejects < UINT16_MAX)
+			{
+				filter_map->sensor[i].rejects++;
+			}
+			filter_map->stats.rejects++;
+		}
+		sns->raw = y;
+	}
+}
@@ -0,0 +1,115 @@
+/*******************************************************************************
+* File Name:   hub_hop.c
+*
+* Description: Frequency hopping, see hub_hop.h
+*
+*******************************************************************************/
+#include "cy_pdl.h"
+#include "cycfg_capsense.h"
+#include "hub_hop.h"
+#include "hub_scan.h"
+
+_Static_assert((1u == HUB_HOP_CHANNELS) || (3u == HUB_HOP_CHANNELS), "The median fusion needs three frequency channels");
+
+static hub_regmap_t *hop_map;
+
+#if (HUB_HOP_CHANNELS > 1u)
+/*******************************************************************************
+* Function Name: hop_delta
+********************************************************************************
+* Summary:
+*  Raw count minus baseline of a sensor in one frequency channel. The
+*  middleware keeps the channels one sensor count apart.
+*
+*******************************************************************************/
+static int32_t hop_delta(uint32_t sensor, uint32_t channel)
+{
+	const cy_stc_capsense_sensor_context_t *sns = &cy_capsense_tuner.sensorContext[sensor + (channel * NUM_OF_SENSORS)];
+
+	return (int32_t)sns->raw - (int32_t)sns->bsln;
+}
+
+/*******************************************************************************
+* Function Name: hop_outlier
+********************************************************************************
+* Summary:
+*  The channel furthest from the median of the three, HUB_HOP_NONE if all
+*  are within HUB_HOP_REJECT_MIN of it.
+*
+*******************************************************************************/
+static uint16_t hop_outlier(uint32_t sensor)
+{
+	int32_t d[HUB_HOP_CHANNELS];
+	int32_t lo;
+	int32_t hi;
+	int32_t med;
+	uint16_t outlier = HUB_HOP_NONE;
+	int32_t worst = (int32_t)HUB_HOP_REJECT_MIN;
+
+	for(uint32_t ch = 0; ch < HUB_HOP_CHANNELS; ch++)
+	{
+		d[ch] = hop_delta(sensor, ch);
+	}
+	lo = (d[0] < d[1]) ? d[0] : d[1];
+	hi = (d[0] < d[1]) ? d[1] : d[0];
+	med = (d[2] < lo) ? lo : ((d[2] > hi) ? hi : d[2]);
+
+	for(uint32_t ch = 0; ch < HUB_HOP_CHANNELS; ch++)
+	{
+		int32_t dist = (d[ch] > med) ? (d[ch] - med) : (med - d[ch]);
+
+		if(dist > worst)
+		{
+			worst = dist;
+			outlier = (uint16_t)(ch + 1u);
+		}
+	}
+	return outlier;
+}
+#endif
+
+/*******************************************************************************
+* Function Name: hub_hop_init
+********************************************************************************
+* Summary:
+*  Publishes the number of frequency channels and clears the rejections.
+*
+*******************************************************************************/
+void hub_hop_init(hub_regmap_t *map)
+{
+	hop_map = map;
+	hop_map->stats.hop_channels = (uint8_t)HUB_HOP_CHANNELS;
+	for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+	{
+		hop_map->sensor[i].hop = HUB_HOP_NONE;
+	}
+}
+
+/*******************************************************************************
+* Function Name: hub_hop_frame
+********************************************************************************
+* Summary:
+*  Called after processing, when the baselines of all channels are updated.
+*  Sensors not scanned in the frame keep their last result.
+*
+*******************************************************************************/
+void hub_hop_frame(void)
+{
+#if (HUB_HOP_CHANNELS > 1u)
+	for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+	{
+		if(!hub_scan_sensor_updated(i))
+		{
+			continue;
+		}
+
+		uint16_t outlier = hop_outlier(i);
+
+		if((HUB_HOP_NONE != outlier) && (hop_map->stats.hop_rejects[outlier - 1u] < UINT16_MAX))
+		{
+			hop_map->stats.hop_rejects[outlier - 1u]++;
+		}
+		hop_map->sensor[i].hop = outlier;
+	}
+#endif
+}
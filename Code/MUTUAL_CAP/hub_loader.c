@@ -0,0 +1,305 @@
+/*******************************************************************************
+* File Name:   hub_loader.c
+*
+* Description: Resident install stage of the firmware updater, see
+* hub_loader.h. Everything here is placed in the .hub_loader section.
+*
+*******************************************************************************/
+#include <stddef.h>
+#include "cy_pdl.h"
+#include "hub_boot.h"
+#include "hub_loader.h"
+
+#if HUB_BOOT_ENABLE
+
+#define LOADER_CODE				CY_SECTION(".hub_loader.text")
+
+/* SROM system calls of the flash programming interface. Cy_Flash_WriteRow()
+ * lives in the application flash the loader overwrites.
+ */
+#define SROM_KEY1				(0xB6u)
+#define SROM_KEY2(opcode)		((uint32_t)(0xD3u + (opcode)) << 8)
+#define SROM_LOAD_LATCH			(0x04u)
+#define SROM_WRITE_ROW			(0x05u)
+#define SROM_STATUS_MASK		(0xF0000000u)
+#define SROM_STATUS_OK			(0xA0000000u)
+#define SROM_RETRIES			(3u)
+
+/* Full copies of a job before the loader gives up and resets */
+#define LOADER_PASSES			(3u)
+
+extern uint32_t __StackTop;
+
+/* Boot area, zero (no job) in a freshly programmed part */
+CY_SECTION(".hub_boot.job") CY_ALIGN(CY_FLASH_SIZEOF_ROW)
+const volatile hub_loader_job_t hub_loader_job = {0u};
+
+CY_SECTION(".hub_boot.carry") CY_ALIGN(CY_FLASH_SIZEOF_ROW)
+const volatile uint8_t hub_loader_carry[HUB_LOADER_CARRY_ROWS * HUB_LOADER_ROW] = {0u};
+
+LOADER_CODE static void loader_reset(void);
+LOADER_CODE static void loader_fault(void);
+
+/* Vector table at address 0. Only the reset and the fault vectors are ever
+ * taken, no interrupt is enabled while the loader runs.
+ */
+CY_SECTION(".hub_loader.vectors")
+const uintptr_t hub_loader_vectors[4] =
+{
+	(uintptr_t)&__StackTop,
+	(uintptr_t)&loader_reset,
+	(uintptr_t)&loader_fault,	/* NMI */
+	(uintptr_t)&loader_fault,	/* HardFault */
+};
+
+/*******************************************************************************
+* Function Name: hub_loader_crc32
+********************************************************************************
+* Summary:
+*  Bitwise CRC-32 (IEEE, reflected), no table in flash.
+*
+*******************************************************************************/
+LOADER_CODE uint32_t hub_loader_crc32(const volatile uint8_t *data, uint32_t len)
+{
+	uint32_t crc = 0xFFFFFFFFu;
+
+	for(uint32_t i = 0; i < len; i++)
+	{
+		crc ^= data[i];
+		for(uint32_t bit = 0; bit < 8u; bit++)
+		{
+			crc = (0u != (crc & 1u)) ? ((crc >> 1) ^ 0xEDB88320u) : (crc >> 1);
+		}
+	}
+	return ~crc;
+}
+
+/*******************************************************************************
+* Function Name: loader_system_reset
+********************************************************************************
+* Summary:
+*  Requests a system reset. NVIC_SystemReset() is not guaranteed to be
+*  inlined into this section.
+*
+*******************************************************************************/
+LOADER_CODE static void loader_system_reset(void)
+{
+	__DSB();
+	SCB->AIRCR = (0x5FAuL << SCB_AIRCR_VECTKEY_Pos) | SCB_AIRCR_SYSRESETREQ_Msk;
+	__DSB();
+	for(;;)
+	{
+	}
+}
+
+/*******************************************************************************
+* Function Name: loader_fault
+********************************************************************************
+* Summary:
+*  A fault in the loader resets the part, the next boot retries the job.
+*
+*******************************************************************************/
+LOADER_CODE static void loader_fault(void)
+{
+	loader_system_reset();
+}
+
+/*******************************************************************************
+* Function Name: row_equal
+********************************************************************************
+* Summary:
+*  Compares a flash row with len bytes of data followed by zeros; data may be
+*  NULL.
+*
+*******************************************************************************/
+LOADER_CODE static bool row_equal(uint32_t addr, const volatile uint8_t *data, uint32_t len)
+{
+	const volatile uint8_t *flash = (const volatile uint8_t *)(uintptr_t)addr;
+
+	for(uint32_t i = 0; i < HUB_LOADER_ROW; i++)
+	{
+		if(flash[i] != ((i < len) ? data[i] : 0u))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/*******************************************************************************
+* Function Name: srom_write_row
+********************************************************************************
+* Summary:
+*  Writes one flash row through the SROM: loads the page latch from a
+*  parameter block on the stack, then erases and programs the row. len bytes
+*  come from data, the rest of the row is zero; data may be NULL.
+*
+*******************************************************************************/
+LOADER_CODE static bool srom_write_row(uint32_t addr, const volatile uint8_t *data, uint32_t len)
+{
+	uint32_t params[2u + (HUB_LOADER_ROW / sizeof(uint32_t))];
+	volatile uint8_t *latch = (volatile uint8_t *)&params[2];
+
+	for(uint32_t i = 0; i < HUB_LOADER_ROW; i++)
+	{
+		latch[i] = (i < len) ? data[i] : 0u;
+	}
+
+	params[0] = SROM_KEY1 | SROM_KEY2(SROM_LOAD_LATCH);		/* flash macro 0 */
+	params[1] = HUB_LOADER_ROW - 1u;
+	CPUSS->SYSARG = (uint32_t)params;
+	CPUSS->SYSREQ = CPUSS_SYSREQ_SYSCALL_REQ_Msk | SROM_LOAD_LATCH;
+	__NOP();
+	if(SROM_STATUS_OK != (CPUSS->SYSARG & SROM_STATUS_MASK))
+	{
+		return false;
+	}
+
+	params[0] = SROM_KEY1 | SROM_KEY2(SROM_WRITE_ROW) | (((addr - CY_FLASH_BASE) / HUB_LOADER_ROW) << 16);
+	CPUSS->SYSARG = (uint32_t)params;
+	CPUSS->SYSREQ = CPUSS_SYSREQ_SYSCALL_REQ_Msk | SROM_WRITE_ROW;
+	__NOP();
+	return (SROM_STATUS_OK == (CPUSS->SYSARG & SROM_STATUS_MASK));
+}
+
+/*******************************************************************************
+* Function Name: install_rows
+********************************************************************************
+* Summary:
+*  Writes size bytes of data (NULL: zeros) from addr on, row by row. Rows
+*  that already hold the data are skipped, which makes a repeated install
+*  cost only the rows a power loss left unwritten.
+*
+*******************************************************************************/
+LOADER_CODE static void install_rows(uint32_t addr, const volatile uint8_t *data, uint32_t size)
+{
+	for(uint32_t offset = 0; offset < size; offset += HUB_LOADER_ROW)
+	{
+		const volatile uint8_t *row = (NULL != data) ? &data[offset] : NULL;
+		uint32_t len = (NULL != data) ? (size - offset) : 0u;
+
+		if(len > HUB_LOADER_ROW)
+		{
+			len = HUB_LOADER_ROW;
+		}
+		for(uint32_t i = 0; (i < SROM_RETRIES) && !row_equal(addr + offset, row, len); i++)
+		{
+			(void)srom_write_row(addr + offset, row, len);
+		}
+	}
+}
+
+/*******************************************************************************
+* Function Name: range_ok
+********************************************************************************
+* Summary:
+*  A job range lies in the application region and is made of whole rows.
+*
+*******************************************************************************/
+LOADER_CODE static bool range_ok(uint32_t addr, uint32_t size)
+{
+	uint32_t start = (uint32_t)__hub_app_start;
+	uint32_t end = (uint32_t)__hub_app_end;
+
+	return (0u == (addr % HUB_LOADER_ROW)) && (addr >= start) && (addr <= end) && (size <= (end - addr));
+}
+
+/*******************************************************************************
+* Function Name: job_valid
+********************************************************************************
+* Summary:
+*  Checks the job row: magic, its own CRC, the ranges it writes and the
+*  staged image it copies.
+*
+*******************************************************************************/
+LOADER_CODE static bool job_valid(const volatile hub_loader_job_t *job)
+{
+	if((HUB_LOADER_MAGIC != job->magic) ||
+	   (hub_loader_crc32((const volatile uint8_t *)job, offsetof(hub_loader_job_t, check)) != job->check))
+	{
+		return false;
+	}
+	if(!range_ok(job->dst, job->size) || (0u != (job->size % HUB_LOADER_ROW)) ||
+	   (job->settings_size > sizeof(hub_loader_carry)) ||
+	   ((0u != job->settings_dst) && !range_ok(job->settings_dst, job->settings_size)) ||
+	   ((0u != job->clear_addr) && !range_ok(job->clear_addr, job->clear_size)))
+	{
+		return false;
+	}
+	return hub_loader_crc32((const volatile uint8_t *)(uintptr_t)job->src, job->size) == job->crc;
+}
+
+/*******************************************************************************
+* Function Name: loader_install
+********************************************************************************
+* Summary:
+*  Runs a valid job: image, settings, recorder rows, then checks the image
+*  in place. Returns when the installed image matches its CRC.
+*
+*******************************************************************************/
+LOADER_CODE static void loader_install(const volatile hub_loader_job_t *job)
+{
+	/* The install takes seconds, longer than the watchdog allows */
+	SRSS_WDT_DISABLE_KEY = CY_WDT_KEY;
+
+	for(uint32_t pass = 0; pass < LOADER_PASSES; pass++)
+	{
+		install_rows(job->dst, (const volatile uint8_t *)(uintptr_t)job->src, job->size);
+		if(0u != job->settings_dst)
+		{
+			install_rows(job->settings_dst, hub_loader_carry, job->settings_size);
+		}
+		if(0u != job->clear_addr)
+		{
+			install_rows(job->clear_addr, NULL, job->clear_size);
+		}
+		if(hub_loader_crc32((const volatile uint8_t *)(uintptr_t)job->dst, job->size) == job->crc)
+		{
+			return;
+		}
+	}
+
+	/* The flash does not take the image, start over from a clean reset */
+	loader_system_reset();
+}
+
+/*******************************************************************************
+* Function Name: loader_reset
+********************************************************************************
+* Summary:
+*  Reset handler of the part. Finishes a pending install job, erases it and
+*  resets into the new image, otherwise starts the application through its
+*  own vector table. A job that does not check out is erased unrun: it was
+*  torn by a power loss before the application was touched.
+*
+*******************************************************************************/
+LOADER_CODE static void loader_reset(void)
+{
+	const volatile hub_loader_job_t *job = &hub_loader_job;
+
+	if(0u != job->magic)
+	{
+		bool run = job_valid(job);
+
+		if(run)
+		{
+			loader_install(job);
+		}
+		install_rows((uint32_t)job, NULL, HUB_LOADER_ROW);
+		if(run)
+		{
+			loader_system_reset();
+		}
+	}
+
+	/* The application startup moves its vectors to SRAM (CPUSS_CONFIG
+	 * VECT_IN_RAM) and enables the interrupts itself.
+	 */
+	uint32_t sp = __hub_app_start[0];
+	uint32_t pc = __hub_app_start[1];
+
+	__set_MSP(sp);
+	((void (*)(void))(uintptr_t)pc)();
+}
+
+#endif /* HUB_BOOT_ENABLE */
@@ -0,0 +1,264 @@
+/*******************************************************************************
+* File Name:   hub_noise.c
+*
+* Description: Noise and SNR measurement, see hub_noise.h
+*
+*******************************************************************************/
+#include <stdbool.h>
+#include <string.h>
+#include "cy_pdl.h"
+#include "cycfg_capsense.h"
+#include "hub_noise.h"
+#include "hub_scan.h"
+#include "hub_settings.h"
+
+static hub_regmap_t *noise_map;
+static uint8_t noise_state;
+static hub_noise_store_t noise_result;
+
+/* Running sums per sensor, relative to its first raw count so the sums of
+ * squares stay small
+ */
+static uint16_t noise_n[NUM_OF_SENSORS];
+static uint16_t noise_first[NUM_OF_SENSORS];
+static uint16_t noise_min[NUM_OF_SENSORS];
+static uint16_t noise_max[NUM_OF_SENSORS];
+static int32_t noise_sum[NUM_OF_SENSORS];
+static uint64_t noise_sumsq[NUM_OF_SENSORS];
+
+/*******************************************************************************
+* Function Name: noise_isqrt
+********************************************************************************
+* Summary:
+*  Integer square root, bit by bit.
+*
+*******************************************************************************/
+static uint32_t noise_isqrt(uint64_t x)
+{
+	uint64_t root = 0u;
+	uint64_t bit = 1uLL << 62;
+
+	while(bit > x)
+	{
+		bit >>= 2;
+	}
+	while(0u != bit)
+	{
+		if(x >= (root + bit))
+		{
+			x -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+		{
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return (uint32_t)root;
+}
+
+/*******************************************************************************
+* Function Name: noise_signal
+********************************************************************************
+* Summary:
+*  Signal of a sensor: the one of the host, or 5/4 of the finger threshold
+*  of its widget.
+*
+*******************************************************************************/
+static uint32_t noise_signal(uint32_t sensor)
+{
+	if(0u != noise_result.signal)
+	{
+		return noise_result.signal;
+	}
+	for(uint32_t w = 0; w < CY_CAPSENSE_WIDGET_COUNT; w++)
+	{
+		const cy_stc_capsense_widget_config_t *wd = &cy_capsense_context.ptrWdConfig[w];
+		uint32_t first = (uint32_t)(wd->ptrSnsContext - cy_capsense_tuner.sensorContext);
+
+		if((sensor >= first) && (sensor < (first + wd->numSns)))
+		{
+			return ((uint32_t)cy_capsense_tuner.widgetContext[w].fingerTh * 5u) / 4u;
+		}
+	}
+	return 0u;
+}
+
+/*******************************************************************************
+* Function Name: noise_publish
+********************************************************************************
+* Summary:
+*  Copies the results into the sensor windows and the stats block.
+*
+*******************************************************************************/
+static void noise_publish(void)
+{
+	for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+	{
+		noise_map->sensor[i].noise_pp = noise_result.sensor[i].pp;
+		noise_map->sensor[i].noise_rms = noise_result.sensor[i].rms;
+		noise_map->sensor[i].snr = noise_result.sensor[i].snr;
+	}
+	noise_map->stats.noise_state = noise_state;
+	noise_map->stats.noise_frames = noise_result.frames;
+	noise_map->stats.noise_signal = noise_result.signal;
+}
+
+/*******************************************************************************
+* Function Name: noise_finish
+********************************************************************************
+* Summary:
+*  Computes the results of all measured sensors. RMS noise and SNR are
+*  published in tenths.
+*
+*******************************************************************************/
+static void noise_finish(void)
+{
+	for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+	{
+		hub_noise_result_t *r = &noise_result.sensor[i];
+		uint32_t n = noise_n[i];
+
+		memset(r, 0, sizeof(*r));
+		if(0u == n)
+		{
+			continue;
+		}
+
+		/* Variance * 100 = (sum of squares - sum^2 / n) * 100 / n */
+		uint64_t sq = (uint64_t)((int64_t)noise_sum[i] * noise_sum[i]) / n;
+		uint64_t var_x100 = ((noise_sumsq[i] - sq) * 100u) / n;
+		uint32_t rms = noise_isqrt(var_x100);
+		uint32_t pp = (uint32_t)noise_max[i] - noise_min[i];
+		uint32_t snr = (noise_signal(i) * 10u) / ((0u != pp) ? pp : 1u);
+
+		r->pp = (uint16_t)pp;
+		r->rms = (rms > UINT16_MAX) ? UINT16_MAX : (uint16_t)rms;
+		r->snr = (snr > UINT16_MAX) ? UINT16_MAX : (uint16_t)snr;
+	}
+	noise_state = HUB_NOISE_DONE;
+	noise_publish();
+}
+
+/*******************************************************************************
+* Function Name: hub_noise_init
+********************************************************************************
+* Summary:
+*  Publishes the results stored in the settings, if any. Call after
+*  hub_settings_load().
+*
+*******************************************************************************/
+void hub_noise_init(hub_regmap_t *map)
+{
+	noise_map = map;
+	noise_result = hub_settings.noise;
+	noise_state = (0u != noise_result.frames) ? HUB_NOISE_STORED : HUB_NOISE_IDLE;
+	noise_publish();
+}
+
+/*******************************************************************************
+* Function Name: hub_noise_start
+********************************************************************************
+* Summary:
+*  Clears the results and the sums, the measurement starts with the next
+*  valid frame.
+*
+*******************************************************************************/
+uint8_t hub_noise_start(uint16_t frames, uint16_t signal)
+{
+	if(0u == frames)
+	{
+		frames = HUB_NOISE_FRAMES;
+	}
+	if((frames < 2u) || (frames > HUB_NOISE_FRAMES_MAX))
+	{
+		return HUB_RESULT_BAD_ARG;
+	}
+
+	memset(&noise_result, 0, sizeof(noise_result));
+	memset(noise_n, 0, sizeof(noise_n));
+	noise_result.frames = frames;
+	noise_result.signal = signal;
+	noise_state = HUB_NOISE_RUNNING;
+	noise_publish();
+	return HUB_RESULT_OK;
+}
+
+/*******************************************************************************
+* Function Name: hub_noise_save
+********************************************************************************
+* Summary:
+*  Puts the finished results into the settings and saves them, together
+*  with any other setting changed since the last save.
+*
+*******************************************************************************/
+uint8_t hub_noise_save(void)
+{
+	if(HUB_NOISE_DONE != noise_state)
+	{
+		return HUB_RESULT_FAILED;
+	}
+
+	hub_settings.noise = noise_result;
+	if(!hub_settings_save())
+	{
+		return HUB_RESULT_FAILED;
+	}
+	noise_state = HUB_NOISE_STORED;
+	noise_map->stats.noise_state = noise_state;
+	return HUB_RESULT_OK;
+}
+
+/*******************************************************************************
+* Function Name: hub_noise_frame
+********************************************************************************
+* Summary:
+*  Adds the raw counts of the sensors scanned in a valid frame. The
+*  measurement ends when every enabled sensor has its frames.
+*
+*******************************************************************************/
+void hub_noise_frame(void)
+{
+	bool done = true;
+
+	if((HUB_NOISE_RUNNING != noise_state) || (0u == (noise_map->status.flags & HUB_STATUS_FRAME_VALID)))
+	{
+		return;
+	}
+
+	for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+	{
+		if(!hub_scan_sensor_enabled(i))
+		{
+			continue;
+		}
+		if(hub_scan_sensor_updated(i) && (noise_n[i] < noise_result.frames))
+		{
+			uint16_t raw = cy_capsense_tuner.sensorContext[i].raw;
+
+			if(0u == noise_n[i])
+			{
+				noise_first[i] = raw;
+				noise_min[i] = raw;
+				noise_max[i] = raw;
+				noise_sum[i] = 0;
+				noise_sumsq[i] = 0u;
+			}
+
+			int32_t d = (int32_t)raw - noise_first[i];
+
+			noise_min[i] = (raw < noise_min[i]) ? raw : noise_min[i];
+			noise_max[i] = (raw > noise_max[i]) ? raw : noise_max[i];
+			noise_sum[i] += d;
+			noise_sumsq[i] += (uint64_t)((int64_t)d * d);
+			noise_n[i]++;
+		}
+		done = done && (noise_n[i] >= noise_result.frames);
+	}
+
+	if(done)
+	{
+		noise_finish();
+	}
+}
@@ -0,0 +1,63 @@
+/*******************************************************************************
+* File Name:   hub_rate.h
+*
+* Description: Adaptive scan rate for free-run mode. While the sensors are
+* quiet, the hub inserts an idle time before each scan and doubles it after
+* every further quiet period, up to a slowest interval. The MSCLP wake-up
+* timer delays the scan start, so the CPU sleeps through the idle time.
+* Any activity switches back to full rate for the next frame.
+*
+* A frame counts as active if a widget reports a touch, or if the sum of the
+* squared frame-to-frame changes of the diff counts (a running estimate of
+* their variance) exceeds the activity threshold.
+*
+*******************************************************************************/
+#ifndef HUB_RATE_H
+#define HUB_RATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hub_regmap.h"
+
+/* Quiet time before the first slow-down, 0 keeps the full rate */
+#ifndef HUB_RATE_QUIET_MS
+#define HUB_RATE_QUIET_MS		(0u)
+#endif
+
+/* Idle time of the first slow-down step, doubled with every further step */
+#ifndef HUB_RATE_STEP_MS
+#define HUB_RATE_STEP_MS		(8u)
+#endif
+
+/* Longest idle time between two frames */
+#ifndef HUB_RATE_MAX_MS
+#define HUB_RATE_MAX_MS			(128u)
+#endif
+
+/* Longest idle time the MSCLP wake-up timer can count (16 bits at the ILO) */
+#define HUB_RATE_TIMER_MAX_MS	(1600u)
+
+_Static_assert(HUB_RATE_MAX_MS <= HUB_RATE_TIMER_MAX_MS, "HUB_RATE_MAX_MS exceeds the MSCLP wake-up timer");
+
+/* Sum of the squared diff count changes of one frame that counts as activity */
+#ifndef HUB_RATE_ACTIVITY_TH
+#define HUB_RATE_ACTIVITY_TH	(64u)
+#endif
+
+void hub_rate_init(void);
+
+/* Sets quiet period, slowest idle time (both in ms) and activity threshold.
+ * A quiet period of 0 disables the adaptive rate. False if the idle time is
+ * beyond HUB_RATE_TIMER_MAX_MS.
+ */
+bool hub_rate_configure(uint16_t quiet_ms, uint16_t max_ms, uint16_t threshold);
+
+/* Checks the processed frame for activity and adapts the idle time. Only
+ * frames taken in free-run mode are rated.
+ */
+void hub_rate_frame(uint8_t mode);
+
+/* Idle time before the next free-run scan in microseconds */
+uint32_t hub_rate_delay_us(void);
+
+#endif /* HUB_RATE_H */
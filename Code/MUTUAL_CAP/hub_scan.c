@@ -0,0 +1,453 @@
+/*******************************************************************************
+* File Name:   hub_scan.c
+*
+* Description: Scan sequencing with a per-sensor enable mask and scan rate,
+* see hub_scan.h
+*
+*******************************************************************************/
+#include "cy_pdl.h"
+#include "cycfg_capsense.h"
+#include "hub_scan.h"
+
+typedef struct
+{
+	uint16_t first;
+	uint16_t count;
+} scan_run_t;
+
+static hub_regmap_t *scan_map;
+static uint32_t scan_mask = HUB_SENSOR_MASK_ALL;
+static uint32_t scan_mask_next = HUB_SENSOR_MASK_ALL;
+static bool scan_mask_changed = true;
+
+/* Schedule: sensor i is scanned every scan_div[i] frames, scan_wait[i]
+ * frames from now. scan_due[i] marks the sensors of the running frame.
+ */
+#ifdef HUB_SCAN_SCHEDULE
+static uint8_t scan_div[NUM_OF_SENSORS] = HUB_SCAN_SCHEDULE;
+#else
+static uint8_t scan_div[NUM_OF_SENSORS];
+#endif
+static uint8_t scan_wait[NUM_OF_SENSORS];
+static bool scan_due[NUM_OF_SENSORS];
+static bool scan_due_changed = true;
+
+static scan_run_t scan_runs[HUB_SCAN_MAX_RUNS];
+static uint32_t scan_run_count;
+static uint32_t scan_run_next;
+
+/* A slot run or the processing of the current frame failed */
+static bool scan_failed;
+
+/* Wake-up timer value the MSCLP is configured with */
+static uint32_t scan_timer_us;
+
+/*******************************************************************************
+* Function Name: mask_enables
+********************************************************************************
+* Summary:
+*  Returns true if the sensor is enabled in the given mask.
+*
+*******************************************************************************/
+static bool mask_enables(uint32_t mask, uint32_t sensor)
+{
+	return (sensor >= 32u) || (0u != (mask & (1uL << sensor)));
+}
+
+/*******************************************************************************
+* Function Name: widget_first_sensor
+********************************************************************************
+* Summary:
+*  Index of the first sensor of a widget in the sensor order of the map.
+*
+*******************************************************************************/
+static uint32_t widget_first_sensor(const cy_stc_capsense_widget_config_t *wd)
+{
+	return (uint32_t)(wd->ptrSnsContext - cy_capsense_tuner.sensorContext);
+}
+
+/*******************************************************************************
+* Function Name: slot_due
+********************************************************************************
+* Summary:
+*  A slot is scanned if its sensor is due in this frame. Slots without a
+*  sensor of their own (empty or shield-only slots) are always scanned.
+*
+*******************************************************************************/
+static bool slot_due(uint32_t slot)
+{
+	const cy_stc_capsense_scan_slot_t *ss = &cy_capsense_context.ptrScanSlots[slot];
+
+	if(ss->wdId >= CY_CAPSENSE_WIDGET_COUNT)
+	{
+		return true;
+	}
+	uint32_t sensor = widget_first_sensor(&cy_capsense_context.ptrWdConfig[ss->wdId]) + ss->snsId;
+
+	return (sensor >= NUM_OF_SENSORS) || scan_due[sensor];
+}
+
+/*******************************************************************************
+* Function Name: runs_build
+********************************************************************************
+* Summary:
+*  Collects the due slots into runs of consecutive slots.
+*
+*******************************************************************************/
+static void runs_build(void)
+{
+	uint32_t num_slots = cy_capsense_context.ptrCommonConfig->numSlots;
+
+	scan_run_count = 0u;
+
+	for(uint32_t slot = 0; slot < num_slots; slot++)
+	{
+		if(!slot_due(slot))
+		{
+			continue;
+		}
+
+		scan_run_t *last = (0u != scan_run_count) ? &scan_runs[scan_run_count - 1u] : NULL;
+		if((NULL != last) && ((last->first + last->count) == slot))
+		{
+			last->count++;
+		}
+		else if(scan_run_count < HUB_SCAN_MAX_RUNS)
+		{
+			scan_runs[scan_run_count].first = (uint16_t)slot;
+			scan_runs[scan_run_count].count = 1u;
+			scan_run_count++;
+		}
+		else
+		{
+			/* Out of runs: stretch the last one over the gap */
+			last->count = (uint16_t)(slot - last->first + 1u);
+		}
+	}
+	scan_due_changed = false;
+}
+
+/*******************************************************************************
+* Function Name: mask_apply
+********************************************************************************
+* Summary:
+*  Updates the widget enable states for the new mask. Only called between
+*  frames, while the scan hardware is idle.
+*
+*******************************************************************************/
+static void mask_apply(void)
+{
+	uint32_t active = 0u;
+
+	scan_mask = scan_mask_next;
+
+	for(uint32_t w = 0; w < CY_CAPSENSE_WIDGET_COUNT; w++)
+	{
+		const cy_stc_capsense_widget_config_t *wd = &cy_capsense_context.ptrWdConfig[w];
+		uint32_t first = widget_first_sensor(wd);
+		bool used = false;
+
+		for(uint32_t i = first; i < (first + wd->numSns); i++)
+		{
+			used = used || mask_enables(scan_mask, i);
+		}
+		(void)Cy_CapSense_SetWidgetStatus(w, used ? CY_CAPSENSE_WD_ENABLE_MASK : 0u,
+										  CY_CAPSENSE_WD_ENABLE_MASK, &cy_capsense_context);
+	}
+
+	for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+	{
+		if(mask_enables(scan_mask, i))
+		{
+			active++;
+		}
+		else
+		{
+			/* Disabled sensors read as zero instead of their last value */
+			scan_map->field.rawcount[i] = 0u;
+			scan_map->field.diffcount[i] = 0u;
+			scan_map->field.baseline[i] = 0u;
+			scan_map->sensor[i].raw = 0u;
+			scan_map->sensor[i].diff = 0u;
+			scan_map->sensor[i].bsln = 0u;
+		}
+	}
+	scan_map->stats.sensor_mask = scan_mask;
+	scan_map->stats.active_sensors = (uint8_t)active;
+	scan_mask_changed = false;
+}
+
+/*******************************************************************************
+* Function Name: schedule_next
+********************************************************************************
+* Summary:
+*  Advances the schedule by one frame and marks the sensors due in it.
+*  Frames in which no enabled sensor is due are skipped, so the fastest
+*  sensor sets the frame rate.
+*
+*******************************************************************************/
+static void schedule_next(void)
+{
+	bool any = false;
+
+	while(!any)
+	{
+		for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+		{
+			bool due = false;
+
+			if(0u == scan_wait[i])
+			{
+				due = mask_enables(scan_mask, i);
+				scan_wait[i] = (uint8_t)(scan_div[i] - 1u);
+			}
+			else
+			{
+				scan_wait[i]--;
+			}
+
+			if(due != scan_due[i])
+			{
+				scan_due[i] = due;
+				scan_due_changed = true;
+			}
+			any = any || due;
+		}
+	}
+}
+
+/*******************************************************************************
+* Function Name: timer_set
+********************************************************************************
+* Summary:
+*  Reconfigures the MSCLP wake-up timer only when its value changes. False
+*  if the middleware rejected the value, the timer then keeps the old one.
+*
+*******************************************************************************/
+static bool timer_set(uint32_t delay_us)
+{
+	if(delay_us != scan_timer_us)
+	{
+		if(CY_CAPSENSE_STATUS_SUCCESS != Cy_CapSense_ConfigureMsclpTimer(delay_us, &cy_capsense_context))
+		{
+			return false;
+		}
+		scan_timer_us = delay_us;
+	}
+	return true;
+}
+
+/*******************************************************************************
+* Function Name: hub_scan_init
+********************************************************************************
+* Summary:
+*  Sets up the register map pointer and staggers the slow sensors, so sensors
+*  with the same rate do not all land in the same frame.
+*
+*******************************************************************************/
+void hub_scan_init(hub_regmap_t *map)
+{
+	scan_map = map;
+
+	for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+	{
+		if(0u == scan_div[i])
+		{
+			scan_div[i] = 1u;
+		}
+		scan_wait[i] = (uint8_t)(i % scan_div[i]);
+	}
+}
+
+/*******************************************************************************
+* Function Name: hub_scan_set_mask
+********************************************************************************
+* Summary:
+*  Queues a new mask for the next frame, a running frame keeps its slots.
+*
+*******************************************************************************/
+bool hub_scan_set_mask(uint32_t mask)
+{
+	bool any = false;
+
+	for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+	{
+		any = any || mask_enables(mask, i);
+	}
+	if(!any)
+	{
+		return false;
+	}
+
+	scan_mask_next = mask;
+	scan_mask_changed = true;
+	return true;
+}
+
+/*******************************************************************************
+* Function Name: hub_scan_set_divider
+********************************************************************************
+* Summary:
+*  Changes the scan rate of one sensor from the next frame on.
+*
+*******************************************************************************/
+bool hub_scan_set_divider(uint32_t sensor, uint8_t divider)
+{
+	if((sensor >= NUM_OF_SENSORS) || (0u == divider))
+	{
+		return false;
+	}
+	scan_div[sensor] = divider;
+	scan_wait[sensor] = 0u;
+	return true;
+}
+
+/*******************************************************************************
+* Function Name: hub_scan_sensor_enabled
+********************************************************************************
+* Summary:
+*  Reports whether a sensor is part of the current frames.
+*
+*******************************************************************************/
+bool hub_scan_sensor_enabled(uint32_t sensor)
+{
+	return mask_enables(scan_mask, sensor);
+}
+
+/*******************************************************************************
+* Function Name: hub_scan_sensor_updated
+********************************************************************************
+* Summary:
+*  Reports whether a sensor was scanned in the last frame.
+*
+*******************************************************************************/
+bool hub_scan_sensor_updated(uint32_t sensor)
+{
+	return (sensor >= NUM_OF_SENSORS) || scan_due[sensor];
+}
+
+/*******************************************************************************
+* Function Name: hub_scan_start
+********************************************************************************
+* Summary:
+*  Applies a pending mask, picks the sensors of the next frame and starts the
+*  first slot run. The runs are only rebuilt when the set of sensors changes.
+*
+*******************************************************************************/
+void hub_scan_start(uint32_t delay_us)
+{
+	if(scan_mask_changed)
+	{
+		mask_apply();
+	}
+	schedule_next();
+	if(scan_due_changed)
+	{
+		runs_build();
+	}
+
+	scan_run_next = 1u;
+	if(!timer_set(delay_us))
+	{
+		/* Out of the timer's range: scan at once rather than not at all */
+		delay_us = 0u;
+		(void)timer_set(0u);
+	}
+	scan_map->status.idle_ms = (uint16_t)(delay_us / 1000u);
+	scan_failed = (CY_CAPSENSE_STATUS_SUCCESS !=
+				   Cy_CapSense_ScanSlots(scan_runs[0].first, scan_runs[0].count, &cy_capsense_context));
+}
+
+/*******************************************************************************
+* Function Name: hub_scan_busy
+********************************************************************************
+* Summary:
+*  Polled from the main loop, also with interrupts disabled, so it only
+*  checks the middleware state. Each finished run wakes the CPU with the scan
+*  interrupt.
+*
+*******************************************************************************/
+bool hub_scan_busy(void)
+{
+	return (CY_CAPSENSE_NOT_BUSY != Cy_CapSense_IsBusy(&cy_capsense_context));
+}
+
+/*******************************************************************************
+* Function Name: hub_scan_next
+********************************************************************************
+* Summary:
+*  Chains the next slot run of the frame from the frame task, with interrupts
+*  enabled.
+*
+*******************************************************************************/
+bool hub_scan_next(void)
+{
+	if(scan_run_next < scan_run_count)
+	{
+		/* Only the first run of a frame waits */
+		(void)timer_set(0u);
+		if(CY_CAPSENSE_STATUS_SUCCESS !=
+		   Cy_CapSense_ScanSlots(scan_runs[scan_run_next].first, scan_runs[scan_run_next].count, &cy_capsense_context))
+		{
+			scan_failed = true;
+		}
+		scan_run_next++;
+		return true;
+	}
+	return false;
+}
+
+/*******************************************************************************
+* Function Name: hub_scan_process
+********************************************************************************
+* Summary:
+*  Processes the widgets scanned in the last frame. Widgets whose sensors
+*  were all skipped keep their state, so their baselines do not track stale
+*  raw counts.
+*
+*******************************************************************************/
+void hub_scan_process(uint32_t mode)
+{
+	for(uint32_t w = 0; w < CY_CAPSENSE_WIDGET_COUNT; w++)
+	{
+		const cy_stc_capsense_widget_config_t *wd = &cy_capsense_context.ptrWdConfig[w];
+		uint32_t first = widget_first_sensor(wd);
+		bool scanned = false;
+
+		for(uint32_t i = first; i < (first + wd->numSns); i++)
+		{
+			scanned = scanned || hub_scan_sensor_updated(i);
+		}
+		if(scanned && (CY_CAPSENSE_STATUS_SUCCESS != Cy_CapSense_ProcessWidgetExt(w, mode, &cy_capsense_context)))
+		{
+			scan_failed = true;
+		}
+	}
+}
+
+/*******************************************************************************
+* Function Name: hub_scan_failed
+********************************************************************************
+* Summary:
+*  Reports a failed slot run or widget processing in the last frame. A run
+*  that failed to start ends the frame early, with the old raw counts.
+*
+*******************************************************************************/
+bool hub_scan_failed(void)
+{
+	return scan_failed;
+}
+
+/*******************************************************************************
+* Function Name: hub_scan_restart
+********************************************************************************
+* Summary:
+*  Forgets the middleware state the module keeps in sync with, after
+*  Cy_CapSense_Init() has brought back the generated configuration.
+*
+*******************************************************************************/
+void hub_scan_restart(void)
+{
+	scan_mask_changed = true;
+	scan_timer_us = UINT32_MAX;
+}
@@ -0,0 +1,79 @@
+/*******************************************************************************
+* File Name:   hub_scan.h
+*
+* Description: Scan sequencing with a per-sensor enable mask and scan rate.
+* Instead of Cy_CapSense_ScanAllSlots, a frame scans the runs of consecutive
+* slots that belong to the sensors due in it, so the scan time (and with it
+* the frame rate) follows the number of electrodes actually in use. Widgets
+* without any enabled sensor are disabled in the middleware, widgets without
+* a sensor in the frame are not processed.
+*
+* Bit i of the mask enables sensor i. Sensors past the 32nd cannot be masked
+* and are always scanned.
+*
+* Each sensor has a divider d: it is scanned in every d-th frame. Sensors
+* with the same divider are spread over the frames. The published frame
+* holds the sequence number of the last update of every sensor.
+*
+*******************************************************************************/
+#ifndef HUB_SCAN_H
+#define HUB_SCAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hub_regmap.h"
+
+#define HUB_SENSOR_MASK_ALL		(0xFFFFFFFFuL)
+
+/* Slot runs per frame. A mask with more gaps scans some disabled slots. */
+#ifndef HUB_SCAN_MAX_RUNS
+#define HUB_SCAN_MAX_RUNS		(8u)
+#endif
+
+/* Optional initializer of the per-sensor dividers, e.g. in the Makefile:
+ * DEFINES+='HUB_SCAN_SCHEDULE={1u,1u,8u}'. Missing entries scan every frame.
+ */
+
+void hub_scan_init(hub_regmap_t *map);
+
+/* Selects the sensors to scan from the next frame on. Returns false if the
+ * mask leaves no sensor to scan; the current mask is kept then.
+ */
+bool hub_scan_set_mask(uint32_t mask);
+
+/* Scans the sensor every divider-th frame (1..255) from the next frame on */
+bool hub_scan_set_divider(uint32_t sensor, uint8_t divider);
+
+/* True if sensor i is scanned */
+bool hub_scan_sensor_enabled(uint32_t sensor);
+
+/* True if sensor i was scanned in the last frame */
+bool hub_scan_sensor_updated(uint32_t sensor);
+
+/* Starts the first slot run of a frame after delay_us, timed by the MSCLP
+ * wake-up timer, and publishes the idle time the timer actually applied
+ */
+void hub_scan_start(uint32_t delay_us);
+
+/* True while a slot run is in progress, no side effects */
+bool hub_scan_busy(void);
+
+/* Called once a slot run has finished: starts the next run of the frame and
+ * returns true, or returns false when the frame is complete
+ */
+bool hub_scan_next(void);
+
+/* Processes the widgets that were scanned in the last frame with the given
+ * CY_CAPSENSE_PROCESS_* mask
+ */
+void hub_scan_process(uint32_t mode);
+
+/* True if a slot run or the processing of the last frame failed */
+bool hub_scan_failed(void);
+
+/* The CAPSENSE block was re-initialized: the widget enables and the wake-up
+ * timer are set again with the next frame
+ */
+void hub_scan_restart(void);
+
+#endif /* HUB_SCAN_H */
@@ -0,0 +1,49 @@
+/*******************************************************************************
+* File Name:   hub_sched.h
+*
+* Description: Small run-to-completion scheduler for the main loop.
+*
+* Tasks are kept in a table ordered by priority. Each pass runs the first task
+* that is due, then starts again from the top, so a higher priority task never
+* waits for more than one lower priority run. A task is due when its ready()
+* check returns true, or for periodic tasks (period_us != 0) when the period
+* has elapsed and ready() (if any) agrees. Every run is timed; a run longer
+* than budget_us counts as an overrun.
+*
+* When no task is due the CPU sleeps until the next interrupt. SysTick wraps
+* at least every 350 ms, so periodic tasks should not rely on finer timing
+* while the hub is otherwise idle.
+*
+*******************************************************************************/
+#ifndef HUB_SCHED_H
+#define HUB_SCHED_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct
+{
+	void (*run)(void);			/* task body, runs to completion */
+	bool (*ready)(void);		/* optional, must not have side effects (called with interrupts off) */
+	uint32_t period_us;			/* 0 = event driven through ready() */
+	uint32_t budget_us;			/* longest expected run, 0 = unlimited */
+
+	/* Managed by the scheduler */
+	uint32_t next_cycles;
+	uint32_t budget_cycles;
+	uint32_t max_cycles;		/* longest run so far */
+	uint16_t overruns;			/* runs longer than the budget */
+} hub_task_t;
+
+void hub_sched_init(hub_task_t *tasks, uint32_t count);
+
+/* Runs the highest priority task that is due. Returns false if none was. */
+bool hub_sched_step(void);
+
+/* Sleeps until the next interrupt if no task is due */
+void hub_sched_idle(void);
+
+/* Returns the task table for statistics */
+const hub_task_t *hub_sched_tasks(uint32_t *count);
+
+#endif /* HUB_SCHED_H */
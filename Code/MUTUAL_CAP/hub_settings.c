@@ -0,0 +1,212 @@
+/*******************************************************************************
+* File Name:   hub_settings.c
+*
+* Description: Persistent hub settings, see hub_settings.h
+*
+*******************************************************************************/
+#include <stddef.h>
+#include <string.h>
+#include "cy_pdl.h"
+#include "hub_crc.h"
+#include "hub_irq.h"
+#include "hub_scan.h"
+#include "hub_settings.h"
+
+#define HUB_SETTINGS_ROWS		((sizeof(hub_settings_t) + CY_FLASH_SIZEOF_ROW - 1u) / CY_FLASH_SIZEOF_ROW)
+#define HUB_SETTINGS_CRC_LEN	(offsetof(hub_settings_t, crc))
+
+/* Where older versions kept their CRC: version 1 ended after the I2C
+ * address, version 2 after the sensor mask, each followed by 2 reserved bytes.
+ * Version 3 ended after the cross-talk matrix, version 4 after the power mode,
+ * version 5 after the scan parameters.
+ */
+#define HUB_SETTINGS_V1_CRC_LEN	(6u)
+#define HUB_SETTINGS_V2_CRC_LEN	(10u)
+#define HUB_SETTINGS_V3_CRC_LEN	(offsetof(hub_settings_t, power))
+#define HUB_SETTINGS_V4_CRC_LEN	(offsetof(hub_settings_t, tune))
+#define HUB_SETTINGS_V5_CRC_LEN	(offsetof(hub_settings_t, noise))
+
+/* Flash rows reserved for the settings. The emulated EEPROM section of the
+ * linker script keeps them out of the way of the application code.
+ */
+CY_SECTION(".cy_em_eeprom") CY_ALIGN(CY_FLASH_SIZEOF_ROW)
+static const volatile uint8_t hub_settings_storage[HUB_SETTINGS_ROWS * CY_FLASH_SIZEOF_ROW] = {0u};
+
+hub_settings_t hub_settings;
+
+/*******************************************************************************
+* Function Name: settings_defaults
+********************************************************************************
+* Summary:
+*  Fills the working copy with values that keep the generated configuration.
+*
+*******************************************************************************/
+static void settings_defaults(void)
+{
+	memset(&hub_settings, 0, sizeof(hub_settings));
+	hub_settings.magic = HUB_SETTINGS_MAGIC;
+	hub_settings.version = HUB_SETTINGS_VERSION;
+	hub_settings.sensor_mask = HUB_SENSOR_MASK_ALL;
+	hub_settings.xtalk_n = (uint8_t)NUM_OF_SENSORS;
+	for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+	{
+		hub_settings.xtalk[i][i] = HUB_XTALK_ONE;
+	}
+}
+
+/*******************************************************************************
+* Function Name: settings_migrate
+********************************************************************************
+* Summary:
+*  Takes over the fields older versions already had, so a firmware update
+*  neither moves a hub to another address nor re-enables missing sensors.
+*  Newer fields start from their defaults.
+*
+*******************************************************************************/
+static bool settings_migrate(const uint8_t *stored)
+{
+	uint8_t version = hub_settings.version;
+	uint8_t i2c_addr = hub_settings.i2c_addr;
+	uint32_t sensor_mask = hub_settings.sensor_mask;
+	uint32_t crc_len;
+
+	if(1u == version)
+	{
+		crc_len = HUB_SETTINGS_V1_CRC_LEN;
+	}
+	else if(2u == version)
+	{
+		crc_len = HUB_SETTINGS_V2_CRC_LEN;
+	}
+	else if(3u == version)
+	{
+		crc_len = HUB_SETTINGS_V3_CRC_LEN;
+	}
+	else if(4u == version)
+	{
+		crc_len = HUB_SETTINGS_V4_CRC_LEN;
+	}
+	else if(5u == version)
+	{
+		crc_len = HUB_SETTINGS_V5_CRC_LEN;
+	}
+	else
+	{
+		return false;
+	}
+
+	uint16_t crc = (uint16_t)(stored[crc_len] | ((uint16_t)stored[crc_len + 1u] << 8));
+	if(hub_crc16(stored, crc_len) != crc)
+	{
+		return false;
+	}
+
+	if(version >= 3u)
+	{
+		/* Versions 4 to 6 only appended fields, the stored ones stay as loaded */
+		uint8_t *dst = (uint8_t *)&hub_settings;
+
+		memset(&dst[crc_len], 0, sizeof(hub_settings) - crc_len);
+		if(3u == version)
+		{
+			hub_settings.power = HUB_POWER_CONTINUOUS;
+		}
+		hub_settings.version = HUB_SETTINGS_VERSION;
+		return true;
+	}
+
+	settings_defaults();
+	hub_settings.i2c_addr = i2c_addr;
+	if(version >= 2u)
+	{
+		hub_settings.sensor_mask = sensor_mask;
+	}
+	return true;
+}
+
+/*******************************************************************************
+* Function Name: hub_settings_load
+********************************************************************************
+* Summary:
+*  Copies the settings out of flash and checks magic, version and CRC.
+*  Settings of an older version are migrated where possible.
+*
+*******************************************************************************/
+bool hub_settings_load(void)
+{
+	uint8_t *dst = (uint8_t *)&hub_settings;
+
+	for(uint32_t i = 0; i < sizeof(hub_settings); i++)
+	{
+		dst[i] = hub_settings_storage[i];
+	}
+
+	if(HUB_SETTINGS_MAGIC != hub_settings.magic)
+	{
+		settings_defaults();
+		return false;
+	}
+	if(HUB_SETTINGS_VERSION != hub_settings.version)
+	{
+		if(settings_migrate(dst))
+		{
+			return true;
+		}
+		settings_defaults();
+		return false;
+	}
+	if(hub_crc16(dst, HUB_SETTINGS_CRC_LEN) != hub_settings.crc)
+	{
+		settings_defaults();
+		return false;
+	}
+	return true;
+}
+
+/*******************************************************************************
+* Function Name: hub_settings_seal
+********************************************************************************
+* Summary:
+*  Stamps the working copy with the current magic, version and CRC.
+*
+*******************************************************************************/
+void hub_settings_seal(void)
+{
+	hub_settings.magic = HUB_SETTINGS_MAGIC;
+	hub_settings.version = HUB_SETTINGS_VERSION;
+	hub_settings.crc = hub_crc16((const uint8_t *)&hub_settings, HUB_SETTINGS_CRC_LEN);
+}
+
+/*******************************************************************************
+* Function Name: hub_settings_save
+********************************************************************************
+* Summary:
+*  Updates the CRC and writes the working copy row by row.
+*
+*******************************************************************************/
+bool hub_settings_save(void)
+{
+	uint32_t row[CY_FLASH_SIZEOF_ROW / sizeof(uint32_t)];
+	const uint8_t *src = (const uint8_t *)&hub_settings;
+
+	hub_settings_seal();
+
+	for(uint32_t r = 0; r < HUB_SETTINGS_ROWS; r++)
+	{
+		uint32_t offset = r * CY_FLASH_SIZEOF_ROW;
+		uint32_t len = sizeof(hub_settings) - offset;
+
+		if(len > CY_FLASH_SIZEOF_ROW)
+		{
+			len = CY_FLASH_SIZEOF_ROW;
+		}
+		memset(row, 0, sizeof(row));
+		memcpy(row, &src[offset], len);
+
+		if(CY_FLASH_DRV_SUCCESS != hub_irq_flash_write_row((uint32_t)&hub_settings_storage[offset], row))
+		{
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,75 @@
+/*******************************************************************************
+* File Name:   hub_settings.h
+*
+* Description: Persistent hub settings, kept in a reserved flash area and
+* protected by a CRC. Invalid or missing settings fall back to the defaults,
+* so a freshly programmed hub behaves like the generated configuration.
+*
+* Writing flash stalls the CPU (and with it I2C servicing) for a few
+* milliseconds per row, so settings are only saved on explicit host commands.
+*
+*******************************************************************************/
+#ifndef HUB_SETTINGS_H
+#define HUB_SETTINGS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hub_regmap.h"
+
+#define HUB_SETTINGS_MAGIC		(0x4853u)	/* "SH" */
+#define HUB_SETTINGS_VERSION	(6u)
+
+/* 1.0 in the Q14 cross-talk coefficients */
+#define HUB_XTALK_ONE			(16384)
+
+/* Noise and SNR result of one sensor, see hub_noise.h */
+typedef struct
+{
+	uint16_t pp;			/* peak-to-peak noise, raw counts */
+	uint16_t rms;			/* RMS noise, tenths of raw counts */
+	uint16_t snr;			/* signal / peak-to-peak noise, tenths */
+} hub_noise_result_t;
+
+/* Noise measurement of the board, stored by HUB_CMD_NOISE_SAVE */
+typedef struct
+{
+	uint16_t frames;		/* frames per sensor, 0 = nothing stored */
+	uint16_t signal;		/* signal given by the host, 0 = finger thresholds */
+	hub_noise_result_t sensor[NUM_OF_SENSORS];
+} hub_noise_store_t;
+
+typedef struct
+{
+	uint16_t magic;			/* HUB_SETTINGS_MAGIC */
+	uint8_t  version;		/* HUB_SETTINGS_VERSION */
+	uint8_t  i2c_addr;		/* tuner address, data is i2c_addr + 1, 0 = straps / generated */
+	uint32_t sensor_mask;	/* bit i enables sensor i, see hub_scan.h */
+	uint8_t  xtalk_n;		/* NUM_OF_SENSORS the matrix was made for */
+	uint8_t  recorder;		/* bit 7: recorder on, bits 0..3: 2^n frames per record */
+	int16_t  xtalk[NUM_OF_SENSORS][NUM_OF_SENSORS];	/* Q14 cross-talk compensation, see hub_xtalk.h */
+	uint8_t  power;			/* HUB_POWER_* of the next boot, see hub_cal.h */
+	uint8_t  reserved;
+	struct
+	{
+		uint16_t nsub;		/* sub-conversions, 0 = generated */
+		uint16_t snsclk;	/* sense clock divider, 0 = generated */
+	} tune[CY_CAPSENSE_WIDGET_COUNT];	/* scan parameters found by the optimizer, see hub_tune.h */
+	hub_noise_store_t noise;	/* end-of-line noise results, kept across firmware updates */
+	uint16_t crc;			/* CRC-16/CCITT over all bytes before this field */
+} hub_settings_t;
+
+/* Working copy, loaded at boot and written back by hub_settings_save() */
+extern hub_settings_t hub_settings;
+
+/* Loads the settings from flash, falls back to defaults. Returns false on fallback. */
+bool hub_settings_load(void);
+
+/* Writes the working copy to flash. Returns false if a row write failed. */
+bool hub_settings_save(void);
+
+/* Updates magic, version and CRC of the working copy, so it can be stored
+ * as is (also by a firmware update, see hub_boot.h)
+ */
+void hub_settings_seal(void);
+
+#endif /* HUB_SETTINGS_H */
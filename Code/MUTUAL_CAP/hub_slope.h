@@ -0,0 +1,46 @@
+/*******************************************************************************
+* File Name:   hub_slope.h
+*
+* Description: Rate of change of the published diff counts, e.g. the flow
+* out of a draining tank. For every sensor, a least-squares line is fitted
+* through its last HUB_SLOPE_WINDOW diff counts over their update times and
+* its slope is published in sensor[i].slope, in diff counts per minute.
+* Fitting at the scan rate gives a much less noisy slope than differencing
+* slow host samples.
+*
+* The sums of the fit are kept relative to the newest sample and updated
+* with each new sample (shift by the time step, drop the oldest, add the
+* newest), so a frame costs the same few 64-bit operations per sensor
+* whatever the window. All sums are exact integers and never drift. The
+* update time of a sample is the start of the scan that took it, on a clock
+* that does not wrap, so scan-rate dividers, the adaptive scan rate and long
+* pauses between host triggers do not distort the slope.
+*
+* A gap of more than HUB_SLOPE_GAP_MS between two updates of a sensor starts
+* its window again; the slope reads 0 until the window holds two samples.
+*
+*******************************************************************************/
+#ifndef HUB_SLOPE_H
+#define HUB_SLOPE_H
+
+#include <stdint.h>
+#include "hub_regmap.h"
+
+/* Samples per fit */
+#ifndef HUB_SLOPE_WINDOW
+#define HUB_SLOPE_WINDOW		(16u)
+#endif
+
+/* Longest time between two samples of one window */
+#ifndef HUB_SLOPE_GAP_MS
+#define HUB_SLOPE_GAP_MS		(10000u)
+#endif
+
+void hub_slope_init(hub_regmap_t *map);
+
+/* Adds the diff counts published in this frame, scanned at scan_us (see
+ * hub_time_us())
+ */
+void hub_slope_frame(uint64_t scan_us);
+
+#endif /* HUB_SLOPE_H */
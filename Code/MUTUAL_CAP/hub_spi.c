@@ -0,0 +1,181 @@
+/*******************************************************************************
+* File Name:   hub_spi.c
+*
+* Description: Frame stream over an SPI slave, see hub_spi.h
+*
+*******************************************************************************/
+#include <stdbool.h>
+#include <string.h>
+#include "cy_pdl.h"
+#include "hub_irq.h"
+#include "hub_crc.h"
+#include "hub_spi.h"
+
+#if HUB_SPI_AVAILABLE
+
+_Static_assert((HUB_SPI_DEPTH & (HUB_SPI_DEPTH - 1u)) == 0u, "HUB_SPI_DEPTH must be a power of two");
+
+/* TX FIFO entries left when the refill interrupt fires */
+#define SPI_TX_LEVEL			(4u)
+
+static hub_regmap_t *spi_map;
+
+/* Frame FIFO: head is advanced by the main loop, tail by the interrupt */
+static hub_spi_frame_t spi_fifo[HUB_SPI_DEPTH];
+static volatile uint32_t spi_head;
+static volatile uint32_t spi_tail;
+static uint16_t spi_lost;
+
+static hub_spi_frame_t spi_idle;
+
+/* Frame being sent and the bytes of it already in the TX FIFO */
+static const uint8_t *spi_tx;
+static uint32_t spi_pos;
+static bool spi_queued;
+
+/*******************************************************************************
+* Function Name: spi_load
+********************************************************************************
+* Summary:
+*  Puts the oldest queued frame, or the idle frame, into the TX FIFO.
+*
+*******************************************************************************/
+static void spi_load(void)
+{
+	spi_queued = (spi_head != spi_tail);
+	spi_tx = (const uint8_t *)(spi_queued ? &spi_fifo[spi_tail % HUB_SPI_DEPTH] : &spi_idle);
+	spi_pos = Cy_SCB_SPI_WriteArray(SPI_HW, (void *)spi_tx, sizeof(hub_spi_frame_t));
+	Cy_SCB_SetTxInterruptMask(SPI_HW, (spi_pos < sizeof(hub_spi_frame_t)) ? CY_SCB_TX_INTR_LEVEL : 0u);
+}
+
+/*******************************************************************************
+* Function Name: spi_isr
+********************************************************************************
+* Summary:
+*  Keeps the TX FIFO filled during a transaction. The end of a transaction
+*  (chip select released) retires the frame if the host has clocked all of
+*  it and loads the next one; otherwise the frame is loaded again.
+*
+*******************************************************************************/
+static void spi_isr(void)
+{
+	uint32_t hold = hub_irq_hold_begin();
+
+	if(0u != (Cy_SCB_GetSlaveInterruptStatusMasked(SPI_HW) & CY_SCB_SLAVE_INTR_SPI_EBC))
+	{
+		bool sent = (spi_pos >= sizeof(hub_spi_frame_t)) &&
+					(0u == Cy_SCB_SPI_GetNumInTxFifo(SPI_HW)) && (0u == Cy_SCB_GetTxSrValid(SPI_HW));
+
+		Cy_SCB_ClearSlaveInterrupt(SPI_HW, CY_SCB_SLAVE_INTR_SPI_EBC);
+		Cy_SCB_SPI_ClearTxFifo(SPI_HW);
+		Cy_SCB_SPI_ClearRxFifo(SPI_HW);
+		if(sent && spi_queued)
+		{
+			spi_tail++;
+		}
+		spi_load();
+	}
+	else if(0u != (Cy_SCB_GetTxInterruptStatusMasked(SPI_HW) & CY_SCB_TX_INTR_LEVEL))
+	{
+		spi_pos += Cy_SCB_SPI_WriteArray(SPI_HW, (void *)&spi_tx[spi_pos], sizeof(hub_spi_frame_t) - spi_pos);
+		if(spi_pos >= sizeof(hub_spi_frame_t))
+		{
+			Cy_SCB_SetTxInterruptMask(SPI_HW, 0u);
+		}
+		Cy_SCB_ClearTxInterrupt(SPI_HW, CY_SCB_TX_INTR_LEVEL);
+	}
+	hub_irq_hold_end(hold);
+}
+
+/*******************************************************************************
+* Function Name: spi_seal
+********************************************************************************
+* Summary:
+*  Sets the CRC of a frame.
+*
+*******************************************************************************/
+static void spi_seal(hub_spi_frame_t *f)
+{
+	f->crc = hub_crc16((const uint8_t *)f, (uint32_t)offsetof(hub_spi_frame_t, crc));
+}
+
+/*******************************************************************************
+* Function Name: hub_spi_init
+********************************************************************************
+* Summary:
+*  Starts the SPI slave with the idle frame loaded. The interrupt runs above
+*  CAPSENSE and EZI2C (see hub_irq.h): at a few MHz the TX FIFO drains
+*  within microseconds.
+*
+*******************************************************************************/
+void hub_spi_init(hub_regmap_t *map)
+{
+	const cy_stc_sysint_t spi_intr_config =
+	{
+		.intrSrc = SPI_IRQ,
+		.intrPriority = HUB_IRQ_PRIO_SPI,
+	};
+
+	spi_map = map;
+	spi_map->stats.spi_frame = (uint16_t)sizeof(hub_spi_frame_t);
+
+	spi_idle.magic = HUB_SPI_MAGIC;
+	spi_idle.type = HUB_SPI_IDLE;
+	spi_seal(&spi_idle);
+
+	(void)Cy_SCB_SPI_Init(SPI_HW, &SPI_config, NULL);
+	Cy_SCB_SetTxFifoLevel(SPI_HW, SPI_TX_LEVEL);
+	Cy_SCB_SetSlaveInterruptMask(SPI_HW, CY_SCB_SLAVE_INTR_SPI_EBC);
+	spi_load();
+
+	Cy_SysInt_Init(&spi_intr_config, spi_isr);
+	NVIC_ClearPendingIRQ(spi_intr_config.intrSrc);
+	NVIC_EnableIRQ(spi_intr_config.intrSrc);
+	Cy_SCB_SPI_Enable(SPI_HW);
+}
+
+/*******************************************************************************
+* Function Name: hub_spi_frame
+********************************************************************************
+* Summary:
+*  Copies the published frame into the next free FIFO slot. The slot is
+*  complete before head moves on, so the interrupt never sends a partial one.
+*
+*******************************************************************************/
+void hub_spi_frame(void)
+{
+	if((spi_head - spi_tail) >= HUB_SPI_DEPTH)
+	{
+		spi_lost = (spi_lost < UINT16_MAX) ? (spi_lost + 1u) : UINT16_MAX;
+		spi_map->stats.spi_lost++;
+		return;
+	}
+
+	hub_spi_frame_t *f = &spi_fifo[spi_head % HUB_SPI_DEPTH];
+
+	f->magic = HUB_SPI_MAGIC;
+	f->type = HUB_SPI_FRAME;
+	f->num_sensors = (uint8_t)NUM_OF_SENSORS;
+	f->seq = spi_map->status.seq;
+	f->flags = spi_map->status.flags;
+	f->mode = (uint8_t)HUB_STATUS_MODE(spi_map->status.flags);
+	f->lost = spi_lost;
+	memcpy(&f->field, &spi_map->field, sizeof(f->field));
+	spi_seal(f);
+
+	spi_lost = 0u;
+	spi_head++;
+}
+
+#else
+
+void hub_spi_init(hub_regmap_t *map)
+{
+	map->stats.spi_frame = 0u;
+}
+
+void hub_spi_frame(void)
+{
+}
+
+#endif /* HUB_SPI_AVAILABLE */
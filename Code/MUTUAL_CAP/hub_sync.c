@@ -0,0 +1,148 @@
+/*******************************************************************************
+* File Name:   hub_sync.c
+*
+* Description: Sync line handling, see hub_sync.h
+*
+*******************************************************************************/
+#include "cy_pdl.h"
+#include "hub_irq.h"
+#include "hub_sync.h"
+#include "hub_time.h"
+
+#if HUB_SYNC_AVAILABLE
+
+static hub_ctrl_t *sync_ctrl;
+static volatile bool sync_pending;
+static volatile bool sync_overrun;
+static volatile uint32_t sync_epoch;
+static volatile uint32_t sync_cycles;
+
+/*******************************************************************************
+* Function Name: sync_isr
+********************************************************************************
+* Summary:
+*  Takes the epoch for this edge from the control window and advances it, so
+*  all hubs count the same edges even if one of them skips a frame.
+*
+*******************************************************************************/
+static void sync_isr(void)
+{
+	uint32_t hold = hub_irq_hold_begin();
+
+	Cy_GPIO_ClearInterrupt(SYNC_PORT, SYNC_NUM);
+
+	sync_cycles = hub_time_cycles();
+	if(sync_pending)
+	{
+		sync_overrun = true;
+	}
+	sync_epoch = sync_ctrl->epoch;
+	sync_ctrl->epoch = sync_epoch + 1u;
+	sync_pending = true;
+	hub_irq_hold_end(hold);
+}
+
+/*******************************************************************************
+* Function Name: hub_sync_init
+********************************************************************************
+* Summary:
+*  Enables the falling edge interrupt of the SYNC pin.
+*
+*******************************************************************************/
+void hub_sync_init(hub_ctrl_t *ctrl)
+{
+	/* Above CAPSENSE and EZI2C for an exact edge timestamp, the ISR is only a few instructions */
+	const cy_stc_sysint_t sync_intr_config =
+	{
+		.intrSrc = SYNC_IRQ,
+		.intrPriority = HUB_IRQ_PRIO_SYNC,
+	};
+
+	sync_ctrl = ctrl;
+	Cy_GPIO_SetInterruptEdge(SYNC_PORT, SYNC_NUM, CY_GPIO_INTR_FALLING);
+	Cy_GPIO_ClearInterrupt(SYNC_PORT, SYNC_NUM);
+	Cy_SysInt_Init(&sync_intr_config, sync_isr);
+	NVIC_ClearPendingIRQ(sync_intr_config.intrSrc);
+	NVIC_EnableIRQ(sync_intr_config.intrSrc);
+}
+
+/*******************************************************************************
+* Function Name: hub_sync_take
+********************************************************************************
+* Summary:
+*  Consumes a pending sync edge.
+*
+*******************************************************************************/
+bool hub_sync_take(uint32_t *epoch, uint32_t *edge_cycles)
+{
+	bool pending;
+	uint32_t start = hub_irq_mask_begin();
+
+	pending = sync_pending;
+	if(pending)
+	{
+		sync_pending = false;
+		*epoch = sync_epoch;
+		*edge_cycles = sync_cycles;
+	}
+	hub_irq_mask_end(start);
+
+	return pending;
+}
+
+/*******************************************************************************
+* Function Name: hub_sync_missed
+********************************************************************************
+* Summary:
+*  Reports and clears the overrun flag.
+*
+*******************************************************************************/
+bool hub_sync_missed(void)
+{
+	bool missed;
+	uint32_t start = hub_irq_mask_begin();
+
+	missed = sync_overrun;
+	sync_overrun = false;
+	hub_irq_mask_end(start);
+
+	return missed;
+}
+
+/*******************************************************************************
+* Function Name: hub_sync_pending
+********************************************************************************
+* Summary:
+*  Returns true if a sync edge is waiting to start a scan.
+*
+*******************************************************************************/
+bool hub_sync_pending(void)
+{
+	return sync_pending;
+}
+
+#else
+
+void hub_sync_init(hub_ctrl_t *ctrl)
+{
+	(void)ctrl;
+}
+
+bool hub_sync_take(uint32_t *epoch, uint32_t *edge_cycles)
+{
+	(void)epoch;
+	(void)edge_cycles;
+	return false;
+}
+
+bool hub_sync_missed(void)
+{
+	return false;
+}
+
+bool hub_sync_pending(void)
+{
+	return false;
+}
+
+#endif /* HUB_SYNC_AVAILABLE */
@@ -0,0 +1,38 @@
+/*******************************************************************************
+* File Name:   hub_sync.h
+*
+* Description: Synchronized scanning of several hubs from a shared sync line.
+* All hubs on the line see the same falling edge, start their scan on it and
+* stamp the frame with the same epoch number.
+*
+* The sync input is a pin named SYNC in the Device Configurator (input with
+* pull-up, falling edge interrupt). Without that pin the feature is compiled
+* out and HUB_MODE_SYNC behaves like one-shot mode without triggers.
+*
+*******************************************************************************/
+#ifndef HUB_SYNC_H
+#define HUB_SYNC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "cycfg.h"
+#include "hub_regmap.h"
+
+#if defined(SYNC_PORT)
+#define HUB_SYNC_AVAILABLE		(1u)
+#else
+#define HUB_SYNC_AVAILABLE		(0u)
+#endif
+
+void hub_sync_init(hub_ctrl_t *ctrl);
+
+/* Returns true if a sync edge is waiting to start a scan */
+bool hub_sync_pending(void);
+
+/* Returns true and the epoch and time of the edge if a sync edge is pending */
+bool hub_sync_take(uint32_t *epoch, uint32_t *edge_cycles);
+
+/* Returns true once if an edge arrived while the previous one was still pending */
+bool hub_sync_missed(void);
+
+#endif /* HUB_SYNC_H */
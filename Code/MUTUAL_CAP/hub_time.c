@@ -0,0 +1,113 @@
+/*******************************************************************************
+* File Name:   hub_time.c
+*
+* Description: SysTick based timebase, see hub_time.h
+*
+*******************************************************************************/
+#include "cy_pdl.h"
+#include "hub_time.h"
+#include "hub_trace.h"
+
+#define HUB_TIME_RELOAD		(0x00FFFFFFu)
+
+/* Number of SysTick wraps, each worth HUB_TIME_RELOAD + 1 cycles */
+static volatile uint32_t hub_time_wraps;
+
+/*******************************************************************************
+* Function Name: hub_time_wrap
+********************************************************************************
+* Summary:
+*  SysTick callback, extends the 24-bit counter in software. The trace
+*  records the wrap so its host tool can do the same.
+*
+*******************************************************************************/
+static void hub_time_wrap(void)
+{
+	hub_time_wraps++;
+	hub_trace(HUB_TRACE_WRAP);
+}
+
+/*******************************************************************************
+* Function Name: hub_time_init
+********************************************************************************
+* Summary:
+*  Starts SysTick from the CPU clock with the maximum reload value.
+*
+*******************************************************************************/
+void hub_time_init(void)
+{
+	hub_time_wraps = 0u;
+	Cy_SysTick_Init(CY_SYSTICK_CLOCK_SOURCE_CLK_CPU, HUB_TIME_RELOAD);
+	(void)Cy_SysTick_SetCallback(0u, hub_time_wrap);
+}
+
+/*******************************************************************************
+* Function Name: time_cycles64
+********************************************************************************
+* Summary:
+*  Returns the CPU cycles elapsed since hub_time_init(), without wrapping.
+*  The wrap count is read twice so a wrap between the two reads cannot
+*  produce a torn value, and a wrap whose interrupt is still pending
+*  (interrupts disabled) is counted too.
+*
+*******************************************************************************/
+static uint64_t time_cycles64(void)
+{
+	uint32_t snapshot;
+	uint32_t wraps;
+	uint32_t value;
+
+	do
+	{
+		snapshot = hub_time_wraps;
+		wraps = snapshot;
+		value = Cy_SysTick_GetValue();
+		if(0u != (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk))
+		{
+			value = Cy_SysTick_GetValue();
+			wraps++;
+		}
+	} while (snapshot != hub_time_wraps);
+
+	return ((uint64_t)wraps << 24) + (HUB_TIME_RELOAD - value);
+}
+
+/*******************************************************************************
+* Function Name: hub_time_cycles
+********************************************************************************
+* Summary:
+*  Returns the low 32 bits of the CPU cycles elapsed since hub_time_init().
+*
+*******************************************************************************/
+uint32_t hub_time_cycles(void)
+{
+	return (uint32_t)time_cycles64();
+}
+
+/*******************************************************************************
+* Function Name: hub_time_us
+********************************************************************************
+* Summary:
+*  Extends a hub_time_cycles() value taken less than 2^32 cycles ago to the
+*  full count and converts it into microseconds since hub_time_init().
+*
+*******************************************************************************/
+uint64_t hub_time_us(uint32_t cycles)
+{
+	uint64_t now = time_cycles64();
+	uint64_t at = now - (uint32_t)((uint32_t)now - cycles);
+
+	return at / (SystemCoreClock / 1000000u);
+}
+
+/*******************************************************************************
+* Function Name: hub_time_cycles_to_us
+********************************************************************************
+* Summary:
+*  Converts a cycle difference into microseconds using SystemCoreClock.
+*
+*******************************************************************************/
+uint32_t hub_time_cycles_to_us(uint32_t cycles)
+{
+	return cycles / (SystemCoreClock / 1000000u);
+}
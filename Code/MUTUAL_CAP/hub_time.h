@@ -0,0 +1,27 @@
+/*******************************************************************************
+* File Name:   hub_time.h
+*
+* Description: Free-running timebase for latency and frame-rate measurements.
+* SysTick runs from the CPU clock with the full 24-bit reload, so it only
+* interrupts a few times per second and does not keep the CPU out of sleep.
+*
+*******************************************************************************/
+#ifndef HUB_TIME_H
+#define HUB_TIME_H
+
+#include <stdint.h>
+
+void hub_time_init(void);
+
+/* CPU cycles since hub_time_init(), wraps after 2^32 cycles */
+uint32_t hub_time_cycles(void);
+
+/* Converts a cycle difference into microseconds */
+uint32_t hub_time_cycles_to_us(uint32_t cycles);
+
+/* Time of a hub_time_cycles() value in microseconds since hub_time_init(),
+ * never wraps. The value must be less than 2^32 cycles old (89 s at 48 MHz).
+ */
+uint64_t hub_time_us(uint32_t cycles);
+
+#endif /* HUB_TIME_H */
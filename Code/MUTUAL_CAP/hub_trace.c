@@ -0,0 +1,148 @@
+/*******************************************************************************
+* File Name:   hub_trace.c
+*
+* Description: Event trace, see hub_trace.h
+*
+*******************************************************************************/
+#include <string.h>
+#include "cy_pdl.h"
+#include "hub_trace.h"
+
+#if HUB_TRACE_ENABLE
+uint32_t hub_trace_ring[HUB_TRACE_DEPTH];
+volatile uint32_t hub_trace_count;
+volatile bool hub_trace_on;
+#endif
+
+static hub_regmap_t *trace_map;
+static uint8_t trace_state;
+static uint32_t trace_late_us;
+
+/*******************************************************************************
+* Function Name: trace_publish
+********************************************************************************
+* Summary:
+*  Shows the state and the fill of the ring in the stats block.
+*
+*******************************************************************************/
+static void trace_publish(void)
+{
+	trace_map->stats.trace_state = trace_state;
+#if HUB_TRACE_ENABLE
+	trace_map->stats.trace_count = hub_trace_count;
+#endif
+}
+
+/*******************************************************************************
+* Function Name: hub_trace_init
+********************************************************************************
+* Summary:
+*  Publishes the stopped trace and what the host needs to decode it.
+*
+*******************************************************************************/
+void hub_trace_init(hub_regmap_t *map)
+{
+	trace_map = map;
+	trace_state = HUB_TRACE_OFF;
+#if HUB_TRACE_ENABLE
+	map->stats.trace_depth = HUB_TRACE_DEPTH;
+#endif
+	map->stats.trace_mhz = (uint8_t)(SystemCoreClock / 1000000u);
+	trace_publish();
+}
+
+/*******************************************************************************
+* Function Name: hub_trace_configure
+********************************************************************************
+* Summary:
+*  Stops the trace, or clears the ring and starts it. An armed trace needs
+*  the frame period above which it stops.
+*
+*******************************************************************************/
+uint8_t hub_trace_configure(uint8_t state, uint32_t late_us)
+{
+#if HUB_TRACE_ENABLE
+	if((state > HUB_TRACE_ARMED) || ((HUB_TRACE_ARMED == state) && (0u == late_us)))
+	{
+		return HUB_RESULT_BAD_ARG;
+	}
+
+	hub_trace_on = false;
+	if(HUB_TRACE_OFF != state)
+	{
+		hub_trace_count = 0u;
+		trace_late_us = late_us;
+		hub_trace_on = true;
+	}
+	trace_state = state;
+	trace_publish();
+	return HUB_RESULT_OK;
+#else
+	(void)state;
+	(void)late_us;
+	return HUB_RESULT_FAILED;
+#endif
+}
+
+/*******************************************************************************
+* Function Name: hub_trace_read
+********************************************************************************
+* Summary:
+*  Copies HUB_TRACE_CHUNK events into the record window, chunk 0 starts with
+*  the oldest event in the ring. Positions past the last event read as 0.
+*  Fails while the trace is recording.
+*
+*******************************************************************************/
+uint8_t hub_trace_read(uint16_t chunk)
+{
+#if HUB_TRACE_ENABLE
+	if(hub_trace_on)
+	{
+		return HUB_RESULT_FAILED;
+	}
+	if(chunk >= (HUB_TRACE_DEPTH / HUB_TRACE_CHUNK))
+	{
+		return HUB_RESULT_BAD_ARG;
+	}
+
+	uint32_t count = hub_trace_count;
+	uint32_t valid = (count > HUB_TRACE_DEPTH) ? HUB_TRACE_DEPTH : count;
+	uint32_t first = count - valid;
+
+	for(uint32_t k = 0; k < HUB_TRACE_CHUNK; k++)
+	{
+		uint32_t j = ((uint32_t)chunk * HUB_TRACE_CHUNK) + k;
+		uint32_t event = (j < valid) ? hub_trace_ring[(first + j) & (HUB_TRACE_DEPTH - 1u)] : 0u;
+
+		memcpy(&trace_map->rec.data[k * 4u], &event, 4u);
+	}
+	trace_map->rec.index = chunk;
+	return HUB_RESULT_OK;
+#else
+	(void)chunk;
+	return HUB_RESULT_FAILED;
+#endif
+}
+
+/*******************************************************************************
+* Function Name: hub_trace_frame
+********************************************************************************
+* Summary:
+*  Stops an armed trace at the first frame over the threshold, so the ring
+*  keeps what led up to it, and publishes the fill of the ring.
+*
+*******************************************************************************/
+void hub_trace_frame(uint32_t frame_us)
+{
+#if HUB_TRACE_ENABLE
+	if((HUB_TRACE_ARMED == trace_state) && (frame_us > trace_late_us))
+	{
+		hub_trace(HUB_TRACE_LATE);
+		hub_trace_on = false;
+		trace_state = HUB_TRACE_TRIGGERED;
+	}
+#else
+	(void)frame_us;
+#endif
+	trace_publish();
+}
@@ -0,0 +1,110 @@
+/*******************************************************************************
+* File Name:   hub_trace.h
+*
+* Description: Event trace. A ring of 32-bit events in SRAM records what the
+* firmware does and when: scan start and end, interrupt handler entry and
+* exit, EZI2C transactions, main loop task runs and sleep. Meant to answer
+* why a frame came late, which neither the averaged stats nor a debugger
+* (which stops the scans) can.
+*
+* Event layout: bits 31..24 event code (HUB_TRACE_*), bits 23..0 the SysTick
+* counter, which counts CPU cycles down from 0xFFFFFF. SysTick wraps are
+* recorded as events of their own so the host can rebuild a continuous time
+* (see Tools/hub_trace.cpp). Recording one event masks the interrupts for a
+* handful of instructions, the Cortex-M0+ has no exclusive access to make
+* the ring update lock-free.
+*
+* The host starts the trace, optionally armed to stop at the first frame
+* that took longer than a threshold, stops it and reads the ring through the
+* record window, HUB_TRACE_CHUNK events per HUB_CMD_TRACE_READ, oldest
+* first. Building with HUB_TRACE_ENABLE set to 0 removes the ring and turns
+* every hub_trace() call into nothing (production profile).
+*
+*******************************************************************************/
+#ifndef HUB_TRACE_H
+#define HUB_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "cy_pdl.h"
+#include "hub_regmap.h"
+
+#ifndef HUB_TRACE_ENABLE
+#define HUB_TRACE_ENABLE		(1)
+#endif
+
+/* Events in the ring, a power of two */
+#ifndef HUB_TRACE_DEPTH
+#define HUB_TRACE_DEPTH			(256u)
+#endif
+
+/* Events per HUB_CMD_TRACE_READ, one record window */
+#define HUB_TRACE_CHUNK			(HUB_REC_ROW_SIZE / 4u)
+
+/* Event codes, bits 31..24 of an event */
+#define HUB_TRACE_SCAN_START	(0x01u)	/* frame scan started, the first slot may wait out the adaptive idle time */
+#define HUB_TRACE_SCAN_END		(0x02u)	/* frame task took the finished scan */
+#define HUB_TRACE_PUBLISH		(0x03u)	/* frame published to the map */
+#define HUB_TRACE_I2C_START		(0x04u)	/* EZI2C address match, a host transaction begins */
+#define HUB_TRACE_I2C_STOP		(0x05u)	/* EZI2C stop condition */
+#define HUB_TRACE_SLEEP			(0x06u)	/* main loop enters CPU sleep */
+#define HUB_TRACE_WAKE			(0x07u)	/* main loop woke up */
+#define HUB_TRACE_WRAP			(0x08u)	/* SysTick wrapped, 0x1000000 cycles passed */
+#define HUB_TRACE_LATE			(0x09u)	/* frame over the armed threshold, the trace stops */
+#define HUB_TRACE_TASK_BEGIN	(0x10u)	/* + task index in priority order */
+#define HUB_TRACE_TASK_END		(0x20u)	/* + task index */
+#define HUB_TRACE_ISR_ENTER		(0x40u)	/* + exception number (IPSR) */
+#define HUB_TRACE_ISR_EXIT		(0x80u)	/* + exception number */
+
+_Static_assert(0u == (HUB_TRACE_DEPTH & (HUB_TRACE_DEPTH - 1u)), "HUB_TRACE_DEPTH must be a power of two");
+_Static_assert(0u == (HUB_TRACE_DEPTH % HUB_TRACE_CHUNK), "HUB_TRACE_DEPTH must be a multiple of HUB_TRACE_CHUNK");
+_Static_assert(HUB_MAX_TASKS <= 16u, "task events take 4 bits of the task index");
+
+#if HUB_TRACE_ENABLE
+extern uint32_t hub_trace_ring[HUB_TRACE_DEPTH];
+extern volatile uint32_t hub_trace_count;
+extern volatile bool hub_trace_on;
+
+/* Records one event, callable from any context */
+__STATIC_FORCEINLINE void hub_trace(uint32_t code)
+{
+	if(hub_trace_on)
+	{
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		uint32_t n = hub_trace_count;
+		hub_trace_ring[n & (HUB_TRACE_DEPTH - 1u)] = (code << 24) | SysTick->VAL;
+		hub_trace_count = n + 1u;
+		__set_PRIMASK(primask);
+	}
+}
+
+/* Records the entry or exit of the running interrupt handler */
+__STATIC_FORCEINLINE void hub_trace_isr(uint32_t code)
+{
+	hub_trace(code + (__get_IPSR() & 0x3Fu));
+}
+#else
+__STATIC_FORCEINLINE void hub_trace(uint32_t code)
+{
+	(void)code;
+}
+
+__STATIC_FORCEINLINE void hub_trace_isr(uint32_t code)
+{
+	(void)code;
+}
+#endif
+
+void hub_trace_init(hub_regmap_t *map);
+
+/* Command handlers, return HUB_RESULT_*. HUB_TRACE_RUNNING and
+ * HUB_TRACE_ARMED clear the ring and start recording, HUB_TRACE_OFF stops.
+ */
+uint8_t hub_trace_configure(uint8_t state, uint32_t late_us);
+uint8_t hub_trace_read(uint16_t chunk);
+
+/* Called once per frame with its period, stops an armed trace on a late frame */
+void hub_trace_frame(uint32_t frame_us);
+
+#endif /* HUB_TRACE_H */
@@ -0,0 +1,382 @@
+/*******************************************************************************
+* File Name:   hub_tune.c
+*
+* Description: Scan-parameter optimizer, see hub_tune.h
+*
+*******************************************************************************/
+#include <string.h>
+#include "cy_pdl.h"
+#include "cycfg_capsense.h"
+#include "hub_scan.h"
+#include "hub_settings.h"
+#include "hub_tune.h"
+
+static const uint16_t tune_nsub[] = HUB_TUNE_NSUB;
+static const int8_t tune_shift[] = HUB_TUNE_CLK_SHIFT;
+
+#define TUNE_CLK_COUNT			(sizeof(tune_shift) / sizeof(tune_shift[0]))
+#define TUNE_STEPS				((sizeof(tune_nsub) / sizeof(tune_nsub[0])) * TUNE_CLK_COUNT)
+
+_Static_assert(TUNE_STEPS <= 255u, "HUB_TUNE_NSUB x HUB_TUNE_CLK_SHIFT has too many steps");
+
+static hub_regmap_t *tune_map;
+static uint8_t tune_state;
+static bool tune_pending;
+static bool tune_save;
+static bool tune_failed;
+
+/* Generated sense clock dividers, taken at the first start */
+static uint16_t tune_clk_gen[CY_CAPSENSE_WIDGET_COUNT];
+static bool tune_clk_taken;
+
+/* Maximum raw count and signal of each widget when the sweep was started */
+static uint16_t tune_ref_max[CY_CAPSENSE_WIDGET_COUNT];
+static uint16_t tune_ref_signal[CY_CAPSENSE_WIDGET_COUNT];
+static uint16_t tune_target;
+
+/* Setting under test and the frames measured with it */
+static uint32_t tune_widget;
+static uint32_t tune_step;
+static uint32_t tune_frames;
+static uint16_t tune_min[NUM_OF_SENSORS];
+static uint16_t tune_max[NUM_OF_SENSORS];
+
+/* Fastest setting of the widget that reached the target */
+static uint32_t tune_best_cost;
+static uint16_t tune_best_nsub;
+static uint16_t tune_best_clk;
+static uint16_t tune_best_snr;
+
+/*******************************************************************************
+* Function Name: tune_clk
+********************************************************************************
+* Summary:
+*  Sense clock divider of a step for the widget under test, 0 if the shift
+*  leaves no valid divider.
+*
+*******************************************************************************/
+static uint16_t tune_clk(uint32_t step)
+{
+	int8_t shift = tune_shift[step % TUNE_CLK_COUNT];
+	uint32_t clk = tune_clk_gen[tune_widget];
+
+	clk = (shift < 0) ? (clk >> (uint32_t)(-shift)) : (clk << (uint32_t)shift);
+	return (clk > UINT16_MAX) ? 0u : (uint16_t)clk;
+}
+
+/*******************************************************************************
+* Function Name: tune_sensors
+********************************************************************************
+* Summary:
+*  First sensor of the widget under test and, through count, its sensors.
+*
+*******************************************************************************/
+static uint32_t tune_sensors(uint32_t widget, uint32_t *count)
+{
+	const cy_stc_capsense_widget_config_t *wd = &cy_capsense_context.ptrWdConfig[widget];
+
+	*count = wd->numSns;
+	return (uint32_t)(wd->ptrSnsContext - cy_capsense_tuner.sensorContext);
+}
+
+/*******************************************************************************
+* Function Name: tune_publish
+********************************************************************************
+* Summary:
+*  Shows the progress of the sweep in the stats block.
+*
+*******************************************************************************/
+static void tune_publish(void)
+{
+	tune_map->stats.tune_state = tune_state;
+	tune_map->stats.tune_widget = (uint8_t)tune_widget;
+	tune_map->stats.tune_step = (uint8_t)tune_step;
+}
+
+/*******************************************************************************
+* Function Name: tune_seek
+********************************************************************************
+* Summary:
+*  Moves to the next valid step, starting at the given widget and step.
+*  Widgets whose sensors are all masked off are not swept. Past the last
+*  widget the sweep is done and its result waits to be stored.
+*
+*******************************************************************************/
+static void tune_seek(uint32_t widget, uint32_t step)
+{
+	for(; widget < CY_CAPSENSE_WIDGET_COUNT; widget++, step = 0u)
+	{
+		uint32_t count;
+		uint32_t first = tune_sensors(widget, &count);
+		bool used = false;
+
+		for(uint32_t i = first; i < (first + count); i++)
+		{
+			used = used || hub_scan_sensor_enabled(i);
+		}
+		if(!used)
+		{
+			continue;
+		}
+
+		tune_widget = widget;
+		if(0u == step)
+		{
+			tune_best_cost = UINT32_MAX;
+		}
+		while((step < TUNE_STEPS) && (0u == tune_clk(step)))
+		{
+			step++;
+		}
+		if(step < TUNE_STEPS)
+		{
+			tune_step = step;
+			tune_frames = 0u;
+			tune_pending = true;
+			tune_publish();
+			return;
+		}
+
+		/* All steps of the widget are done */
+		if(UINT32_MAX != tune_best_cost)
+		{
+			hub_settings.tune[widget].nsub = tune_best_nsub;
+			hub_settings.tune[widget].snsclk = tune_best_clk;
+			if(tune_best_snr < tune_map->stats.tune_snr)
+			{
+				tune_map->stats.tune_snr = tune_best_snr;
+			}
+		}
+		else
+		{
+			tune_failed = true;
+		}
+	}
+
+	tune_state = tune_failed ? HUB_TUNE_FAILED : HUB_TUNE_DONE;
+	tune_save = true;
+	tune_pending = true;
+	tune_publish();
+}
+
+/*******************************************************************************
+* Function Name: tune_evaluate
+********************************************************************************
+* Summary:
+*  Computes the SNR of the measured step and keeps the step if it reaches
+*  the target at a lower scan time than the best one so far.
+*
+*******************************************************************************/
+static void tune_evaluate(uint32_t first, uint32_t count)
+{
+	const cy_stc_capsense_widget_context_t *ctx = &cy_capsense_tuner.widgetContext[tune_widget];
+	uint32_t noise = 1u;
+	uint32_t signal = tune_ref_signal[tune_widget];
+	uint16_t nsub = tune_nsub[tune_step / TUNE_CLK_COUNT];
+	uint16_t clk = tune_clk(tune_step);
+	uint32_t cost = (uint32_t)nsub * clk;
+
+	for(uint32_t i = first; i < (first + count); i++)
+	{
+		uint32_t pp = (uint32_t)tune_max[i] - tune_min[i];
+
+		noise = (pp > noise) ? pp : noise;
+	}
+	tune_map->stats.tune_noise = (uint16_t)noise;
+	if(0u != tune_ref_max[tune_widget])
+	{
+		signal = (signal * ctx->maxRawCount) / tune_ref_max[tune_widget];
+	}
+
+	uint32_t snr = (signal * 10u) / noise;
+
+	if((snr >= tune_target) && (cost < tune_best_cost))
+	{
+		tune_best_cost = cost;
+		tune_best_nsub = nsub;
+		tune_best_clk = clk;
+		tune_best_snr = (snr > UINT16_MAX) ? UINT16_MAX : (uint16_t)snr;
+	}
+}
+
+/*******************************************************************************
+* Function Name: hub_tune_init
+********************************************************************************
+* Summary:
+*  Publishes the idle optimizer.
+*
+*******************************************************************************/
+void hub_tune_init(hub_regmap_t *map)
+{
+	tune_map = map;
+	tune_publish();
+}
+
+/*******************************************************************************
+* Function Name: hub_tune_apply
+********************************************************************************
+* Summary:
+*  Overwrites the generated parameters of Cy_CapSense_Init() with the stored
+*  ones, and the widget under test with the setting of its step. Any restart
+*  during the sweep measures the step again from its first frame.
+*
+*******************************************************************************/
+void hub_tune_apply(void)
+{
+	for(uint32_t w = 0; w < CY_CAPSENSE_WIDGET_COUNT; w++)
+	{
+		cy_stc_capsense_widget_context_t *ctx = &cy_capsense_tuner.widgetContext[w];
+
+		if(!tune_clk_taken)
+		{
+			tune_clk_gen[w] = ctx->snsClk;
+		}
+		if(0u != hub_settings.tune[w].nsub)
+		{
+			ctx->numSubConversions = hub_settings.tune[w].nsub;
+		}
+		if(0u != hub_settings.tune[w].snsclk)
+		{
+			ctx->snsClk = hub_settings.tune[w].snsclk;
+		}
+	}
+	tune_clk_taken = true;
+
+	if(HUB_TUNE_RUNNING == tune_state)
+	{
+		cy_stc_capsense_widget_context_t *ctx = &cy_capsense_tuner.widgetContext[tune_widget];
+
+		ctx->numSubConversions = tune_nsub[tune_step / TUNE_CLK_COUNT];
+		ctx->snsClk = tune_clk(tune_step);
+		tune_frames = 0u;
+	}
+#if (CY_CAPSENSE_BIST_EN) && (CY_CAPSENSE_TST_WDGT_CRC_EN)
+	/* Keep the self-test from reporting the changed parameters as corrupted */
+	Cy_CapSense_UpdateAllWidgetCrc(&cy_capsense_context);
+#endif
+}
+
+/*******************************************************************************
+* Function Name: hub_tune_start
+********************************************************************************
+* Summary:
+*  Takes the reference of every widget from the running setting and starts
+*  the sweep with the first widget.
+*
+*******************************************************************************/
+uint8_t hub_tune_start(uint16_t snr_x10, uint16_t signal)
+{
+	if((HUB_TUNE_RUNNING == tune_state) || tune_pending)
+	{
+		return HUB_RESULT_FAILED;
+	}
+
+	if(0u == snr_x10)
+	{
+		memset(hub_settings.tune, 0, sizeof(hub_settings.tune));
+		tune_state = HUB_TUNE_IDLE;
+		tune_pending = true;
+		tune_publish();
+		return HUB_RESULT_OK;
+	}
+
+	for(uint32_t w = 0; w < CY_CAPSENSE_WIDGET_COUNT; w++)
+	{
+		const cy_stc_capsense_widget_context_t *ctx = &cy_capsense_tuner.widgetContext[w];
+
+		tune_ref_max[w] = ctx->maxRawCount;
+		tune_ref_signal[w] = (0u != signal) ? signal : (uint16_t)(((uint32_t)ctx->fingerTh * 5u) / 4u);
+	}
+	tune_target = snr_x10;
+	tune_failed = false;
+	tune_map->stats.tune_snr = UINT16_MAX;
+	tune_state = HUB_TUNE_RUNNING;
+	tune_seek(0u, 0u);
+	return HUB_RESULT_OK;
+}
+
+/*******************************************************************************
+* Function Name: hub_tune_frame
+********************************************************************************
+* Summary:
+*  Tracks the raw count range of the widget under test in the frames that
+*  scanned it. A step whose calibration failed is dropped at once.
+*
+*******************************************************************************/
+void hub_tune_frame(void)
+{
+	uint32_t count;
+	uint32_t first;
+
+	if((HUB_TUNE_RUNNING != tune_state) || tune_pending)
+	{
+		return;
+	}
+	first = tune_sensors(tune_widget, &count);
+	if(!hub_scan_sensor_updated(first))
+	{
+		return;
+	}
+	if(0u == (tune_map->status.flags & HUB_STATUS_CAL_OK))
+	{
+		tune_seek(tune_widget, tune_step + 1u);
+		return;
+	}
+
+	tune_frames++;
+	if(tune_frames <= HUB_TUNE_SETTLE)
+	{
+		return;
+	}
+	for(uint32_t i = first; i < (first + count); i++)
+	{
+		uint16_t raw = cy_capsense_tuner.sensorContext[i].raw;
+
+		if((HUB_TUNE_SETTLE + 1u) == tune_frames)
+		{
+			tune_min[i] = raw;
+			tune_max[i] = raw;
+		}
+		tune_min[i] = (raw < tune_min[i]) ? raw : tune_min[i];
+		tune_max[i] = (raw > tune_max[i]) ? raw : tune_max[i];
+	}
+	if(tune_frames >= (HUB_TUNE_SETTLE + HUB_TUNE_FRAMES))
+	{
+		tune_evaluate(first, count);
+		tune_seek(tune_widget, tune_step + 1u);
+	}
+}
+
+/*******************************************************************************
+* Function Name: hub_tune_pending
+********************************************************************************
+* Summary:
+*  Reports a setting or a result that waits for a CAPSENSE restart.
+*
+*******************************************************************************/
+bool hub_tune_pending(void)
+{
+	return tune_pending;
+}
+
+/*******************************************************************************
+* Function Name: hub_tune_restart
+********************************************************************************
+* Summary:
+*  Writes the settings to flash once the sweep is done, so the restart that
+*  follows already runs with the result.
+*
+*******************************************************************************/
+void hub_tune_restart(void)
+{
+	tune_pending = false;
+	if(tune_save)
+	{
+		tune_save = false;
+		if(!hub_settings_save())
+		{
+			tune_state = HUB_TUNE_FAILED;
+			tune_publish();
+		}
+	}
+}
@@ -0,0 +1,77 @@
+/*******************************************************************************
+* File Name:   hub_tune.h
+*
+* Description: Scan-parameter optimizer. Sweeps the number of sub-conversions
+* and the sense clock divider of every widget, measures the noise of each
+* setting and keeps the fastest one that reaches the SNR target of the host.
+* The scan time of a slot is proportional to sub-conversions times sense
+* clock divider, so that product is what the sweep minimizes.
+*
+* Each setting is applied by restarting the CAPSENSE block (the calibration
+* adapts the CDACs to it), then HUB_TUNE_SETTLE frames are skipped and the
+* peak-to-peak raw count noise of the widget's sensors is taken over
+* HUB_TUNE_FRAMES frames. The sensors must not be touched meanwhile. Frames
+* keep being published during the sweep, with the frame-valid flag cleared
+* while the baselines converge after each restart.
+*
+* The signal is not measured: it is given by the host in raw counts at the
+* running setting, or taken from the widget's finger threshold (80 % of the
+* signal). The calibration keeps the raw counts at the same fraction of the
+* maximum raw count, so the signal of another setting scales with its
+* maximum raw count. A setting whose calibration fails is skipped. Sense
+* clocks below the one of the Configurator are only safe as long as the
+* sensors still settle, which that calibration check covers only in part.
+*
+* The result is written to the settings in flash and applied before the
+* calibration of every start. Widgets without a setting that reaches the
+* target keep their parameters, and the sweep ends in HUB_TUNE_FAILED.
+*
+*******************************************************************************/
+#ifndef HUB_TUNE_H
+#define HUB_TUNE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hub_regmap.h"
+
+/* Sub-conversion counts of the sweep */
+#ifndef HUB_TUNE_NSUB
+#define HUB_TUNE_NSUB			{ 8u, 16u, 32u, 64u, 128u }
+#endif
+
+/* Sense clock dividers of the sweep, as a shift of the generated divider */
+#ifndef HUB_TUNE_CLK_SHIFT
+#define HUB_TUNE_CLK_SHIFT		{ -1, 0, 1 }
+#endif
+
+/* Frames skipped after each restart, and frames measured */
+#ifndef HUB_TUNE_SETTLE
+#define HUB_TUNE_SETTLE			(8u)
+#endif
+
+#ifndef HUB_TUNE_FRAMES
+#define HUB_TUNE_FRAMES			(32u)
+#endif
+
+void hub_tune_init(hub_regmap_t *map);
+
+/* Called between Cy_CapSense_Init() and Cy_CapSense_Enable(): writes the
+ * stored parameters, or the setting under test, into the widget contexts
+ */
+void hub_tune_apply(void);
+
+/* Command handler, return HUB_RESULT_*. An SNR target of 0 goes back to the
+ * generated parameters (working settings only).
+ */
+uint8_t hub_tune_start(uint16_t snr_x10, uint16_t signal);
+
+/* Measures the published frame */
+void hub_tune_frame(void);
+
+/* True while the sweep waits for a CAPSENSE restart */
+bool hub_tune_pending(void);
+
+/* Called right before that restart, stores the result once the sweep is done */
+void hub_tune_restart(void);
+
+#endif /* HUB_TUNE_H */
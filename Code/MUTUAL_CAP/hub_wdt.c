@@ -0,0 +1,195 @@
+/*******************************************************************************
+* File Name:   hub_wdt.c
+*
+* Description: Scan-stall detection and watchdog, see hub_wdt.h
+*
+*******************************************************************************/
+#include "cy_pdl.h"
+#include "hub_irq.h"
+#include "hub_time.h"
+#include "hub_wdt.h"
+
+#define WDT_TICKS_PER_MS		(HUB_WDT_ILO_HZ / 1000u)
+#define WDT_COUNTER_MASK		(0xFFFFu)
+
+_Static_assert((HUB_WDT_IDLE_MS * WDT_TICKS_PER_MS) < WDT_COUNTER_MASK, "HUB_WDT_IDLE_MS exceeds one WDT counter period");
+
+static hub_regmap_t *wdt_map;
+static uint8_t wdt_reset_cause;
+
+/* Running scan: start time and deadline */
+static bool wdt_armed;
+static uint32_t wdt_start_cycles;
+static uint32_t wdt_limit_us;
+
+/*******************************************************************************
+* Function Name: wdt_isr
+********************************************************************************
+* Summary:
+*  Only wakes the main loop, which feeds the watchdog. The match stays
+*  pending, so a hung main loop is reset.
+*
+*******************************************************************************/
+static void wdt_isr(void)
+{
+	Cy_WDT_MaskInterrupt();
+}
+
+/*******************************************************************************
+* Function Name: wdt_match
+********************************************************************************
+* Summary:
+*  Clears the pending match and sets the next one ms milliseconds from now.
+*
+*******************************************************************************/
+static void wdt_match(uint32_t ms)
+{
+	Cy_WDT_SetMatch((Cy_WDT_GetCount() + (ms * WDT_TICKS_PER_MS)) & WDT_COUNTER_MASK);
+	Cy_WDT_ClearInterrupt();
+}
+
+/*******************************************************************************
+* Function Name: hub_wdt_enable
+********************************************************************************
+* Summary:
+*  Takes the cause of the last reset and starts the WDT. Its interrupt is
+*  only enabled by hub_wdt_init(); until then a hang resets the hub.
+*
+*******************************************************************************/
+void hub_wdt_enable(void)
+{
+	uint32_t reason = Cy_SysLib_GetResetReason();
+
+	if(0u != (reason & CY_SYSLIB_RESET_HWWDT))
+	{
+		wdt_reset_cause = HUB_RESET_WATCHDOG;
+	}
+	else if(0u != (reason & CY_SYSLIB_RESET_SOFT))
+	{
+		wdt_reset_cause = HUB_RESET_SOFT;
+	}
+	else
+	{
+		wdt_reset_cause = HUB_RESET_POWER;
+	}
+	Cy_SysLib_ClearResetReason();
+
+	wdt_match(HUB_WDT_IDLE_MS);
+	Cy_WDT_Enable();
+}
+
+/*******************************************************************************
+* Function Name: hub_wdt_disable
+********************************************************************************
+* Summary:
+*  Stops the WDT, the installer runs for about a second with interrupts off.
+*
+*******************************************************************************/
+void hub_wdt_disable(void)
+{
+	Cy_WDT_Disable();
+}
+
+/*******************************************************************************
+* Function Name: hub_wdt_init
+********************************************************************************
+* Summary:
+*  Publishes the reset cause and lets the WDT match wake the CPU.
+*
+*******************************************************************************/
+void hub_wdt_init(hub_regmap_t *map)
+{
+	const cy_stc_sysint_t wdt_intr_config =
+	{
+		.intrSrc = HUB_WDT_IRQ,
+		.intrPriority = HUB_IRQ_PRIO_WDT,
+	};
+
+	wdt_map = map;
+	wdt_map->stats.reset_cause = wdt_reset_cause;
+
+	Cy_SysInt_Init(&wdt_intr_config, wdt_isr);
+	NVIC_ClearPendingIRQ(wdt_intr_config.intrSrc);
+	NVIC_EnableIRQ(wdt_intr_config.intrSrc);
+	hub_wdt_feed();
+}
+
+/*******************************************************************************
+* Function Name: hub_wdt_arm
+********************************************************************************
+* Summary:
+*  Gives the scan just started its deadline.
+*
+*******************************************************************************/
+void hub_wdt_arm(uint32_t delay_us)
+{
+	wdt_start_cycles = hub_time_cycles();
+	wdt_limit_us = delay_us + (HUB_WDT_STALL_MS * 1000u);
+	wdt_armed = true;
+}
+
+/*******************************************************************************
+* Function Name: hub_wdt_disarm
+********************************************************************************
+* Summary:
+*  The scan has finished.
+*
+*******************************************************************************/
+void hub_wdt_disarm(void)
+{
+	wdt_armed = false;
+}
+
+/*******************************************************************************
+* Function Name: hub_wdt_stalled
+********************************************************************************
+* Summary:
+*  Reports a scan that is still running past its deadline.
+*
+*******************************************************************************/
+bool hub_wdt_stalled(void)
+{
+	return wdt_armed && (hub_time_cycles_to_us(hub_time_cycles() - wdt_start_cycles) > wdt_limit_us);
+}
+
+/*******************************************************************************
+* Function Name: hub_wdt_feed
+********************************************************************************
+* Summary:
+*  Services the WDT. The next match comes at the deadline of the running
+*  scan (rounded up to the next millisecond), otherwise after the idle
+*  period. The ILO is not trimmed, an early wake-up just feeds again.
+*
+*******************************************************************************/
+void hub_wdt_feed(void)
+{
+	uint32_t ms = HUB_WDT_IDLE_MS;
+
+	if(wdt_armed)
+	{
+		uint32_t elapsed_us = hub_time_cycles_to_us(hub_time_cycles() - wdt_start_cycles);
+		uint32_t left_ms = (elapsed_us < wdt_limit_us) ? (((wdt_limit_us - elapsed_us) / 1000u) + 1u) : 1u;
+
+		ms = (left_ms < ms) ? left_ms : ms;
+	}
+	wdt_match(ms);
+	Cy_WDT_UnmaskInterrupt();
+}
+
+/*******************************************************************************
+* Function Name: hub_wdt_recovered
+********************************************************************************
+* Summary:
+*  Counts the recovery and publishes the outage since the stalled scan
+*  started.
+*
+*******************************************************************************/
+void hub_wdt_recovered(void)
+{
+	wdt_map->stats.recover_us = hub_time_cycles_to_us(hub_time_cycles() - wdt_start_cycles);
+	if(wdt_map->stats.stalls < UINT16_MAX)
+	{
+		wdt_map->stats.stalls++;
+	}
+	wdt_armed = false;
+}
@@ -0,0 +1,164 @@
+/*******************************************************************************
+* File Name:   hub_xtalk.c
+*
+* Description: Cross-talk compensation of the diff counts, see hub_xtalk.h
+*
+*******************************************************************************/
+#include "cy_pdl.h"
+#include "cycfg_capsense.h"
+#include "hub_scan.h"
+#include "hub_settings.h"
+#include "hub_time.h"
+#include "hub_xtalk.h"
+
+#define XTALK_Q					(14u)
+
+static hub_regmap_t *xtalk_map;
+static bool xtalk_identity = true;
+static uint16_t xtalk_in[NUM_OF_SENSORS];
+static uint16_t xtalk_out[NUM_OF_SENSORS];
+
+/*******************************************************************************
+* Function Name: xtalk_update
+********************************************************************************
+* Summary:
+*  Falls back to the identity matrix if the stored one was made for another
+*  sensor count, and remembers whether the kernel can be skipped.
+*
+*******************************************************************************/
+static void xtalk_update(void)
+{
+	if((uint8_t)NUM_OF_SENSORS != hub_settings.xtalk_n)
+	{
+		for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+		{
+			for(uint32_t j = 0; j < NUM_OF_SENSORS; j++)
+			{
+				hub_settings.xtalk[i][j] = (i == j) ? HUB_XTALK_ONE : 0;
+			}
+		}
+		hub_settings.xtalk_n = (uint8_t)NUM_OF_SENSORS;
+	}
+
+	xtalk_identity = true;
+	for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+	{
+		for(uint32_t j = 0; j < NUM_OF_SENSORS; j++)
+		{
+			if(hub_settings.xtalk[i][j] != ((i == j) ? HUB_XTALK_ONE : 0))
+			{
+				xtalk_identity = false;
+			}
+		}
+	}
+}
+
+/*******************************************************************************
+* Function Name: xtalk_kernel
+********************************************************************************
+* Summary:
+*  Matrix-vector product for the Cortex-M0+: one 32-bit MULS per element
+*  (|coefficient| * 65535 fits in 31 bits), rows and inputs walked with
+*  post-incremented pointers, and the 64-bit accumulation only needs an
+*  ADDS/ADCS pair, so no library call and no division. Rounding and clamping
+*  happen once per row.
+*
+*******************************************************************************/
+static void xtalk_kernel(const int16_t *m, const uint16_t *in, uint16_t *out)
+{
+	for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+	{
+		const uint16_t *x = in;
+		int64_t acc = (int64_t)1 << (XTALK_Q - 1u);
+
+		for(uint32_t j = NUM_OF_SENSORS; j != 0u; j--)
+		{
+			acc += (int32_t)(*m++) * (int32_t)(*x++);
+		}
+
+		acc >>= XTALK_Q;
+		*out++ = (acc < 0) ? 0u : ((acc > UINT16_MAX) ? UINT16_MAX : (uint16_t)acc);
+	}
+}
+
+/*******************************************************************************
+* Function Name: hub_xtalk_init
+********************************************************************************
+* Summary:
+*  Takes the matrix from the loaded settings.
+*
+*******************************************************************************/
+void hub_xtalk_init(hub_regmap_t *map)
+{
+	xtalk_map = map;
+	xtalk_update();
+}
+
+/*******************************************************************************
+* Function Name: hub_xtalk_set
+********************************************************************************
+* Summary:
+*  Stores little-endian coefficients. The matrix is used as soon as the
+*  command completes, so hosts loading it in several chunks see a mix of old
+*  and new rows for a few frames.
+*
+*******************************************************************************/
+bool hub_xtalk_set(uint32_t first, uint32_t count, const uint8_t *coeffs)
+{
+	int16_t *m = &hub_settings.xtalk[0][0];
+
+	if((0u == count) || ((first + count) > (NUM_OF_SENSORS * NUM_OF_SENSORS)))
+	{
+		return false;
+	}
+	for(uint32_t k = 0; k < count; k++)
+	{
+		m[first + k] = (int16_t)(coeffs[2u * k] | ((uint16_t)coeffs[(2u * k) + 1u] << 8));
+	}
+	xtalk_update();
+	return true;
+}
+
+/*******************************************************************************
+* Function Name: hub_xtalk_apply
+********************************************************************************
+* Summary:
+*  Collects the diff counts, runs the kernel and publishes its run time in
+*  CPU cycles. With the identity matrix the diff counts pass unchanged.
+*
+*******************************************************************************/
+void hub_xtalk_apply(void)
+{
+	uint32_t start = hub_time_cycles();
+
+	for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+	{
+		xtalk_in[i] = hub_scan_sensor_enabled(i) ? cy_capsense_tuner.sensorContext[i].diff : 0u;
+	}
+
+	if(xtalk_identity)
+	{
+		for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+		{
+			xtalk_out[i] = xtalk_in[i];
+		}
+	}
+	else
+	{
+		xtalk_kernel(&hub_settings.xtalk[0][0], xtalk_in, xtalk_out);
+	}
+
+	xtalk_map->stats.xtalk_cycles = hub_time_cycles() - start;
+}
+
+/*******************************************************************************
+* Function Name: hub_xtalk_diff
+********************************************************************************
+* Summary:
+*  Returns one compensated diff count.
+*
+*******************************************************************************/
+uint16_t hub_xtalk_diff(uint32_t sensor)
+{
+	return xtalk_out[sensor];
+}
@@ -0,0 +1,41 @@
+/*******************************************************************************
+* File Name:   hub_bist.h
+*
+* Description: Background CAPSENSE built-in self-test. Instead of one blocking
+* pass over all sensors, the test runs one electrode per step, and a step only
+* takes the place of a scan every HUB_BIST_INTERVAL frames. A full pass over
+* N electrodes thus takes N * HUB_BIST_INTERVAL frames while the frame rate
+* drops by less than one frame per interval.
+*
+* Each step checks the electrode pins for shorts and measures the electrode
+* capacitance (Cp); the first step of each widget also checks its CRC. The
+* tests that are not enabled in the CAPSENSE Configurator are skipped.
+*
+*******************************************************************************/
+#ifndef HUB_BIST_H
+#define HUB_BIST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hub_regmap.h"
+
+/* Default number of frames between two BIST steps, 0 disables the BIST */
+#ifndef HUB_BIST_INTERVAL
+#define HUB_BIST_INTERVAL		(100u)
+#endif
+
+void hub_bist_init(hub_regmap_t *map);
+
+/* Sets the number of frames between two steps, 0 disables the BIST */
+void hub_bist_set_interval(uint16_t frames);
+
+/* Counts a published frame. Returns true if the next slot belongs to the BIST. */
+bool hub_bist_frame(void);
+
+/* True while a step is waiting for the scan hardware to become free */
+bool hub_bist_pending(void);
+
+/* Runs one step. Blocking for the duration of one electrode measurement. */
+void hub_bist_step(void);
+
+#endif /* HUB_BIST_H */
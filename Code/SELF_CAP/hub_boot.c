@@ -0,0 +1,567 @@
+/*******************************************************************************
+* File Name:   hub_boot.c
+*
+* Description: Firmware update over the register map, see hub_boot.h
+*
+*******************************************************************************/
+#include <string.h>
+#include "cy_pdl.h"
+#include "hub_boot.h"
+#include "hub_crc.h"
+#include "hub_irq.h"
+#include "hub_loader.h"
+#include "hub_settings.h"
+#include "hub_wdt.h"
+
+#define BOOT_ROW				(CY_FLASH_SIZEOF_ROW)
+#define BOOT_STAGE_ROWS			(HUB_BOOT_STAGE_SIZE / BOOT_ROW)
+
+_Static_assert(HUB_REC_ROW_SIZE == CY_FLASH_SIZEOF_ROW, "update rows come through the record window");
+_Static_assert((HUB_BOOT_STAGE_SIZE % CY_FLASH_SIZEOF_ROW) == 0u, "staging area must be whole rows");
+_Static_assert(sizeof(hub_settings_t) <= (HUB_LOADER_CARRY_ROWS * CY_FLASH_SIZEOF_ROW), "settings must fit the carry rows of the loader");
+
+static hub_regmap_t *boot_map;
+
+#if HUB_BOOT_ENABLE
+
+/* Staging area at the end of the boot area (see hub_boot.ld). It stays
+ * outside the application region, so the loader copies from rows it never
+ * writes.
+ */
+CY_SECTION(".hub_boot.stage") CY_ALIGN(CY_FLASH_SIZEOF_ROW)
+static const volatile uint8_t boot_stage[HUB_BOOT_STAGE_SIZE] = {0u};
+
+static const uint8_t boot_key[] = HUB_BOOT_KEY;
+
+_Static_assert(sizeof(boot_key) <= 64u, "HMAC key must fit one SHA-256 block");
+
+static bool boot_active;
+static uint16_t boot_rows;
+static uint32_t boot_staged[(BOOT_STAGE_ROWS + 31u) / 32u];
+
+/* SHA-256 state */
+typedef struct
+{
+	uint32_t h[8];
+	uint8_t block[64];
+	uint32_t fill;
+	uint32_t total;
+} sha256_t;
+
+static const uint32_t sha256_k[64] =
+{
+	0x428a2f98u, 0x71374491u, 0xb5c0fbcfu, 0xe9b5dba5u, 0x3956c25bu, 0x59f111f1u, 0x923f82a4u, 0xab1c5ed5u,
+	0xd807aa98u, 0x12835b01u, 0x243185beu, 0x550c7dc3u, 0x72be5d74u, 0x80deb1feu, 0x9bdc06a7u, 0xc19bf174u,
+	0xe49b69c1u, 0xefbe4786u, 0x0fc19dc6u, 0x240ca1ccu, 0x2de92c6fu, 0x4a7484aau, 0x5cb0a9dcu, 0x76f988dau,
+	0x983e5152u, 0xa831c66du, 0xb00327c8u, 0xbf597fc7u, 0xc6e00bf3u, 0xd5a79147u, 0x06ca6351u, 0x14292967u,
+	0x27b70a85u, 0x2e1b2138u, 0x4d2c6dfcu, 0x53380d13u, 0x650a7354u, 0x766a0abbu, 0x81c2c92eu, 0x92722c85u,
+	0xa2bfe8a1u, 0xa81a664bu, 0xc24b8b70u, 0xc76c51a3u, 0xd192e819u, 0xd6990624u, 0xf40e3585u, 0x106aa070u,
+	0x19a4c116u, 0x1e376c08u, 0x2748774cu, 0x34b0bcb5u, 0x391c0cb3u, 0x4ed8aa4au, 0x5b9cca4fu, 0x682e6ff3u,
+	0x748f82eeu, 0x78a5636fu, 0x84c87814u, 0x8cc70208u, 0x90befffau, 0xa4506cebu, 0xbef9a3f7u, 0xc67178f2u,
+};
+
+/*******************************************************************************
+* Function Name: ror
+********************************************************************************
+* Summary:
+*  32-bit rotate right.
+*
+*******************************************************************************/
+static inline uint32_t ror(uint32_t x, uint32_t n)
+{
+	return (x >> n) | (x << (32u - n));
+}
+
+/*******************************************************************************
+* Function Name: sha256_block
+********************************************************************************
+* Summary:
+*  Compresses one 64-byte block. The message schedule is kept as a rolling
+*  16-word window to save stack.
+*
+*******************************************************************************/
+static void sha256_block(sha256_t *s)
+{
+	uint32_t w[16];
+	uint32_t v[8];
+
+	for(uint32_t i = 0; i < 16u; i++)
+	{
+		w[i] = ((uint32_t)s->block[4u * i] << 24) | ((uint32_t)s->block[4u * i + 1u] << 16) |
+			   ((uint32_t)s->block[4u * i + 2u] << 8) | (uint32_t)s->block[4u * i + 3u];
+	}
+	memcpy(v, s->h, sizeof(v));
+
+	for(uint32_t i = 0; i < 64u; i++)
+	{
+		if(i >= 16u)
+		{
+			uint32_t w15 = w[(i + 1u) & 15u];
+			uint32_t w2 = w[(i + 14u) & 15u];
+
+			w[i & 15u] += (ror(w15, 7u) ^ ror(w15, 18u) ^ (w15 >> 3)) + w[(i + 9u) & 15u] +
+						  (ror(w2, 17u) ^ ror(w2, 19u) ^ (w2 >> 10));
+		}
+
+		uint32_t t1 = v[7] + (ror(v[4], 6u) ^ ror(v[4], 11u) ^ ror(v[4], 25u)) +
+					  ((v[4] & v[5]) ^ (~v[4] & v[6])) + sha256_k[i] + w[i & 15u];
+		uint32_t t2 = (ror(v[0], 2u) ^ ror(v[0], 13u) ^ ror(v[0], 22u)) +
+					  ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));
+
+		v[7] = v[6];
+		v[6] = v[5];
+		v[5] = v[4];
+		v[4] = v[3] + t1;
+		v[3] = v[2];
+		v[2] = v[1];
+		v[1] = v[0];
+		v[0] = t1 + t2;
+	}
+
+	for(uint32_t i = 0; i < 8u; i++)
+	{
+		s->h[i] += v[i];
+	}
+}
+
+/*******************************************************************************
+* Function Name: sha256_init
+********************************************************************************
+* Summary:
+*  Loads the initial hash values.
+*
+*******************************************************************************/
+static void sha256_init(sha256_t *s)
+{
+	static const uint32_t h0[8] =
+	{
+		0x6a09e667u, 0xbb67ae85u, 0x3c6ef372u, 0xa54ff53au, 0x510e527fu, 0x9b05688cu, 0x1f83d9abu, 0x5be0cd19u,
+	};
+
+	memcpy(s->h, h0, sizeof(h0));
+	s->fill = 0u;
+	s->total = 0u;
+}
+
+/*******************************************************************************
+* Function Name: sha256_update
+********************************************************************************
+* Summary:
+*  Hashes len bytes. The staged image is read straight from flash.
+*
+*******************************************************************************/
+static void sha256_update(sha256_t *s, const volatile uint8_t *data, uint32_t len)
+{
+	for(uint32_t i = 0; i < len; i++)
+	{
+		s->block[s->fill++] = data[i];
+		if(64u == s->fill)
+		{
+			sha256_block(s);
+			s->fill = 0u;
+		}
+	}
+	s->total += len;
+}
+
+/*******************************************************************************
+* Function Name: sha256_final
+********************************************************************************
+* Summary:
+*  Pads the message with its bit length and writes the 32-byte digest.
+*
+*******************************************************************************/
+static void sha256_final(sha256_t *s, uint8_t *digest)
+{
+	uint32_t bits = s->total << 3;
+
+	s->block[s->fill++] = 0x80u;
+	if(s->fill > 56u)
+	{
+		memset(&s->block[s->fill], 0, 64u - s->fill);
+		sha256_block(s);
+		s->fill = 0u;
+	}
+	memset(&s->block[s->fill], 0, 60u - s->fill);
+	s->block[60] = (uint8_t)(bits >> 24);
+	s->block[61] = (uint8_t)(bits >> 16);
+	s->block[62] = (uint8_t)(bits >> 8);
+	s->block[63] = (uint8_t)bits;
+	sha256_block(s);
+
+	for(uint32_t i = 0; i < 8u; i++)
+	{
+		digest[4u * i] = (uint8_t)(s->h[i] >> 24);
+		digest[4u * i + 1u] = (uint8_t)(s->h[i] >> 16);
+		digest[4u * i + 2u] = (uint8_t)(s->h[i] >> 8);
+		digest[4u * i + 3u] = (uint8_t)s->h[i];
+	}
+}
+
+/*******************************************************************************
+* Function Name: hmac_key_block
+********************************************************************************
+* Summary:
+*  Starts a hash with the key XOR pad as its first block.
+*
+*******************************************************************************/
+static void hmac_key_block(sha256_t *s, uint8_t pad)
+{
+	sha256_init(s);
+	for(uint32_t i = 0; i < 64u; i++)
+	{
+		s->block[i] = (uint8_t)(((i < sizeof(boot_key)) ? boot_key[i] : 0u) ^ pad);
+	}
+	s->fill = 64u;
+	sha256_block(s);
+	s->fill = 0u;
+	s->total = 64u;
+}
+
+/*******************************************************************************
+* Function Name: row_equal
+********************************************************************************
+* Summary:
+*  Compares a flash row with a row of data.
+*
+*******************************************************************************/
+static bool row_equal(uint32_t addr, const volatile uint8_t *data)
+{
+	const volatile uint8_t *flash = (const volatile uint8_t *)(uintptr_t)addr;
+
+	for(uint32_t i = 0; i < BOOT_ROW; i++)
+	{
+		if(flash[i] != data[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/*******************************************************************************
+* Function Name: write_row
+********************************************************************************
+* Summary:
+*  Writes len bytes into a flash row, the rest of the row is zero, and reads
+*  it back.
+*
+*******************************************************************************/
+static bool write_row(uint32_t addr, const void *data, uint32_t len)
+{
+	uint32_t row[BOOT_ROW / sizeof(uint32_t)];
+
+	memset(row, 0, sizeof(row));
+	memcpy(row, data, (len < BOOT_ROW) ? len : BOOT_ROW);
+	return (CY_FLASH_DRV_SUCCESS == hub_irq_flash_write_row(addr, row)) && row_equal(addr, (const uint8_t *)row);
+}
+
+/*******************************************************************************
+* Function Name: range_ok
+********************************************************************************
+* Summary:
+*  Checks a flash range of the manifest: whole rows, behind the image and
+*  inside the application region, away from the loader and the boot area.
+*
+*******************************************************************************/
+static bool range_ok(uint32_t addr, uint32_t size, uint32_t image_end)
+{
+	uint32_t end = (uint32_t)__hub_app_end;
+
+	if(0u == addr)
+	{
+		return true;
+	}
+	return ((addr % BOOT_ROW) == 0u) && (addr >= image_end) && (addr <= end) && (size <= (end - addr));
+}
+
+/*******************************************************************************
+* Function Name: boot_publish
+********************************************************************************
+* Summary:
+*  Updates the updater state in the stats block.
+*
+*******************************************************************************/
+static void boot_publish(void)
+{
+	boot_map->stats.boot_rows = (uint16_t)BOOT_STAGE_ROWS;
+	boot_map->stats.boot_state = boot_active ? HUB_BOOT_RECEIVING : HUB_BOOT_IDLE;
+}
+
+/*******************************************************************************
+* Function Name: hub_boot_init
+********************************************************************************
+* Summary:
+*  Publishes the size of the staging area.
+*
+*******************************************************************************/
+void hub_boot_init(hub_regmap_t *map)
+{
+	boot_map = map;
+	boot_publish();
+}
+
+/*******************************************************************************
+* Function Name: hub_boot_active
+********************************************************************************
+* Summary:
+*  An update is in progress, the main loop keeps the scanning stopped.
+*
+*******************************************************************************/
+bool hub_boot_active(void)
+{
+	return boot_active;
+}
+
+/*******************************************************************************
+* Function Name: boot_end
+********************************************************************************
+* Summary:
+*  Ends an update that will not be installed. Staged rows stay in flash, a
+*  new attempt skips the ones that match. Scanning resumes and the main loop
+*  makes the map read-only again.
+*
+*******************************************************************************/
+static uint8_t boot_end(uint8_t result)
+{
+	boot_active = false;
+	boot_publish();
+	return result;
+}
+
+/*******************************************************************************
+* Function Name: hub_boot_begin
+********************************************************************************
+* Summary:
+*  Starts receiving an image of the given rows. Rows staged by an earlier,
+*  interrupted attempt stay in flash and are skipped when they match.
+*
+*******************************************************************************/
+uint8_t hub_boot_begin(uint16_t rows)
+{
+	if((rows < 2u) || (rows > BOOT_STAGE_ROWS))
+	{
+		return HUB_RESULT_BAD_ARG;
+	}
+	memset(boot_staged, 0, sizeof(boot_staged));
+	boot_rows = rows;
+	boot_active = true;
+	boot_publish();
+	return HUB_RESULT_OK;
+}
+
+/*******************************************************************************
+* Function Name: hub_boot_write
+********************************************************************************
+* Summary:
+*  Stages the row in the record window. A bad CRC returns HUB_RESULT_BAD_ARG
+*  and the host sends the row again.
+*
+*******************************************************************************/
+uint8_t hub_boot_write(void)
+{
+	uint32_t row[BOOT_ROW / sizeof(uint32_t)];
+	uint16_t index = boot_map->rec.index;
+
+	if(!boot_active)
+	{
+		return HUB_RESULT_FAILED;
+	}
+	if(index >= boot_rows)
+	{
+		return HUB_RESULT_BAD_ARG;
+	}
+	memcpy(row, boot_map->rec.data, sizeof(row));
+	if(hub_crc16((const uint8_t *)row, sizeof(row)) != boot_map->rec.crc)
+	{
+		return HUB_RESULT_BAD_ARG;
+	}
+
+	uint32_t addr = (uint32_t)&boot_stage[(uint32_t)index * BOOT_ROW];
+
+	if(!row_equal(addr, (const uint8_t *)row))
+	{
+		if((CY_FLASH_DRV_SUCCESS != hub_irq_flash_write_row(addr, row)) || !row_equal(addr, (const uint8_t *)row))
+		{
+			return HUB_RESULT_FAILED;
+		}
+	}
+	boot_staged[index / 32u] |= 1uL << (index % 32u);
+	return HUB_RESULT_OK;
+}
+
+/*******************************************************************************
+* Function Name: hub_boot_abort
+********************************************************************************
+* Summary:
+*  Ends the update without installing anything.
+*
+*******************************************************************************/
+uint8_t hub_boot_abort(void)
+{
+	if(!boot_active)
+	{
+		return HUB_RESULT_FAILED;
+	}
+	return boot_end(HUB_RESULT_OK);
+}
+
+/*******************************************************************************
+* Function Name: hub_boot_commit
+********************************************************************************
+* Summary:
+*  Checks the staged image and hands it to the resident loader: the working
+*  settings go into the carry rows, then the install job row is written and
+*  the hub resets. The job row is the point of no return; until it is in
+*  flash nothing of the running firmware has been touched. Missing rows can
+*  still be sent; any other failure ends the update and the hub goes back to
+*  scanning.
+*
+*******************************************************************************/
+uint8_t hub_boot_commit(void)
+{
+	hub_boot_manifest_t m;
+	hub_loader_job_t job;
+	uint8_t mac[HUB_BOOT_MAC_SIZE];
+	uint8_t diff = 0u;
+	sha256_t s;
+
+	if(!boot_active)
+	{
+		return HUB_RESULT_FAILED;
+	}
+	for(uint32_t i = 0; i < boot_rows; i++)
+	{
+		if(0u == (boot_staged[i / 32u] & (1uL << (i % 32u))))
+		{
+			return HUB_RESULT_BAD_ARG;
+		}
+	}
+
+	const volatile uint8_t *manifest = &boot_stage[(uint32_t)(boot_rows - 1u) * BOOT_ROW];
+	uint32_t size = (uint32_t)(boot_rows - 1u) * BOOT_ROW;
+	uint32_t base = (uint32_t)__hub_app_start;
+
+	for(uint32_t i = 0; i < sizeof(m); i++)
+	{
+		((uint8_t *)&m)[i] = manifest[i];
+	}
+	if((HUB_BOOT_MAGIC != m.magic) || (m.size != size) || (m.base != base) ||
+	   !range_ok(base, size, base) ||
+	   !range_ok(m.settings_addr, sizeof(hub_settings), base + size) ||
+	   !range_ok(m.clear_addr, m.clear_size, base + size) || ((m.clear_size % BOOT_ROW) != 0u))
+	{
+		return boot_end(HUB_RESULT_FAILED);
+	}
+	if(hub_loader_crc32(boot_stage, size) != m.crc)
+	{
+		return boot_end(HUB_RESULT_FAILED);
+	}
+
+	/* HMAC = H((K ^ opad) | H((K ^ ipad) | image | manifest)) */
+	hmac_key_block(&s, 0x36u);
+	sha256_update(&s, boot_stage, size);
+	sha256_update(&s, manifest, offsetof(hub_boot_manifest_t, mac));
+	sha256_final(&s, mac);
+	hmac_key_block(&s, 0x5Cu);
+	sha256_update(&s, mac, sizeof(mac));
+	sha256_final(&s, mac);
+	for(uint32_t i = 0; i < sizeof(mac); i++)
+	{
+		diff |= (uint8_t)(mac[i] ^ m.mac[i]);
+	}
+	if(0u != diff)
+	{
+		return boot_end(HUB_RESULT_FAILED);
+	}
+
+	hub_settings_seal();
+	for(uint32_t offset = 0; offset < sizeof(hub_settings); offset += BOOT_ROW)
+	{
+		if(!write_row((uint32_t)&hub_loader_carry[offset], &((const uint8_t *)&hub_settings)[offset],
+					  sizeof(hub_settings) - offset))
+		{
+			return boot_end(HUB_RESULT_FAILED);
+		}
+	}
+
+	memset(&job, 0, sizeof(job));
+	job.magic = HUB_LOADER_MAGIC;
+	job.src = (uint32_t)boot_stage;
+	job.dst = base;
+	job.size = size;
+	job.crc = m.crc;
+	job.settings_dst = m.settings_addr;
+	job.settings_size = sizeof(hub_settings);
+	job.clear_addr = m.clear_addr;
+	job.clear_size = m.clear_size;
+	job.check = hub_loader_crc32((const uint8_t *)&job, offsetof(hub_loader_job_t, check));
+	if(!write_row((uint32_t)&hub_loader_job, &job, sizeof(job)))
+	{
+		return boot_end(HUB_RESULT_FAILED);
+	}
+
+	hub_wdt_disable();
+	NVIC_SystemReset();
+	return HUB_RESULT_FAILED;
+}
+
+#else /* !HUB_BOOT_ENABLE */
+
+/*******************************************************************************
+* Function Name: hub_boot_init
+********************************************************************************
+* Summary:
+*  Without a signing key the updater is left out; boot_rows = 0 tells the
+*  host.
+*
+*******************************************************************************/
+void hub_boot_init(hub_regmap_t *map)
+{
+	boot_map = map;
+	boot_map->stats.boot_rows = 0u;
+	boot_map->stats.boot_state = HUB_BOOT_IDLE;
+}
+
+/*******************************************************************************
+* Function Name: hub_boot_active
+********************************************************************************
+* Summary:
+*  Never active without the updater.
+*
+*******************************************************************************/
+bool hub_boot_active(void)
+{
+	return false;
+}
+
+/*******************************************************************************
+* Function Name: hub_boot_begin / hub_boot_write / hub_boot_commit /
+*                hub_boot_abort
+********************************************************************************
+* Summary:
+*  The update commands are unknown without the updater.
+*
+*******************************************************************************/
+uint8_t hub_boot_begin(uint16_t rows)
+{
+	(void)rows;
+	return HUB_RESULT_BAD_CMD;
+}
+
+uint8_t hub_boot_write(void)
+{
+	return HUB_RESULT_BAD_CMD;
+}
+
+uint8_t hub_boot_commit(void)
+{
+	return HUB_RESULT_BAD_CMD;
+}
+
+uint8_t hub_boot_abort(void)
+{
+	return HUB_RESULT_BAD_CMD;
+}
+
+#endif /* HUB_BOOT_ENABLE */
@@ -0,0 +1,123 @@
+/*******************************************************************************
+* File Name:   hub_boot.h
+*
+* Description: Firmware update over the EZI2C register map. The host stages a
+* new image in a reserved flash area row by row, the hub checks it and hands
+* it to the resident loader (hub_loader.h), which installs it on the next
+* boot.
+*
+* Update image (made by Tools/hub_update.py from the ELF file):
+*
+*   rows 0..n-2   application flash from __hub_app_start up to the emulated
+*                 EEPROM section (loader, settings, recorder, staging area
+*                 are not part of the image)
+*   row n-1       hub_boot_manifest_t
+*
+* Sequence:
+*
+*   HUB_CMD_BOOT_BEGIN   n rows; scanning stops, the record window becomes
+*                        writable
+*   HUB_CMD_BOOT_WRITE   once per row: the host writes {index, crc, data} to
+*                        the record window first. Rows may come in any order
+*                        and may be repeated; a row equal to the staged one
+*                        is not written again, so an interrupted upload
+*                        resumes at I2C speed.
+*   HUB_CMD_BOOT_COMMIT  checks the manifest, the CRC-32 and the HMAC-SHA256
+*                        of the whole image, stores the working settings and
+*                        an install job for the loader and resets. Returns
+*                        HUB_RESULT_FAILED and keeps the running firmware if
+*                        anything does not match; the update ends and the
+*                        hub scans again (HUB_RESULT_BAD_ARG: rows are
+*                        missing, the update stays open for them).
+*   HUB_CMD_BOOT_ABORT   ends an open update without installing it, e.g.
+*                        when the host gives up on a rejected image.
+*
+* The loader copies the image, carries the settings over into the new image
+* and starts it. A power loss during the install is safe: the job stays in
+* flash until the installed image checks out, and the next boot finishes it.
+* Only a build linked with hub_boot.ld has the loader, and hubs get it once
+* over SWD; the Makefile picks the script whenever hub_boot_key.h exists.
+*
+* Key handling: the HMAC key lives in hub_boot_key.h (made by
+* "hub_update.py keygen", not part of the repository) and is compiled into
+* every hub of the fleet; builds without it have no updater. HMAC is a
+* symmetric check, the key that verifies an image also signs one. Anyone who
+* reads the flash of a single hub (SWD, a discarded or stolen unit) can sign
+* images that every hub with the same key accepts. Use one key per fleet or
+* customer rather than one for all, and set the flash and chip protection of
+* production parts so the key cannot be read out over SWD. The check guards
+* against corrupted or foreign images, not against an attacker with physical
+* access to any one unit.
+*
+*******************************************************************************/
+#ifndef HUB_BOOT_H
+#define HUB_BOOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hub_regmap.h"
+
+#if !defined(HUB_BOOT_KEY) && defined(__has_include)
+#if __has_include("hub_boot_key.h")
+#include "hub_boot_key.h"
+#endif
+#endif
+
+/* The updater is built in when a signing key is available */
+#ifndef HUB_BOOT_ENABLE
+#ifdef HUB_BOOT_KEY
+#define HUB_BOOT_ENABLE			(1)
+#else
+#define HUB_BOOT_ENABLE			(0)
+#endif
+#endif
+
+#if HUB_BOOT_ENABLE && !defined(HUB_BOOT_KEY)
+#error "HUB_BOOT_ENABLE needs HUB_BOOT_KEY, run Tools/hub_update.py keygen"
+#endif
+
+/* Staging area for the update image including its manifest row. It has to
+ * hold the largest application and fills the boot region of hub_boot.ld
+ * behind the install job and the carry rows; the linker fails if they do
+ * not fit.
+ */
+#ifndef HUB_BOOT_STAGE_SIZE
+#define HUB_BOOT_STAGE_SIZE		(26u * 1024u)
+#endif
+
+/* "HUB2": images for the loader layout. Firmware without the loader expects
+ * "HUBI" and rejects them instead of installing them at the wrong address.
+ */
+#define HUB_BOOT_MAGIC			(0x32425548u)
+#define HUB_BOOT_MAC_SIZE		(32u)
+
+/* Last row of an update image */
+typedef struct
+{
+	uint32_t magic;			/* HUB_BOOT_MAGIC */
+	uint32_t size;			/* image bytes before this row, whole rows */
+	uint32_t crc;			/* CRC-32 (IEEE) of the image bytes */
+	uint32_t settings_addr;	/* flash address of the settings rows of the new image, 0 = none */
+	uint32_t clear_addr;	/* flash rows the new image expects empty (recorder ring), 0 = none */
+	uint32_t clear_size;
+	uint32_t base;			/* flash address the image was linked for, __hub_app_start */
+	uint8_t  reserved[HUB_REC_ROW_SIZE - 28u - HUB_BOOT_MAC_SIZE];
+	uint8_t  mac[HUB_BOOT_MAC_SIZE];	/* HMAC-SHA256 over the image bytes and this row up to here */
+} hub_boot_manifest_t;
+
+_Static_assert(sizeof(hub_boot_manifest_t) == HUB_REC_ROW_SIZE, "manifest must fill one row");
+
+void hub_boot_init(hub_regmap_t *map);
+
+/* True between HUB_CMD_BOOT_BEGIN and the reset or the end of the update,
+ * scanning stays stopped
+ */
+bool hub_boot_active(void);
+
+/* Command handlers, return HUB_RESULT_* */
+uint8_t hub_boot_begin(uint16_t rows);
+uint8_t hub_boot_write(void);
+uint8_t hub_boot_commit(void);
+uint8_t hub_boot_abort(void);
+
+#endif /* HUB_BOOT_H */
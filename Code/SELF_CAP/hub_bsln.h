@@ -0,0 +1,49 @@
+/*******************************************************************************
+* File Name:   hub_bsln.h
+*
+* Description: Host control of the CAPSENSE baselines. While a tank fills or
+* drains, baseline tracking follows the real signal and hides it; after an
+* intervention the baselines take minutes to settle. The host can
+*
+*   freeze   keep all baselines where they are (diff counts still update)
+*   reset    set all baselines to the current raw counts once
+*   converge set the baselines to the raw counts in every frame for a while,
+*            so they follow the settling raw counts without delay
+*
+* A converge window also runs after power-up. The state is published in
+* status.flags with every frame, together with the frame it applies to.
+*
+*******************************************************************************/
+#ifndef HUB_BSLN_H
+#define HUB_BSLN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hub_regmap.h"
+
+/* Frames of the converge window after power-up, 0 = none */
+#ifndef HUB_BSLN_CONVERGE_FRAMES
+#define HUB_BSLN_CONVERGE_FRAMES	(50u)
+#endif
+
+void hub_bsln_init(hub_regmap_t *map);
+
+void hub_bsln_freeze(bool freeze);
+
+/* Resets the baselines with the next frame */
+void hub_bsln_reset(void);
+
+/* Re-initializes the baselines in each of the next frames */
+void hub_bsln_converge(uint16_t frames);
+
+/* Applies a pending reset or converge step to the finished frame and
+ * returns the CY_CAPSENSE_PROCESS_* mask to process it with.
+ */
+uint32_t hub_bsln_frame(void);
+
+/* Puts the baseline state of the last hub_bsln_frame() into the flags of
+ * the frame being published
+ */
+uint16_t hub_bsln_flags(uint16_t frame_flags);
+
+#endif /* HUB_BSLN_H */
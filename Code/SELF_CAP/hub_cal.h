@@ -0,0 +1,60 @@
+/*******************************************************************************
+* File Name:   hub_cal.h
+*
+* Description: Calibration cache and readiness for power-gated operation.
+* A host that logs slowly can power the hub only around each sample. It then
+* needs a valid, baseline-corrected frame as soon as possible after power-on,
+* not after the calibration and the power-up converge window.
+*
+* HUB_CMD_CAL_SAVE stores the calibrated widget parameters (CDAC and clock
+* settings as found in the widget contexts) and the current baselines in
+* flash. With HUB_POWER_GATED set, the next boots restore the widget
+* parameters before Cy_CapSense_Enable() and the baselines right after it,
+* and skip the converge window, so the first frame is already
+* baseline-corrected. Enable only skips its calibration scans if CDAC
+* auto-calibration is turned off in the CAPSENSE Configurator; otherwise it
+* recalibrates and only the baselines come from the cache.
+*
+* The cache is bound to the generated CAPSENSE configuration: after a change
+* in the Configurator it is ignored until it is saved again.
+*
+* HUB_STATUS_READY is set with the first frame whose baselines are valid,
+* and stats.boot_us tells how long that took from hub_time_init(), which
+* runs once cybsp_init() has set up the clocks. The ROM boot, the C startup
+* and the clock and board init before it are not included; the SysTick
+* timebase only counts at a known rate from there on. The host sees the
+* whole power-on time (CapsenseReader.wait_ready()). The module also keeps the
+* readiness flags INIT_OK and CAL_OK and combines all flags of a frame into
+* HUB_STATUS_FRAME_VALID.
+*
+*******************************************************************************/
+#ifndef HUB_CAL_H
+#define HUB_CAL_H
+
+#include <stdint.h>
+#include "hub_regmap.h"
+
+/* Called between Cy_CapSense_Init() and Cy_CapSense_Enable() */
+void hub_cal_restore(void);
+
+/* Called after Cy_CapSense_Enable() and hub_bsln_init() with the status of
+ * Cy_CapSense_Init() / Cy_CapSense_Enable()
+ */
+void hub_cal_init(hub_regmap_t *map, uint32_t capsense_status);
+
+/* The same pair for re-initializing the CAPSENSE block after a scan stall
+ * (see hub_wdt.h); a valid cache is used in either power mode
+ */
+void hub_cal_recover(void);
+void hub_cal_resume(uint32_t capsense_status);
+
+/* Adds HUB_STATUS_READY once the frame has valid baselines, and
+ * HUB_STATUS_FRAME_VALID, to the flags of the frame being published
+ */
+uint16_t hub_cal_frame(uint16_t frame_flags);
+
+/* Command handlers, return HUB_RESULT_* */
+uint8_t hub_cal_set_power(uint8_t mode);
+uint8_t hub_cal_save(void);
+
+#endif /* HUB_CAL_H */
@@ -0,0 +1,53 @@
+/*******************************************************************************
+* File Name:   hub_filter.h
+*
+* Description: Spike rejection on the raw counts. The filter runs on every
+* finished scan before the widgets are processed, so a single-frame spike
+* (ESD, a pump switching on) neither shows up in the register map nor moves
+* the baselines.
+*
+*   HUB_FILTER_MEDIAN3  median of the last 3 raw counts, 1 frame delay on steps
+*   HUB_FILTER_MEDIAN5  median of the last 5 raw counts, 2 frames delay
+*   HUB_FILTER_HAMPEL   keeps the raw count unless it is further than
+*                       k * 1.4826 * MAD from the median of the last 5 values,
+*                       no delay on clean signals
+*
+* A raw count counts as rejected when the filter moves it by more than
+* HUB_FILTER_SPIKE_MIN counts. Everything is integer arithmetic.
+*
+*******************************************************************************/
+#ifndef HUB_FILTER_H
+#define HUB_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hub_regmap.h"
+
+/* Filter after reset, HUB_FILTER_* */
+#ifndef HUB_FILTER_MODE
+#define HUB_FILTER_MODE			(HUB_FILTER_OFF)
+#endif
+
+/* Hampel threshold k * 1.4826 in 1/256 (k = 3) */
+#ifndef HUB_FILTER_HAMPEL_K_Q8
+#define HUB_FILTER_HAMPEL_K_Q8	(1139u)
+#endif
+
+/* Smallest change that counts as a rejected spike, also the smallest Hampel
+ * threshold so noise on a flat signal is not rejected
+ */
+#ifndef HUB_FILTER_SPIKE_MIN
+#define HUB_FILTER_SPIKE_MIN	(8u)
+#endif
+
+void hub_filter_init(hub_regmap_t *map);
+
+/* Selects the filter and the sensors it applies to (bit i = sensor i).
+ * Returns false for an unknown filter.
+ */
+bool hub_filter_configure(uint8_t mode, uint32_t mask);
+
+/* Filters the raw counts of the sensors scanned in the last frame */
+void hub_filter_frame(void);
+
+#endif /* HUB_FILTER_H */
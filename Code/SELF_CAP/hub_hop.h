@@ -0,0 +1,41 @@
+/*******************************************************************************
+* File Name:   hub_hop.h
+*
+* Description: Frequency hopping. Narrowband noise (pumps, VFDs) only hits
+* raw counts taken at a sense clock close to its frequency. With the
+* multi-frequency scan enabled in the CAPSENSE Configurator, the MSCLP scans
+* every slot at three sense clocks per frame, each channel keeps its own
+* calibration and baselines, and the middleware fuses the diff counts of the
+* three channels with a median before the widget status is computed. A
+* disturbed channel is thus dropped in the same frame, without the delay of
+* an IIR filter.
+*
+* The sensor order of the register map stays the same, the published values
+* are those of channel 0 with the fused diff counts. For every sensor
+* scanned in a frame, this module takes the raw count minus baseline of
+* each channel and publishes the channel furthest from their median in
+* sensor[i].hop, if it is further than HUB_HOP_REJECT_MIN counts; the stats
+* block counts these rejections per channel.
+*
+* Scanning three channels triples the scan time of a frame. Without the
+* multi-frequency scan, stats.hop_channels is 1 and sensor[i].hop stays
+* HUB_HOP_NONE.
+*
+*******************************************************************************/
+#ifndef HUB_HOP_H
+#define HUB_HOP_H
+
+#include <stdint.h>
+#include "hub_regmap.h"
+
+/* Smallest distance from the median that counts as a rejected channel */
+#ifndef HUB_HOP_REJECT_MIN
+#define HUB_HOP_REJECT_MIN		(8u)
+#endif
+
+void hub_hop_init(hub_regmap_t *map);
+
+/* Publishes the rejected channel of the sensors processed in the last frame */
+void hub_hop_frame(void);
+
+#endif /* HUB_HOP_H */
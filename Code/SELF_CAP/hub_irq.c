@@ -0,0 +1,217 @@
+/*******************************************************************************
+* File Name:   hub_irq.c
+*
+* Description: EZI2C service latency measurement, see hub_irq.h
+*
+*******************************************************************************/
+#include "cy_pdl.h"
+#include "cycfg.h"
+#include "hub_irq.h"
+#include "hub_time.h"
+#include "hub_trace.h"
+
+static hub_regmap_t *irq_map;
+
+/* Cycles the pending EZI2C interrupt has waited behind other handlers */
+static volatile uint32_t irq_wait;
+
+/* Waiting time of the EZI2C handler that is running */
+static uint32_t irq_ezi2c_wait;
+
+/* Worst cases since boot, in cycles */
+static volatile uint32_t irq_wait_max;
+static volatile uint32_t irq_run_max;
+static volatile uint32_t irq_stretch_max;
+static volatile uint16_t irq_delayed;
+
+/*******************************************************************************
+* Function Name: irq_us
+********************************************************************************
+* Summary:
+*  Converts cycles into microseconds for a 16-bit stats field, saturating.
+*
+*******************************************************************************/
+static uint16_t irq_us(uint32_t cycles)
+{
+	uint32_t us = hub_time_cycles_to_us(cycles);
+
+	return (us > UINT16_MAX) ? UINT16_MAX : (uint16_t)us;
+}
+
+/*******************************************************************************
+* Function Name: irq_charge
+********************************************************************************
+* Summary:
+*  Charges a region that held off the EZI2C interrupt to its waiting time if
+*  the interrupt is pending. Called while the EZI2C interrupt is held off.
+*
+*******************************************************************************/
+static void irq_charge(uint32_t start)
+{
+	if(0u != NVIC_GetPendingIRQ(EZI2C_IRQ))
+	{
+		irq_wait += hub_time_cycles() - start;
+	}
+}
+
+/*******************************************************************************
+* Function Name: hub_irq_init
+********************************************************************************
+* Summary:
+*  Publishes the empty measurement.
+*
+*******************************************************************************/
+void hub_irq_init(hub_regmap_t *map)
+{
+	irq_map = map;
+	hub_irq_frame();
+}
+
+/*******************************************************************************
+* Function Name: hub_irq_hold_begin
+********************************************************************************
+* Summary:
+*  Returns the start time of a handler that can hold off the EZI2C interrupt.
+*
+*******************************************************************************/
+uint32_t hub_irq_hold_begin(void)
+{
+	hub_trace_isr(HUB_TRACE_ISR_ENTER);
+	return hub_time_cycles();
+}
+
+/*******************************************************************************
+* Function Name: hub_irq_hold_end
+********************************************************************************
+* Summary:
+*  Charges the handler's run time to the EZI2C interrupt if that is waiting.
+*
+*******************************************************************************/
+void hub_irq_hold_end(uint32_t start)
+{
+	irq_charge(start);
+	hub_trace_isr(HUB_TRACE_ISR_EXIT);
+}
+
+/*******************************************************************************
+* Function Name: hub_irq_mask_begin
+********************************************************************************
+* Summary:
+*  Disables the interrupts and returns the start of the masked region.
+*
+*******************************************************************************/
+uint32_t hub_irq_mask_begin(void)
+{
+	__disable_irq();
+	return hub_time_cycles();
+}
+
+/*******************************************************************************
+* Function Name: hub_irq_mask_end
+********************************************************************************
+* Summary:
+*  Charges the masked region like a handler hold and enables the interrupts.
+*
+*******************************************************************************/
+void hub_irq_mask_end(uint32_t start)
+{
+	irq_charge(start);
+	__enable_irq();
+}
+
+/*******************************************************************************
+* Function Name: hub_irq_ezi2c_pending
+********************************************************************************
+* Summary:
+*  Lets a masked region that sleeps tell whether the EZI2C interrupt was
+*  already waiting before the sleep.
+*
+*******************************************************************************/
+bool hub_irq_ezi2c_pending(void)
+{
+	return (0u != NVIC_GetPendingIRQ(EZI2C_IRQ));
+}
+
+/*******************************************************************************
+* Function Name: hub_irq_flash_write_row
+********************************************************************************
+* Summary:
+*  Writes a flash row. The CPU stalls for the whole write, so the write is
+*  a masked region of its own.
+*
+*******************************************************************************/
+cy_en_flashdrv_status_t hub_irq_flash_write_row(uint32_t addr, const uint32_t *data)
+{
+	uint32_t start = hub_irq_mask_begin();
+	cy_en_flashdrv_status_t status = Cy_Flash_WriteRow(addr, data);
+
+	hub_irq_mask_end(start);
+	return status;
+}
+
+/*******************************************************************************
+* Function Name: hub_irq_ezi2c_begin
+********************************************************************************
+* Summary:
+*  Takes over the waiting time collected for this EZI2C interrupt and returns
+*  the start time of its handler.
+*
+*******************************************************************************/
+uint32_t hub_irq_ezi2c_begin(void)
+{
+	hub_trace_isr(HUB_TRACE_ISR_ENTER);
+	__disable_irq();
+	irq_ezi2c_wait = irq_wait;
+	irq_wait = 0u;
+	__enable_irq();
+
+	return hub_time_cycles();
+}
+
+/*******************************************************************************
+* Function Name: hub_irq_ezi2c_end
+********************************************************************************
+* Summary:
+*  Updates the worst waiting, handler and stretch times. The SCL line is held
+*  from the bus event until the handler has serviced the SCB, so waiting time
+*  plus handler run time bound the clock stretch of this interrupt.
+*
+*******************************************************************************/
+void hub_irq_ezi2c_end(uint32_t start)
+{
+	uint32_t run = hub_time_cycles() - start;
+	uint32_t stretch = irq_ezi2c_wait + run;
+
+	if(run > irq_run_max)
+	{
+		irq_run_max = run;
+	}
+	if(irq_ezi2c_wait > irq_wait_max)
+	{
+		irq_wait_max = irq_ezi2c_wait;
+	}
+	if(stretch > irq_stretch_max)
+	{
+		irq_stretch_max = stretch;
+	}
+	if((0u != irq_ezi2c_wait) && (irq_delayed < UINT16_MAX))
+	{
+		irq_delayed++;
+	}
+	hub_trace_isr(HUB_TRACE_ISR_EXIT);
+}
+
+/*******************************************************************************
+* Function Name: hub_irq_frame
+********************************************************************************
+* Summary:
+*  Copies the worst cases since boot into the stats block.
+*
+*******************************************************************************/
+void hub_irq_frame(void)
+{
+	irq_map->stats.i2c_wait_us = irq_us(irq_wait_max);
+	irq_map->stats.i2c_isr_us = irq_us(irq_run_max);
+	irq_map->stats.i2c_stretch_us = irq_us(irq_stretch_max);
+	irq_map->stats.i2c_delayed = irq_delayed;
+}
@@ -0,0 +1,97 @@
+/*******************************************************************************
+* File Name:   hub_irq.h
+*
+* Description: Interrupt priorities and EZI2C service latency. The EZI2C slave
+* stretches SCL from the bus event until its interrupt handler has serviced
+* the SCB, so everything that keeps that handler from running shows up as
+* clock stretching on the host's bus.
+*
+* Priorities (Cortex-M0+, 0 = highest of four levels):
+*
+*   1  SPI stream, sync line  short handlers whose timing matters most: the
+*                             SPI TX FIFO drains within microseconds, the
+*                             sync edge timestamp sets the multi-hub skew
+*   2  EZI2C                  preempts CAPSENSE, waits at most for one SPI
+*                             or sync handler run
+*   3  CAPSENSE MSCLP         scan completion, the processing itself runs
+*                             in the main loop and never holds off the EZI2C
+*   3  WDT                    only wakes the main loop (see hub_wdt.h)
+*
+* Level 0 stays free. The main loop holds the EZI2C off as well: where it
+* disables the interrupts (the last task check before the sleep, taking a
+* sync edge, exposing the map) and while a flash write stalls the CPU for
+* milliseconds. It only starts flash writes while the EZI2C is idle, but a
+* transaction can begin during one.
+*
+* Every handler that can hold off the EZI2C interrupt is wrapped in
+* hub_irq_hold_begin() / hub_irq_hold_end(), every interrupts-off region of
+* the main loop in hub_irq_mask_begin() / hub_irq_mask_end(), and flash rows
+* are written through hub_irq_flash_write_row(). If the EZI2C interrupt is
+* pending at the end of such a region, the whole region counts as waiting
+* time of that interrupt (the interrupt may have arrived later in it). The
+* EZI2C handler adds its own run time and publishes the worst cases in the
+* stats block. The handler brackets also record each run in the event trace
+* (see hub_trace.h).
+*
+* The result is a measurement of these sources only, not a bound on every
+* clock stretch: the interrupts-off sections inside the PDL and the CAPSENSE
+* middleware, the few instructions of a trace event, the interrupt entry
+* and the SCB itself are not counted. Building with HUB_IRQ_PRIO_EZI2C set
+* to 3 restores the former scheme (all handlers on one level) for a
+* before/after comparison; no such comparison has been measured yet.
+*
+*******************************************************************************/
+#ifndef HUB_IRQ_H
+#define HUB_IRQ_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "cy_pdl.h"
+#include "hub_regmap.h"
+
+#ifndef HUB_IRQ_PRIO_SPI
+#define HUB_IRQ_PRIO_SPI		(1u)
+#endif
+
+#ifndef HUB_IRQ_PRIO_SYNC
+#define HUB_IRQ_PRIO_SYNC		(1u)
+#endif
+
+#ifndef HUB_IRQ_PRIO_EZI2C
+#define HUB_IRQ_PRIO_EZI2C		(2u)
+#endif
+
+#ifndef HUB_IRQ_PRIO_CAPSENSE
+#define HUB_IRQ_PRIO_CAPSENSE	(3u)
+#endif
+
+#ifndef HUB_IRQ_PRIO_WDT
+#define HUB_IRQ_PRIO_WDT		(3u)
+#endif
+
+void hub_irq_init(hub_regmap_t *map);
+
+/* Brackets an interrupt handler that can hold off the EZI2C interrupt */
+uint32_t hub_irq_hold_begin(void);
+void hub_irq_hold_end(uint32_t start);
+
+/* Brackets the EZI2C interrupt handler */
+uint32_t hub_irq_ezi2c_begin(void);
+void hub_irq_ezi2c_end(uint32_t start);
+
+/* Disables the interrupts for a region of the main loop and returns its
+ * start; hub_irq_mask_end() enables them again. Not nested, main loop only.
+ */
+uint32_t hub_irq_mask_begin(void);
+void hub_irq_mask_end(uint32_t start);
+
+/* True if the EZI2C interrupt is pending */
+bool hub_irq_ezi2c_pending(void);
+
+/* Cy_Flash_WriteRow() with its stall charged to a waiting EZI2C interrupt */
+cy_en_flashdrv_status_t hub_irq_flash_write_row(uint32_t addr, const uint32_t *data);
+
+/* Publishes the worst waiting, handler and stretch times */
+void hub_irq_frame(void);
+
+#endif /* HUB_IRQ_H */
@@ -0,0 +1,73 @@
+/*******************************************************************************
+* File Name:   hub_loader.h
+*
+* Description: Resident install stage of the firmware updater. It sits in its
+* own linker region at address 0 (see hub_boot.ld), has its own vector table
+* and runs first after every reset. The application is linked behind it and
+* starts from its vector table at __hub_app_start.
+*
+* hub_boot_commit() does not overwrite the application itself. It writes an
+* install job into a fixed row of the boot area and resets. On every boot the
+* loader looks at that row; with a valid job it copies the staged image over
+* the application, writes the carried settings, empties the recorder rows,
+* checks the CRC-32 of the installed image and only then erases the job and
+* resets into the new firmware. Rows that already hold the right data are
+* not written again, so a power loss at any point just makes the next boot
+* continue the same job. A torn job row fails its own CRC and is dropped; it
+* is written last, after everything it points to, so the application it
+* leaves running is still the old, complete one.
+*
+* The loader is never rewritten by an update. It takes no part in the update
+* image (Tools/hub_update.py leaves it out), so changes to this file or to the
+* boot area layout of hub_boot.ld have to be programmed over SWD.
+*
+* Constraints of the loader code: it runs before the C startup of the
+* application, so it uses no initialized or zeroed data, no library calls
+* and nothing linked outside the .hub_loader section. It writes flash through
+* the SROM system calls at the clock the part comes out of reset with.
+*
+*******************************************************************************/
+#ifndef HUB_LOADER_H
+#define HUB_LOADER_H
+
+#include <stdint.h>
+#include "cy_pdl.h"
+
+#define HUB_LOADER_ROW			(CY_FLASH_SIZEOF_ROW)
+#define HUB_LOADER_MAGIC		(0x4A425548u)	/* "HUBJ" */
+
+/* Rows behind the job row for the settings carried into the new image */
+#ifndef HUB_LOADER_CARRY_ROWS
+#define HUB_LOADER_CARRY_ROWS	(3u)
+#endif
+
+/* Install job, one flash row at the start of the boot area */
+typedef struct
+{
+	uint32_t magic;			/* HUB_LOADER_MAGIC, anything else means no job */
+	uint32_t src;			/* staged image */
+	uint32_t dst;			/* where it runs, __hub_app_start */
+	uint32_t size;			/* image bytes, whole rows */
+	uint32_t crc;			/* CRC-32 (IEEE) of the image */
+	uint32_t settings_dst;	/* settings rows of the new image, 0 = none */
+	uint32_t settings_size;	/* bytes of hub_loader_carry to write there */
+	uint32_t clear_addr;	/* rows the new image expects empty (recorder ring), 0 = none */
+	uint32_t clear_size;
+	uint32_t check;			/* CRC-32 of the fields above */
+	uint8_t  reserved[HUB_LOADER_ROW - 40u];
+} hub_loader_job_t;
+
+_Static_assert(sizeof(hub_loader_job_t) == HUB_LOADER_ROW, "install job must fill one row");
+
+/* Boot area rows, at fixed addresses set by hub_boot.ld */
+extern const volatile hub_loader_job_t hub_loader_job;
+extern const volatile uint8_t hub_loader_carry[HUB_LOADER_CARRY_ROWS * HUB_LOADER_ROW];
+
+/* Application region of hub_boot.ld */
+extern const uint32_t __hub_app_start[];
+extern const uint32_t __hub_app_end[];
+
+/* CRC-32 (IEEE), shared with the updater so both sides agree on the check */
+uint32_t hub_loader_crc32(const volatile uint8_t *data, uint32_t len);
+
+#endif /* HUB_LOADER_H */
@@ -0,0 +1,45 @@
+/*******************************************************************************
+* File Name:   hub_noise.h
+*
+* Description: Noise and SNR measurement for the end-of-line test of a
+* board. HUB_CMD_NOISE collects the raw counts of a number of frames while
+* nothing touches the sensors, then publishes per sensor the peak-to-peak
+* and the RMS noise and the SNR (signal / peak-to-peak noise, the CAPSENSE
+* definition) in its sensor window. Only frames with HUB_STATUS_FRAME_VALID
+* are used; sensors scanned every d-th frame take d times as long.
+*
+* The signal is given by the host in raw counts, or taken from the finger
+* threshold of each sensor's widget (80 % of the signal).
+*
+* HUB_CMD_NOISE_SAVE stores the results in the settings (hub_settings.h) as
+* per-board metadata, so a firmware update carries them over like the rest
+* of the settings. They are published again at every boot, with
+* stats.noise_state HUB_NOISE_STORED, until the next saved measurement.
+*
+*******************************************************************************/
+#ifndef HUB_NOISE_H
+#define HUB_NOISE_H
+
+#include <stdint.h>
+#include "hub_regmap.h"
+
+/* Frames per sensor if the host gives none, and the most it may ask for
+ * (keeps the sums of squares in 64 bits)
+ */
+#ifndef HUB_NOISE_FRAMES
+#define HUB_NOISE_FRAMES		(256u)
+#endif
+
+#define HUB_NOISE_FRAMES_MAX	(4096u)
+
+/* Publishes the stored results, if any */
+void hub_noise_init(hub_regmap_t *map);
+
+/* Command handlers, return HUB_RESULT_* */
+uint8_t hub_noise_start(uint16_t frames, uint16_t signal);
+uint8_t hub_noise_save(void);
+
+/* Adds the published frame to the measurement */
+void hub_noise_frame(void);
+
+#endif /* HUB_NOISE_H */
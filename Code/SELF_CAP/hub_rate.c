@@ -0,0 +1,129 @@
+/*******************************************************************************
+* File Name:   hub_rate.c
+*
+* Description: Adaptive scan rate for free-run mode, see hub_rate.h
+*
+*******************************************************************************/
+#include "cy_pdl.h"
+#include "cycfg_capsense.h"
+#include "hub_rate.h"
+#include "hub_scan.h"
+#include "hub_time.h"
+
+static uint16_t rate_quiet_ms = HUB_RATE_QUIET_MS;
+static uint16_t rate_max_ms = HUB_RATE_MAX_MS;
+static uint16_t rate_threshold = HUB_RATE_ACTIVITY_TH;
+
+static uint16_t rate_idle_ms;
+static uint32_t rate_quiet_cycles;
+static uint32_t rate_since_cycles;
+static uint16_t rate_last_diff[NUM_OF_SENSORS];
+
+/*******************************************************************************
+* Function Name: frame_active
+********************************************************************************
+* Summary:
+*  Rates the last frame. Only sensors scanned in it contribute, the squares
+*  saturate instead of wrapping.
+*
+*******************************************************************************/
+static bool frame_active(void)
+{
+	uint32_t energy = 0u;
+
+	for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+	{
+		if(!hub_scan_sensor_updated(i))
+		{
+			continue;
+		}
+
+		uint16_t diff = cy_capsense_tuner.sensorContext[i].diff;
+		int32_t delta = (int32_t)diff - (int32_t)rate_last_diff[i];
+		uint32_t square = (delta > 255 || delta < -255) ? UINT16_MAX : (uint32_t)(delta * delta);
+
+		rate_last_diff[i] = diff;
+		energy += square;
+	}
+
+	return (energy > rate_threshold) ||
+		   (0u != Cy_CapSense_IsAnyWidgetActive(&cy_capsense_context));
+}
+
+/*******************************************************************************
+* Function Name: hub_rate_init
+********************************************************************************
+* Summary:
+*  Starts at full rate.
+*
+*******************************************************************************/
+void hub_rate_init(void)
+{
+	(void)hub_rate_configure(rate_quiet_ms, rate_max_ms, rate_threshold);
+}
+
+/*******************************************************************************
+* Function Name: hub_rate_configure
+********************************************************************************
+* Summary:
+*  Applies new settings and returns to full rate. The scan start delay is
+*  bounded by the MSCLP wake-up timer, a longer idle time is rejected.
+*
+*******************************************************************************/
+bool hub_rate_configure(uint16_t quiet_ms, uint16_t max_ms, uint16_t threshold)
+{
+	if(max_ms > HUB_RATE_TIMER_MAX_MS)
+	{
+		return false;
+	}
+	rate_quiet_ms = quiet_ms;
+	rate_max_ms = max_ms;
+	rate_threshold = threshold;
+	rate_quiet_cycles = (uint32_t)quiet_ms * (SystemCoreClock / 1000u);
+	rate_since_cycles = hub_time_cycles();
+	rate_idle_ms = 0u;
+	return true;
+}
+
+/*******************************************************************************
+* Function Name: hub_rate_frame
+********************************************************************************
+* Summary:
+*  Activity resets the quiet timer and the idle time. Every full quiet period
+*  without activity doubles the idle time.
+*
+*******************************************************************************/
+void hub_rate_frame(uint8_t mode)
+{
+	uint32_t now = hub_time_cycles();
+
+	if(!frame_active() && (0u != rate_quiet_ms) && (HUB_MODE_FREE_RUN == mode))
+	{
+		if((now - rate_since_cycles) >= rate_quiet_cycles)
+		{
+			uint32_t idle = (0u == rate_idle_ms) ? HUB_RATE_STEP_MS : (2u * rate_idle_ms);
+
+			rate_idle_ms = (uint16_t)((idle > rate_max_ms) ? rate_max_ms : idle);
+			rate_since_cycles = now;
+		}
+		return;
+	}
+
+	rate_since_cycles = now;
+	if(0u != rate_idle_ms)
+	{
+		rate_idle_ms = 0u;
+	}
+}
+
+/*******************************************************************************
+* Function Name: hub_rate_delay_us
+********************************************************************************
+* Summary:
+*  Returns the current idle time for the MSCLP wake-up timer.
+*
+*******************************************************************************/
+uint32_t hub_rate_delay_us(void)
+{
+	return (uint32_t)rate_idle_ms * 1000u;
+}
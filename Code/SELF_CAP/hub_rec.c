@@ -0,0 +1,272 @@
+/*******************************************************************************
+* File Name:   hub_rec.c
+*
+* Description: Black-box recorder in flash, see hub_rec.h
+*
+*******************************************************************************/
+#include <string.h>
+#include "cy_pdl.h"
+#include "hub_irq.h"
+#include "hub_rec.h"
+
+#define REC_PER_ROW				((HUB_REC_ROW_SIZE - sizeof(hub_rec_row_t)) / (4u * NUM_OF_SENSORS))
+
+_Static_assert(HUB_REC_ROW_SIZE == CY_FLASH_SIZEOF_ROW, "record window must hold one flash row");
+_Static_assert(REC_PER_ROW >= 1u, "too many sensors for one record per row");
+
+/* Ring of flash rows, next to the settings in the emulated EEPROM section */
+CY_SECTION(".cy_em_eeprom") CY_ALIGN(CY_FLASH_SIZEOF_ROW)
+static const volatile uint8_t rec_storage[HUB_REC_ROWS][CY_FLASH_SIZEOF_ROW] = {{0u}};
+
+static hub_regmap_t *rec_map;
+static bool rec_enabled;
+static uint8_t rec_shift = HUB_REC_SHIFT;
+
+/* Ring position: next row to write, rows holding data, counter of the next row */
+static uint32_t rec_head;
+static uint32_t rec_used;
+static uint16_t rec_counter;
+
+/* Running record and the row being filled */
+static uint32_t rec_sum_raw[NUM_OF_SENSORS];
+static uint32_t rec_sum_diff[NUM_OF_SENSORS];
+static uint32_t rec_frames;
+static uint32_t rec_row[CY_FLASH_SIZEOF_ROW / sizeof(uint32_t)];
+static bool rec_row_full;
+
+/*******************************************************************************
+* Function Name: row_header
+********************************************************************************
+* Summary:
+*  Header of a stored row, NULL if the row holds no record.
+*
+*******************************************************************************/
+static const hub_rec_row_t *row_header(uint32_t row)
+{
+	const hub_rec_row_t *h = (const hub_rec_row_t *)(const void *)rec_storage[row];
+
+	return (HUB_REC_MAGIC == h->magic) ? h : NULL;
+}
+
+/*******************************************************************************
+* Function Name: ring_find
+********************************************************************************
+* Summary:
+*  Follows the row counters from the first row to the newest row. Rows are
+*  written in order, so the counters increase by one up to the newest row;
+*  after a wrap the next row holds the oldest data of the previous lap.
+*
+*******************************************************************************/
+static void ring_find(void)
+{
+	const hub_rec_row_t *h = row_header(0u);
+	uint32_t newest = 0u;
+
+	rec_head = 0u;
+	rec_used = 0u;
+	rec_counter = 0u;
+	if(NULL == h)
+	{
+		return;
+	}
+
+	for(uint32_t row = 1u; row < HUB_REC_ROWS; row++)
+	{
+		const hub_rec_row_t *next = row_header(row);
+
+		if((NULL == next) || (next->counter != (uint16_t)(h->counter + 1u)))
+		{
+			break;
+		}
+		h = next;
+		newest = row;
+	}
+
+	rec_head = (newest + 1u) % HUB_REC_ROWS;
+	rec_counter = (uint16_t)(h->counter + 1u);
+	rec_used = (NULL != row_header(rec_head)) ? HUB_REC_ROWS : (newest + 1u);
+}
+
+/*******************************************************************************
+* Function Name: rec_publish
+********************************************************************************
+* Summary:
+*  Updates the recorder state in the stats block.
+*
+*******************************************************************************/
+static void rec_publish(void)
+{
+	rec_map->stats.rec_rows = (uint16_t)rec_used;
+	rec_map->stats.rec_state = rec_enabled ? 1u : 0u;
+	rec_map->stats.rec_shift = rec_shift;
+}
+
+/*******************************************************************************
+* Function Name: row_start
+********************************************************************************
+* Summary:
+*  Clears the row buffer and the running record.
+*
+*******************************************************************************/
+static void row_start(void)
+{
+	memset(rec_row, 0, sizeof(rec_row));
+	memset(rec_sum_raw, 0, sizeof(rec_sum_raw));
+	memset(rec_sum_diff, 0, sizeof(rec_sum_diff));
+	rec_frames = 0u;
+	rec_row_full = false;
+}
+
+/*******************************************************************************
+* Function Name: hub_rec_init
+********************************************************************************
+* Summary:
+*  Locates the ring head and publishes the window location.
+*
+*******************************************************************************/
+void hub_rec_init(hub_regmap_t *map)
+{
+	rec_map = map;
+	rec_map->stats.rec_base = (uint16_t)offsetof(hub_regmap_t, rec);
+	ring_find();
+	row_start();
+	rec_publish();
+}
+
+/*******************************************************************************
+* Function Name: hub_rec_configure
+********************************************************************************
+* Summary:
+*  Applies a new state. A changed shift drops the partial row, since all
+*  records of a row share one shift.
+*
+*******************************************************************************/
+bool hub_rec_configure(bool enable, uint8_t shift)
+{
+	if(shift > HUB_REC_SHIFT_MAX)
+	{
+		return false;
+	}
+	if((shift != rec_shift) || !enable)
+	{
+		row_start();
+	}
+	rec_enabled = enable;
+	rec_shift = shift;
+	rec_publish();
+	return true;
+}
+
+/*******************************************************************************
+* Function Name: hub_rec_frame
+********************************************************************************
+* Summary:
+*  Sums up the published values. The mean of a window of 2^shift frames is a
+*  shift, no division. A record that completes while the previous row still
+*  waits for its flash write is dropped.
+*
+*******************************************************************************/
+void hub_rec_frame(void)
+{
+	if(!rec_enabled || rec_row_full)
+	{
+		return;
+	}
+
+	for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+	{
+		rec_sum_raw[i] += rec_map->field.rawcount[i];
+		rec_sum_diff[i] += rec_map->field.diffcount[i];
+	}
+	rec_frames++;
+	if(rec_frames < (1uL << rec_shift))
+	{
+		return;
+	}
+
+	hub_rec_row_t *h = (hub_rec_row_t *)(void *)rec_row;
+	uint16_t *values = (uint16_t *)(void *)&h[1];
+
+	if(0u == h->count)
+	{
+		h->magic = HUB_REC_MAGIC;
+		h->seq = rec_map->status.seq;
+		h->shift = rec_shift;
+		h->sensors = (uint8_t)NUM_OF_SENSORS;
+	}
+
+	values += (uint32_t)h->count * 2u * NUM_OF_SENSORS;
+	for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+	{
+		*values++ = (uint16_t)(rec_sum_raw[i] >> rec_shift);
+		*values++ = (uint16_t)(rec_sum_diff[i] >> rec_shift);
+		rec_sum_raw[i] = 0u;
+		rec_sum_diff[i] = 0u;
+	}
+	rec_frames = 0u;
+	h->count++;
+	rec_row_full = (h->count >= REC_PER_ROW);
+}
+
+/*******************************************************************************
+* Function Name: hub_rec_pending
+********************************************************************************
+* Summary:
+*  Reports a full row.
+*
+*******************************************************************************/
+bool hub_rec_pending(void)
+{
+	return rec_row_full;
+}
+
+/*******************************************************************************
+* Function Name: hub_rec_write
+********************************************************************************
+* Summary:
+*  Stamps the row with the next counter and writes it over the oldest row.
+*  A failed write leaves the ring position unchanged and retries with the
+*  next row's data.
+*
+*******************************************************************************/
+void hub_rec_write(void)
+{
+	hub_rec_row_t *h = (hub_rec_row_t *)(void *)rec_row;
+
+	h->counter = rec_counter;
+	if(CY_FLASH_DRV_SUCCESS == hub_irq_flash_write_row((uint32_t)&rec_storage[rec_head][0], rec_row))
+	{
+		rec_head = (rec_head + 1u) % HUB_REC_ROWS;
+		rec_counter++;
+		if(rec_used < HUB_REC_ROWS)
+		{
+			rec_used++;
+		}
+	}
+	row_start();
+	rec_publish();
+}
+
+/*******************************************************************************
+* Function Name: hub_rec_read
+********************************************************************************
+* Summary:
+*  Copies a stored row into the record window. Index 0 is the oldest row.
+*
+*******************************************************************************/
+bool hub_rec_read(uint16_t index)
+{
+	if(index >= rec_used)
+	{
+		return false;
+	}
+
+	uint32_t row = (rec_head + HUB_REC_ROWS - rec_used + index) % HUB_REC_ROWS;
+
+	for(uint32_t k = 0; k < HUB_REC_ROW_SIZE; k++)
+	{
+		rec_map->rec.data[k] = rec_storage[row][k];
+	}
+	rec_map->rec.index = index;
+	return true;
+}
@@ -0,0 +1,75 @@
+/*******************************************************************************
+* File Name:   hub_rec.h
+*
+* Description: Black-box recorder. While enabled, the hub averages the
+* published raw and diff counts over 2^shift frames and stores one record per
+* window in a ring of flash rows, so data survives an outage of the host.
+*
+* Rows are written strictly in ring order and each row only once per lap, so
+* all rows wear evenly. Each row carries a running counter; at boot the
+* recorder follows the counters to the newest row and continues after it
+* instead of starting over at the first row.
+*
+* Flash row layout (HUB_REC_ROW_SIZE bytes):
+*
+*   hub_rec_row_t header, then count records of NUM_OF_SENSORS x
+*   {raw, diff} mean values. Record k covers the 2^shift frames ending with
+*   status.seq = seq + k * 2^shift.
+*
+* The host reads rows through the record window of the register map, one
+* HUB_CMD_REC_READ per row, oldest first.
+*
+*******************************************************************************/
+#ifndef HUB_REC_H
+#define HUB_REC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hub_regmap.h"
+
+#define HUB_REC_MAGIC			(0x4252u)	/* "RB" */
+
+/* Flash rows of the ring */
+#ifndef HUB_REC_ROWS
+#define HUB_REC_ROWS			(64u)
+#endif
+
+/* Frames per record of a freshly programmed hub, as a power of two */
+#ifndef HUB_REC_SHIFT
+#define HUB_REC_SHIFT			(7u)
+#endif
+
+#define HUB_REC_SHIFT_MAX		(15u)
+
+/* Header of a recorded flash row */
+typedef struct
+{
+	uint16_t magic;			/* HUB_REC_MAGIC */
+	uint16_t counter;		/* increments by one per written row */
+	uint32_t seq;			/* frame sequence number at the end of the first record */
+	uint8_t  shift;			/* 2^shift frames per record */
+	uint8_t  count;			/* records in this row */
+	uint8_t  sensors;		/* values per record / 2 */
+	uint8_t  reserved;
+} hub_rec_row_t;
+
+void hub_rec_init(hub_regmap_t *map);
+
+/* Starts or stops recording, 2^shift frames per record. Returns false for a
+ * shift above HUB_REC_SHIFT_MAX.
+ */
+bool hub_rec_configure(bool enable, uint8_t shift);
+
+/* Adds the published frame to the running record */
+void hub_rec_frame(void);
+
+/* True while a full row waits to be written */
+bool hub_rec_pending(void);
+
+/* Writes the full row to flash, blocks for the duration of the row write */
+void hub_rec_write(void);
+
+/* Copies row index (0 = oldest) into the record window of the map */
+bool hub_rec_read(uint16_t index);
+
+#endif /* HUB_REC_H */
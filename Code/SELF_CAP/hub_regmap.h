@@ -0,0 +1,425 @@
+/*******************************************************************************
+* File Name:   hub_regmap.h
+*
+* Description: Register map of the Sensor Hub data buffer, exposed on the
+* secondary EZI2C slave address (0x09). The map is addressed with 16-bit
+* sub-addresses so it can grow past 256 bytes with the sensor count.
+*
+* Layout (all values little-endian):
+*
+*   0x0000  ctrl     RW  control window, the only host-writable area
+*   0x0020  info     RO  map description (magic, version, window offsets)
+*   0x0030  status   RO  frame sequence number, status flags and mode, scan
+*                        idle time, scan latency, sync epoch
+*   0x0040  stats    RO  frame timing and firmware statistics
+*   0x00C0  field    RO  per-field windows: rawcount[N], diffcount[N],
+*                        baseline[N]
+*   sensor_base      RO  per-sensor windows: {raw, diff, bsln, cp, bist, seq,
+*                        rejects, hop, noise_pp, noise_rms, snr, slope} for
+*                        each sensor
+*   rec_base         RO  record window: one flash row of the black-box
+*                        recorder (see hub_rec.h) or a chunk of the event
+*                        trace (see hub_trace.h); writable during a
+*                        firmware update, where it carries the image rows
+*
+* Hosts should read the info block once and take the window offsets and
+* strides from there instead of hard coding them:
+*
+*   value f of sensor i (per field)  = field_base  + f * field_stride  + 2 * i
+*   value f of sensor i (per sensor) = sensor_base + i * sensor_stride + 2 * f
+*
+* One-shot mode: write HUB_MODE_ONE_SHOT to ctrl.mode, then write a non-zero
+* value to ctrl.trigger for every frame. The hub clears the trigger and
+* HUB_STATUS_DONE when the scan starts, and sets HUB_STATUS_DONE together
+* with a new status.seq once the frame is published.
+*
+* Frame validity: the map is all zero until the first frame, and values are
+* not meaningful while the CAPSENSE init or calibration failed, while the
+* baselines converge, or when a scan failed or a sensor saturated. Each of
+* these conditions has its own status flag; HUB_STATUS_FRAME_VALID is set
+* when none of them applies, so a host only has to test one bit.
+*
+* Sync mode: like one-shot mode, but the scan starts on the falling edge of
+* the shared SYNC line (see hub_sync.h). Write the same value to ctrl.epoch
+* on all hubs while the line is idle; every edge stamps the frame with the
+* current epoch and advances ctrl.epoch by one.
+*
+* Commands: write ctrl.cmd followed by its arguments in one transaction
+* starting at 0x0008. The hub executes the command after the stop condition,
+* writes ctrl.result and then clears ctrl.cmd. SET_* commands change the
+* working settings; HUB_CMD_SAVE_SETTINGS makes them persistent.
+*
+*   HUB_CMD_RESET           no arguments, software reset
+*   HUB_CMD_SAVE_SETTINGS   no arguments, writes the settings to flash
+*   HUB_CMD_SET_I2C_ADDR    arg[0] = tuner address (data address is one
+*                           higher), 0 = back to strap pins / generated
+*                           address; applied after save and reset
+*   HUB_CMD_SET_BIST        arg[0..1] = frames between two background
+*                           self-test steps, 0 = off (see hub_bist.h)
+*   HUB_CMD_SET_SENSOR_MASK arg[0..3] = bit i enables sensor i, applied from
+*                           the next frame on (see hub_scan.h)
+*   HUB_CMD_SET_SCAN_RATE   arg[0] = first sensor, arg[1] = count n (1..20),
+*                           arg[2..n+1] = scan every d-th frame (1..255)
+*   HUB_CMD_SET_ADAPTIVE    arg[0..1] = quiet period in ms (0 = full rate),
+*                           arg[2..3] = longest idle time in ms (up to
+*                           HUB_RATE_TIMER_MAX_MS),
+*                           arg[4..5] = activity threshold (see hub_rate.h)
+*   HUB_CMD_SET_FILTER      arg[0] = HUB_FILTER_*, arg[1..4] = bit i filters
+*                           sensor i (see hub_filter.h)
+*   HUB_CMD_SET_XTALK       arg[0] = first matrix element (row-major),
+*                           arg[1] = count n (1..10), arg[2..] = n signed
+*                           Q14 coefficients (see hub_xtalk.h)
+*   HUB_CMD_BSLN_FREEZE     arg[0] = 1 freezes all baselines, 0 resumes
+*                           tracking (see hub_bsln.h)
+*   HUB_CMD_BSLN_RESET      no arguments, baselines = raw counts once
+*   HUB_CMD_BSLN_CONVERGE   arg[0..1] = frames in which the baselines follow
+*                           the raw counts directly, 0 = stop
+*   HUB_CMD_REC_CONFIG      arg[0] = 1 starts, 0 stops the recorder,
+*                           arg[1] = 2^n frames per record (n = 0..15)
+*   HUB_CMD_REC_READ        arg[0..1] = recorded row, 0 = oldest; copies it
+*                           into the record window
+*   HUB_CMD_BOOT_BEGIN      arg[0..1] = rows of the update image including
+*                           its manifest row; stops scanning and makes the
+*                           record window writable (see hub_boot.h)
+*   HUB_CMD_BOOT_WRITE      no arguments, stages the row in the record
+*                           window: index = row, crc = CRC-16 of data
+*   HUB_CMD_BOOT_COMMIT     no arguments, checks and installs the staged
+*                           image and resets; only returns on failure, which
+*                           ends the update unless rows are missing
+*   HUB_CMD_SET_POWER       arg[0] = HUB_POWER_*, applied after save and
+*                           reset (see hub_cal.h)
+*   HUB_CMD_CAL_SAVE        no arguments, stores the calibration and the
+*                           baselines for power-gated starts; fails before
+*                           HUB_STATUS_READY
+*   HUB_CMD_TUNE            arg[0..1] = SNR target x10, arg[2..3] = signal
+*                           in raw counts, 0 = from the finger thresholds;
+*                           sweeps the scan parameters and stores the
+*                           fastest ones that reach the target, SNR 0 = back
+*                           to the generated parameters (see hub_tune.h)
+*   HUB_CMD_NOISE           arg[0..1] = frames per sensor (2..4096, 0 =
+*                           HUB_NOISE_FRAMES), arg[2..3] = signal in raw
+*                           counts, 0 = from the finger thresholds; measures
+*                           noise and SNR of the untouched sensors (see
+*                           hub_noise.h)
+*   HUB_CMD_NOISE_SAVE      no arguments, stores the finished noise results
+*                           as board metadata; fails before HUB_NOISE_DONE
+*   HUB_CMD_TRACE           arg[0] = HUB_TRACE_OFF stops the event trace,
+*                           HUB_TRACE_RUNNING clears and starts it,
+*                           HUB_TRACE_ARMED too and stops it at the first
+*                           frame longer than arg[1..4] us (see hub_trace.h)
+*   HUB_CMD_TRACE_READ      arg[0..1] = chunk, 0 = oldest events; copies
+*                           HUB_TRACE_CHUNK events into the record window,
+*                           fails while the trace records
+*   HUB_CMD_BOOT_ABORT      no arguments, ends an update without installing
+*                           it; scanning resumes, the map is read-only again
+*
+*******************************************************************************/
+#ifndef HUB_REGMAP_H
+#define HUB_REGMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cycfg_capsense.h"
+
+/* Frequency channels per sensor, 3 with the multi-frequency scan (see hub_hop.h) */
+#if defined(CY_CAPSENSE_MULTI_FREQUENCY_SCAN_EN) && (CY_CAPSENSE_MULTI_FREQUENCY_SCAN_EN)
+#define HUB_HOP_CHANNELS		(CY_CAPSENSE_CONFIGURED_FREQ_NUM)
+#else
+#define HUB_HOP_CHANNELS		(1u)
+#endif
+
+// Update NUM_OF_SENSORS to match your actual sensor count (can also be checked with cy_capsense_tuner.sensorContext size)
+#define NUM_OF_SENSORS (sizeof(cy_capsense_tuner.sensorContext) / sizeof(cy_capsense_tuner.sensorContext[0]) / HUB_HOP_CHANNELS)
+
+#define HUB_REGMAP_MAGIC		(0x5348u)	/* "HS" */
+#define HUB_REGMAP_VERSION		(26u)
+
+/* Fixed sub-addresses */
+#define HUB_REG_CTRL			(0x0000u)
+#define HUB_REG_INFO			(0x0020u)
+#define HUB_REG_STATUS			(0x0030u)
+#define HUB_REG_STATS			(0x0040u)
+#define HUB_REG_FIELD			(0x00C0u)
+
+#define HUB_CTRL_SIZE			(0x20u)
+#define HUB_CTRL_ARG_SIZE		(22u)
+#define HUB_MAX_TASKS			(8u)
+#define HUB_REC_ROW_SIZE		(128u)	/* one flash row */
+
+/* Field indices, in the order they appear in both window types */
+#define HUB_FIELD_RAW			(0u)
+#define HUB_FIELD_DIFF			(1u)
+#define HUB_FIELD_BSLN			(2u)
+
+/* ctrl.mode values */
+#define HUB_MODE_FREE_RUN		(0u)	/* scan continuously (default) */
+#define HUB_MODE_ONE_SHOT		(1u)	/* scan once per host trigger, sleep in between */
+#define HUB_MODE_SYNC			(2u)	/* scan once per edge on the SYNC line */
+
+/* ctrl.cmd opcodes */
+#define HUB_CMD_NONE			(0x00u)
+#define HUB_CMD_RESET			(0x01u)
+#define HUB_CMD_SAVE_SETTINGS	(0x02u)
+#define HUB_CMD_SET_I2C_ADDR	(0x10u)
+#define HUB_CMD_SET_BIST		(0x11u)
+#define HUB_CMD_SET_SENSOR_MASK	(0x12u)
+#define HUB_CMD_SET_SCAN_RATE	(0x13u)
+#define HUB_CMD_SET_ADAPTIVE	(0x14u)
+#define HUB_CMD_SET_FILTER		(0x15u)
+#define HUB_CMD_SET_XTALK		(0x16u)
+#define HUB_CMD_BSLN_FREEZE		(0x17u)
+#define HUB_CMD_BSLN_RESET		(0x18u)
+#define HUB_CMD_BSLN_CONVERGE	(0x19u)
+#define HUB_CMD_REC_CONFIG		(0x1Au)
+#define HUB_CMD_REC_READ		(0x1Bu)
+#define HUB_CMD_BOOT_BEGIN		(0x1Cu)
+#define HUB_CMD_BOOT_WRITE		(0x1Du)
+#define HUB_CMD_BOOT_COMMIT		(0x1Eu)
+#define HUB_CMD_SET_POWER		(0x1Fu)
+#define HUB_CMD_CAL_SAVE		(0x20u)
+#define HUB_CMD_TUNE			(0x21u)
+#define HUB_CMD_NOISE			(0x22u)
+#define HUB_CMD_NOISE_SAVE		(0x23u)
+#define HUB_CMD_TRACE			(0x24u)
+#define HUB_CMD_TRACE_READ		(0x25u)
+#define HUB_CMD_BOOT_ABORT		(0x26u)
+
+/* ctrl.result codes */
+#define HUB_RESULT_OK			(0x00u)
+#define HUB_RESULT_BAD_CMD		(0x01u)
+#define HUB_RESULT_BAD_ARG		(0x02u)
+#define HUB_RESULT_FAILED		(0x03u)
+
+/* status.flags bits */
+#define HUB_STATUS_DONE			(0x0001u)	/* the frame of the last trigger is published */
+#define HUB_STATUS_SYNC_MISSED	(0x0002u)	/* a sync edge arrived while the hub was still busy */
+#define HUB_STATUS_BSLN_FROZEN	(0x0004u)	/* baselines are not updated */
+#define HUB_STATUS_BSLN_RESET	(0x0008u)	/* baselines were reset to the raw counts in this frame */
+#define HUB_STATUS_BSLN_CONVERGING	(0x0010u)	/* baselines follow the raw counts directly (converge window) */
+#define HUB_STATUS_READY		(0x0020u)	/* baselines are valid, set once per boot with the first such frame */
+#define HUB_STATUS_INIT_OK		(0x0040u)	/* CAPSENSE init succeeded */
+#define HUB_STATUS_CAL_OK		(0x0080u)	/* sensor calibration succeeded or was restored from the cache */
+#define HUB_STATUS_BSLN_CONVERGED	(0x0100u)	/* baselines of this frame are settled (no converge window) */
+#define HUB_STATUS_SCAN_ERROR	(0x0200u)	/* a scan or its processing failed, values may be stale */
+#define HUB_STATUS_OVERFLOW		(0x0400u)	/* a raw count of this frame overflowed, values are clipped */
+#define HUB_STATUS_FRAME_VALID	(0x8000u)	/* INIT_OK, CAL_OK, BSLN_CONVERGED and no SCAN_ERROR / OVERFLOW */
+
+/* HUB_MODE_* the frame was taken in, bits 13..12 of status.flags */
+#define HUB_STATUS_MODE_Pos		(12u)
+#define HUB_STATUS_MODE_Msk		(0x3000u)
+#define HUB_STATUS_MODE(flags)	(((uint32_t)(flags) & HUB_STATUS_MODE_Msk) >> HUB_STATUS_MODE_Pos)
+
+/* stats.tuner values */
+#define HUB_TUNER_COMPILED_OUT	(0u)	/* production build, HUB_TUNER_ENABLE = 0 */
+#define HUB_TUNER_DETACHED		(1u)	/* no Tuner access yet, RunTuner is skipped */
+#define HUB_TUNER_ATTACHED		(2u)	/* a Tuner accessed buffer 1, RunTuner runs every frame */
+
+/* stats.filter values, spike filter on the raw counts */
+#define HUB_FILTER_OFF			(0u)
+#define HUB_FILTER_MEDIAN3		(1u)
+#define HUB_FILTER_MEDIAN5		(2u)
+#define HUB_FILTER_HAMPEL		(3u)
+
+/* stats.boot_state values */
+#define HUB_BOOT_IDLE			(0u)	/* normal operation */
+#define HUB_BOOT_RECEIVING		(1u)	/* update started, scanning stopped, rows are staged */
+
+/* stats.power values, power mode the hub booted in */
+#define HUB_POWER_CONTINUOUS	(0u)	/* powered permanently (default) */
+#define HUB_POWER_GATED			(1u)	/* powered around each sample, starts from the calibration cache */
+
+/* stats.cal_state values */
+#define HUB_CAL_NONE			(0u)	/* no calibration cache for this configuration */
+#define HUB_CAL_STORED			(1u)	/* a valid cache exists, not used at this boot */
+#define HUB_CAL_RESTORED		(2u)	/* this boot started from the cache */
+
+/* stats.reset_cause values, cause of the last reset */
+#define HUB_RESET_POWER			(0u)	/* power-on or external reset */
+#define HUB_RESET_WATCHDOG		(1u)	/* the main loop hung, see hub_wdt.h */
+#define HUB_RESET_SOFT			(2u)	/* HUB_CMD_RESET or a firmware update */
+
+/* stats.tune_state values */
+#define HUB_TUNE_IDLE			(0u)	/* no sweep since boot */
+#define HUB_TUNE_RUNNING		(1u)	/* sweep in progress, keep the sensors untouched */
+#define HUB_TUNE_DONE			(2u)	/* every widget reached the target, the result is stored */
+#define HUB_TUNE_FAILED			(3u)	/* a widget missed the target or the result could not be stored */
+
+/* stats.noise_state values */
+#define HUB_NOISE_IDLE			(0u)	/* no results */
+#define HUB_NOISE_RUNNING		(1u)	/* measurement in progress, keep the sensors untouched */
+#define HUB_NOISE_DONE			(2u)	/* results of the last measurement, not stored */
+#define HUB_NOISE_STORED		(3u)	/* results stored in flash, published at every boot */
+
+/* stats.trace_state values */
+#define HUB_TRACE_OFF			(0u)	/* not recording, the ring holds the last trace */
+#define HUB_TRACE_RUNNING		(1u)	/* recording until stopped */
+#define HUB_TRACE_ARMED			(2u)	/* recording until a frame is late */
+#define HUB_TRACE_TRIGGERED		(3u)	/* stopped by a late frame, ready to read */
+
+/* sensor[i].hop values, channel + 1 of the rejected frequency channel */
+#define HUB_HOP_NONE			(0u)	/* all channels agreed, or no multi-frequency scan */
+
+/* sensor[i].bist bits, results of the last complete self-test pass */
+#define HUB_BIST_TESTED			(0x0001u)	/* the sensor was covered by the pass */
+#define HUB_BIST_SHORT			(0x0002u)	/* an electrode is shorted to ground, supply or another pin */
+#define HUB_BIST_CP_FAIL		(0x0004u)	/* the electrode capacitance could not be measured */
+#define HUB_BIST_CRC_FAIL		(0x0008u)	/* the widget configuration is corrupted */
+
+/* Reads a register the host may change at any time from the EZI2C interrupt */
+#define HUB_REG_READ8(reg)		(*(volatile const uint8_t *)&(reg))
+
+/* Control window, written by the host */
+typedef struct
+{
+	uint8_t mode;			/* 0x00 HUB_MODE_* */
+	uint8_t trigger;		/* 0x01 non-zero starts one scan in one-shot mode, cleared by the hub */
+	uint16_t reserved;		/* 0x02 */
+	uint32_t epoch;			/* 0x04 epoch of the next sync edge, advanced by the hub */
+	uint8_t cmd;			/* 0x08 HUB_CMD_*, cleared by the hub when done */
+	uint8_t result;			/* 0x09 HUB_RESULT_* of the last command */
+	uint8_t arg[HUB_CTRL_ARG_SIZE];	/* 0x0A command arguments */
+} hub_ctrl_t;
+
+/* Map description, read once by the host */
+typedef struct
+{
+	uint16_t magic;			/* 0x20 HUB_REGMAP_MAGIC */
+	uint8_t  version;		/* 0x22 HUB_REGMAP_VERSION */
+	uint8_t  num_sensors;	/* 0x23 N */
+	uint16_t map_size;		/* 0x24 total size of the map in bytes */
+	uint16_t field_base;	/* 0x26 sub-address of the first field window */
+	uint16_t field_stride;	/* 0x28 bytes between two field windows */
+	uint16_t sensor_base;	/* 0x2A sub-address of the first sensor window */
+	uint16_t sensor_stride;	/* 0x2C bytes between two sensor windows */
+	uint8_t  i2c_addr;		/* 0x2E tuner address in use, data address is one higher */
+	uint8_t  reserved;		/* 0x2F */
+} hub_info_t;
+
+/* Frame status, updated with every published frame */
+typedef struct
+{
+	uint32_t seq;			/* 0x30 frame sequence number */
+	uint16_t flags;			/* 0x34 HUB_STATUS_* and the mode of the frame (HUB_STATUS_MODE_Msk) */
+	uint16_t idle_ms;		/* 0x36 idle time before the current free-run scan, 0 = full rate (see hub_rate.h) */
+	uint32_t latency_us;	/* 0x38 trigger or sync edge to publish time of the last frame */
+	uint32_t epoch;			/* 0x3C sync epoch of the last frame (sync mode only) */
+} hub_status_t;
+
+/* Firmware statistics, updated with every published frame */
+typedef struct
+{
+	uint32_t frame_us;		/* 0x40 time between the last two published frames */
+	uint16_t frame_rate;	/* 0x44 frames published during the last full second */
+	uint16_t process_us;	/* 0x46 processing, publishing and Tuner time of the last frame */
+	uint16_t tuner_us;		/* 0x48 time spent in Cy_CapSense_RunTuner in the last frame */
+	uint8_t  tuner;			/* 0x4A HUB_TUNER_* */
+	uint8_t  reserved;		/* 0x4B */
+	uint16_t overruns;		/* 0x4C main loop task runs over their budget, all tasks */
+	uint8_t  task_count;	/* 0x4E number of main loop tasks */
+	uint8_t  reserved2;		/* 0x4F */
+	uint8_t  task_overruns[HUB_MAX_TASKS];	/* 0x50 overruns per task in priority order, saturating */
+	uint32_t health;		/* 0x58 bit i set: sensor i passed the last self-test pass */
+	uint16_t bist_passes;	/* 0x5C completed self-test passes, 0 = no result yet */
+	uint16_t reserved3;		/* 0x5E */
+	uint32_t sensor_mask;	/* 0x60 enable mask of the current frames, bit i = sensor i */
+	uint8_t  active_sensors;	/* 0x64 number of sensors scanned per frame */
+	uint8_t  filter;		/* 0x65 HUB_FILTER_* */
+	uint16_t reserved4;		/* 0x66 */
+	uint32_t rejects;		/* 0x68 raw count spikes rejected by the filter, all sensors */
+	uint32_t xtalk_cycles;	/* 0x6C CPU cycles of the cross-talk compensation in the last frame */
+	uint16_t rec_base;		/* 0x70 sub-address of the record window */
+	uint16_t rec_rows;		/* 0x72 flash rows holding records */
+	uint8_t  rec_state;		/* 0x74 1 = recording */
+	uint8_t  rec_shift;		/* 0x75 2^rec_shift frames per record */
+	uint16_t spi_frame;		/* 0x76 bytes per SPI stream transaction, 0 = no SPI stream */
+	uint16_t boot_rows;		/* 0x78 largest update image in flash rows, 0 = no updater */
+	uint8_t  boot_state;	/* 0x7A HUB_BOOT_* */
+	uint8_t  reserved6;		/* 0x7B */
+	uint32_t spi_lost;		/* 0x7C frames dropped by the SPI stream on a full FIFO */
+	uint32_t boot_us;		/* 0x80 end of cybsp_init() (clocks set) to the first HUB_STATUS_READY frame, 0 = not ready; excludes ROM boot, startup and clock init (see hub_cal.h) */
+	uint8_t  power;			/* 0x84 HUB_POWER_* */
+	uint8_t  cal_state;		/* 0x85 HUB_CAL_* */
+	uint16_t reserved8;		/* 0x86 */
+	uint16_t i2c_wait_us;	/* 0x88 longest time an EZI2C interrupt waited for other handlers, masked regions and flash writes (see hub_irq.h) */
+	uint16_t i2c_isr_us;	/* 0x8A longest EZI2C handler run */
+	uint16_t i2c_stretch_us;	/* 0x8C longest waiting plus handler time, the measured part of the clock stretch */
+	uint16_t i2c_delayed;	/* 0x8E EZI2C interrupts that had to wait, saturating */
+	uint16_t stalls;		/* 0x90 scan stalls recovered by re-initializing the CAPSENSE block */
+	uint8_t  reset_cause;	/* 0x92 HUB_RESET_* */
+	uint8_t  reserved10;	/* 0x93 */
+	uint32_t recover_us;	/* 0x94 outage of the last stall, scan start to scanning again */
+	uint8_t  tune_state;	/* 0x98 HUB_TUNE_* */
+	uint8_t  tune_widget;	/* 0x99 widget under test */
+	uint8_t  tune_step;		/* 0x9A setting under test, sub-conversion index * clock shifts + clock shift index */
+	uint8_t  reserved12;	/* 0x9B */
+	uint16_t tune_snr;		/* 0x9C lowest SNR x10 of the chosen settings, 0xFFFF = none yet */
+	uint16_t tune_noise;	/* 0x9E peak-to-peak raw count noise of the last measured setting */
+	uint8_t  hop_channels;	/* 0xA0 frequency channels per scan, 1 = no frequency hopping */
+	uint8_t  reserved14;	/* 0xA1 */
+	uint16_t hop_rejects[3];	/* 0xA2 rejected channels per frequency channel, all sensors, saturating */
+	uint8_t  noise_state;	/* 0xA8 HUB_NOISE_* */
+	uint8_t  reserved15;	/* 0xA9 */
+	uint16_t noise_frames;	/* 0xAA frames per sensor of the noise results */
+	uint16_t noise_signal;	/* 0xAC signal of the SNR results in raw counts, 0 = finger thresholds */
+	uint16_t reserved16;	/* 0xAE */
+	uint8_t  trace_state;	/* 0xB0 HUB_TRACE_* */
+	uint8_t  trace_mhz;		/* 0xB1 CPU clock in MHz, cycles per microsecond of the trace events */
+	uint16_t trace_depth;	/* 0xB2 events the trace ring holds, 0 = built without the trace */
+	uint32_t trace_count;	/* 0xB4 events recorded since the trace was started */
+	uint32_t reserved13[2];	/* 0xB8 */
+} hub_stats_t;
+
+/* Per-field windows, one array per value type (layout of the former capsense_data) */
+typedef struct
+{
+	uint16_t rawcount[NUM_OF_SENSORS];
+	uint16_t diffcount[NUM_OF_SENSORS];
+	uint16_t baseline[NUM_OF_SENSORS];
+} hub_fields_t;
+
+/* Per-sensor window, all values of one sensor in a single short read */
+typedef struct
+{
+	uint16_t raw;
+	uint16_t diff;
+	uint16_t bsln;
+	uint16_t cp;			/* electrode capacitance in 10 fF steps from the last self-test pass */
+	uint16_t bist;			/* HUB_BIST_* */
+	uint16_t seq;			/* low half of status.seq of the frame that last scanned the sensor */
+	uint16_t rejects;		/* raw count spikes rejected by the filter, saturating */
+	uint16_t hop;			/* HUB_HOP_NONE or channel + 1 rejected by the median of the last scan */
+	uint16_t noise_pp;		/* peak-to-peak raw count noise of the noise measurement (see hub_noise.h) */
+	uint16_t noise_rms;		/* RMS raw count noise in 0.1 counts */
+	uint16_t snr;			/* signal / peak-to-peak noise x10 */
+	int16_t  slope;			/* rate of change of diff in counts per minute (see hub_slope.h) */
+} hub_sensor_regs_t;
+
+/* Record window, one recorded flash row per HUB_CMD_REC_READ, one image
+ * row per HUB_CMD_BOOT_WRITE, or one chunk of events per HUB_CMD_TRACE_READ
+ */
+typedef struct
+{
+	uint16_t index;			/* row or chunk the window holds, 0 = oldest / first image row */
+	uint16_t crc;			/* CRC-16/CCITT of data, checked by HUB_CMD_BOOT_WRITE */
+	uint8_t  data[HUB_REC_ROW_SIZE];	/* hub_rec_row_t header and records */
+} hub_rec_regs_t;
+
+typedef struct
+{
+	hub_ctrl_t ctrl;
+	hub_info_t info;
+	hub_status_t status;
+	hub_stats_t stats;
+	hub_fields_t field;
+	hub_sensor_regs_t sensor[NUM_OF_SENSORS];
+	hub_rec_regs_t rec;
+} hub_regmap_t;
+
+_Static_assert(sizeof(hub_ctrl_t) == HUB_CTRL_SIZE, "control window size changed");
+_Static_assert(offsetof(hub_regmap_t, info) == HUB_REG_INFO, "info block moved");
+_Static_assert(offsetof(hub_regmap_t, status) == HUB_REG_STATUS, "status block moved");
+_Static_assert(offsetof(hub_regmap_t, stats) == HUB_REG_STATS, "stats block moved");
+_Static_assert(offsetof(hub_regmap_t, field) == HUB_REG_FIELD, "field windows moved");
+_Static_assert(sizeof(hub_regmap_t) <= 0x10000u, "map exceeds the 16-bit sub-address range");
+
+#endif /* HUB_REGMAP_H */
@@ -0,0 +1,153 @@
+/*******************************************************************************
+* File Name:   hub_sched.c
+*
+* Description: Run-to-completion scheduler, see hub_sched.h
+*
+*******************************************************************************/
+#include "cy_pdl.h"
+#include "hub_irq.h"
+#include "hub_sched.h"
+#include "hub_time.h"
+#include "hub_trace.h"
+
+static hub_task_t *sched_tasks;
+static uint32_t sched_count;
+
+/*******************************************************************************
+* Function Name: task_due
+********************************************************************************
+* Summary:
+*  Checks the period and the ready() condition of a task. The period is
+*  compared as a signed difference so it survives the cycle counter wrap.
+*
+*******************************************************************************/
+static bool task_due(const hub_task_t *task, uint32_t now)
+{
+	if((0u != task->period_us) && ((int32_t)(now - task->next_cycles) < 0))
+	{
+		return false;
+	}
+	return (NULL == task->ready) || task->ready();
+}
+
+/*******************************************************************************
+* Function Name: hub_sched_init
+********************************************************************************
+* Summary:
+*  Converts the periods and budgets to cycles and makes all periodic tasks
+*  due one period from now.
+*
+*******************************************************************************/
+void hub_sched_init(hub_task_t *tasks, uint32_t count)
+{
+	uint32_t cycles_per_us = SystemCoreClock / 1000000u;
+	uint32_t now = hub_time_cycles();
+
+	sched_tasks = tasks;
+	sched_count = count;
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		tasks[i].budget_cycles = tasks[i].budget_us * cycles_per_us;
+		tasks[i].next_cycles = now + (tasks[i].period_us * cycles_per_us);
+		tasks[i].max_cycles = 0u;
+		tasks[i].overruns = 0u;
+	}
+}
+
+/*******************************************************************************
+* Function Name: hub_sched_step
+********************************************************************************
+* Summary:
+*  Runs the first due task of the table and accounts its run time.
+*
+*******************************************************************************/
+bool hub_sched_step(void)
+{
+	uint32_t now = hub_time_cycles();
+
+	for(uint32_t i = 0; i < sched_count; i++)
+	{
+		hub_task_t *task = &sched_tasks[i];
+
+		if(task_due(task, now))
+		{
+			uint32_t start = hub_time_cycles();
+			uint32_t used;
+
+			if(0u != task->period_us)
+			{
+				task->next_cycles += task->period_us * (SystemCoreClock / 1000000u);
+				if((int32_t)(start - task->next_cycles) >= 0)
+				{
+					/* Fell behind by more than a period, do not try to catch up */
+					task->next_cycles = start + (task->period_us * (SystemCoreClock / 1000000u));
+				}
+			}
+
+			hub_trace(HUB_TRACE_TASK_BEGIN + i);
+			task->run();
+			hub_trace(HUB_TRACE_TASK_END + i);
+
+			used = hub_time_cycles() - start;
+			if(used > task->max_cycles)
+			{
+				task->max_cycles = used;
+			}
+			if((0u != task->budget_cycles) && (used > task->budget_cycles) && (task->overruns < UINT16_MAX))
+			{
+				task->overruns++;
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+/*******************************************************************************
+* Function Name: hub_sched_idle
+********************************************************************************
+* Summary:
+*  Checks all tasks again with interrupts disabled, so an interrupt that makes
+*  a task due between the last step and the sleep still wakes the CPU. An
+*  EZI2C interrupt that wakes the CPU waits from the wake-up on; one that was
+*  pending before returns from the sleep at once and waits for all of it.
+*
+*******************************************************************************/
+void hub_sched_idle(void)
+{
+	bool due = false;
+	uint32_t start = hub_irq_mask_begin();
+	uint32_t now = start;
+
+	for(uint32_t i = 0; (i < sched_count) && !due; i++)
+	{
+		due = task_due(&sched_tasks[i], now);
+	}
+	if(!due)
+	{
+		bool pending = hub_irq_ezi2c_pending();
+
+		hub_trace(HUB_TRACE_SLEEP);
+		Cy_SysPm_CpuEnterSleep();
+		hub_trace(HUB_TRACE_WAKE);
+		if(!pending)
+		{
+			start = hub_time_cycles();
+		}
+	}
+	hub_irq_mask_end(start);
+}
+
+/*******************************************************************************
+* Function Name: hub_sched_tasks
+********************************************************************************
+* Summary:
+*  Gives read access to the task table and its run time statistics.
+*
+*******************************************************************************/
+const hub_task_t *hub_sched_tasks(uint32_t *count)
+{
+	*count = sched_count;
+	return sched_tasks;
+}
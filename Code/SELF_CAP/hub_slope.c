@@ -0,0 +1,158 @@
+/*******************************************************************************
+* File Name:   hub_slope.c
+*
+* Description: Rate of change of the diff counts, see hub_slope.h
+*
+*******************************************************************************/
+#include "cy_pdl.h"
+#include "cycfg_capsense.h"
+#include "hub_scan.h"
+#include "hub_slope.h"
+
+#define SLOPE_MS_PER_MIN		(60000)
+
+_Static_assert(HUB_SLOPE_WINDOW >= 2u, "HUB_SLOPE_WINDOW needs two samples for a slope");
+_Static_assert((HUB_SLOPE_WINDOW * HUB_SLOPE_GAP_MS) < 0x7FFFFFFFu, "The window must fit into 31 bits of milliseconds");
+
+/* Window of one sensor. x is the time in ms relative to the newest sample,
+ * so all x are <= 0 and the newest sample adds nothing to Sx, Sxx and Sxy.
+ * The ring holds the low 32 bits of the update times; within a window they
+ * are less than HUB_SLOPE_WINDOW * HUB_SLOPE_GAP_MS apart, the gap check
+ * uses the full time of the newest sample.
+ */
+typedef struct
+{
+	uint64_t newest_ms;		/* full update time of the newest sample */
+	uint32_t t[HUB_SLOPE_WINDOW];	/* update times in ms, ring */
+	uint16_t y[HUB_SLOPE_WINDOW];	/* diff counts, ring */
+	uint32_t oldest;		/* ring index of the oldest sample */
+	uint32_t n;
+	int64_t sx;
+	int64_t sxx;
+	int64_t sy;
+	int64_t sxy;
+} slope_window_t;
+
+static hub_regmap_t *slope_map;
+static slope_window_t slope_win[NUM_OF_SENSORS];
+
+/*******************************************************************************
+* Function Name: slope_add
+********************************************************************************
+* Summary:
+*  Moves the window of a sensor to a new sample at time now_ms.
+*
+*******************************************************************************/
+static void slope_add(slope_window_t *win, uint64_t now_ms, uint16_t y)
+{
+	uint32_t t = (uint32_t)now_ms;
+
+	if(0u != win->n)
+	{
+		if((now_ms - win->newest_ms) > HUB_SLOPE_GAP_MS)
+		{
+			win->n = 0u;
+		}
+		else
+		{
+			int64_t g = (int64_t)(now_ms - win->newest_ms);
+
+			/* x' = x - g for all samples in the window */
+			win->sxx += (-2 * g * win->sx) + ((int64_t)win->n * g * g);
+			win->sxy -= g * win->sy;
+			win->sx -= (int64_t)win->n * g;
+		}
+	}
+	if(0u == win->n)
+	{
+		win->oldest = 0u;
+		win->sx = 0;
+		win->sxx = 0;
+		win->sy = 0;
+		win->sxy = 0;
+	}
+	else if(HUB_SLOPE_WINDOW == win->n)
+	{
+		int64_t x = -(int64_t)(t - win->t[win->oldest]);
+		int64_t yo = win->y[win->oldest];
+
+		win->sx -= x;
+		win->sxx -= x * x;
+		win->sy -= yo;
+		win->sxy -= x * yo;
+		win->oldest = (win->oldest + 1u) % HUB_SLOPE_WINDOW;
+		win->n--;
+	}
+
+	uint32_t slot = (win->oldest + win->n) % HUB_SLOPE_WINDOW;
+
+	win->t[slot] = t;
+	win->newest_ms = now_ms;
+	win->y[slot] = y;
+	win->sy += y;
+	win->n++;
+}
+
+/*******************************************************************************
+* Function Name: slope_get
+********************************************************************************
+* Summary:
+*  Least-squares slope of the window in counts per minute, saturated.
+*
+*******************************************************************************/
+static int16_t slope_get(const slope_window_t *win)
+{
+	int64_t n = (int64_t)win->n;
+	int64_t den = (n * win->sxx) - (win->sx * win->sx);
+	int64_t slope;
+
+	if((win->n < 2u) || (den <= 0))
+	{
+		return 0;
+	}
+	slope = (((n * win->sxy) - (win->sx * win->sy)) * SLOPE_MS_PER_MIN) / den;
+	if(slope > INT16_MAX)
+	{
+		return INT16_MAX;
+	}
+	if(slope < INT16_MIN)
+	{
+		return INT16_MIN;
+	}
+	return (int16_t)slope;
+}
+
+/*******************************************************************************
+* Function Name: hub_slope_init
+********************************************************************************
+* Summary:
+*  Keeps the map the slopes are published in.
+*
+*******************************************************************************/
+void hub_slope_init(hub_regmap_t *map)
+{
+	slope_map = map;
+}
+
+/*******************************************************************************
+* Function Name: hub_slope_frame
+********************************************************************************
+* Summary:
+*  Called after publishing. Sensors not updated in the frame keep their
+*  window and their slope.
+*
+*******************************************************************************/
+void hub_slope_frame(uint64_t scan_us)
+{
+	uint64_t ms = scan_us / 1000u;
+
+	for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+	{
+		if(!hub_scan_sensor_updated(i) || !hub_scan_sensor_enabled(i))
+		{
+			continue;
+		}
+		slope_add(&slope_win[i], ms, slope_map->field.diffcount[i]);
+		slope_map->sensor[i].slope = slope_get(&slope_win[i]);
+	}
+}
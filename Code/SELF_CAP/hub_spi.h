@@ -0,0 +1,69 @@
+/*******************************************************************************
+* File Name:   hub_spi.h
+*
+* Description: Frame stream over an SPI slave, for hosts that need every frame
+* (noise studies at full scan rate) where EZI2C polling would lose frames.
+*
+* Every published frame is queued in a FIFO of HUB_SPI_DEPTH frames. The host
+* reads one hub_spi_frame_t per chip select (SPI mode 0, MSB first, MOSI is
+* ignored). The frame carries the sequence number, flags and mode of the
+* status block and the per-field window exactly as published over I2C, so
+* both paths can be mixed. A frame only leaves the FIFO once the host has
+* clocked all of its bytes; a read cut short by the chip select returns the
+* same frame again.
+*
+* When the FIFO is empty the host gets a frame of type HUB_SPI_IDLE. A full
+* FIFO drops new frames and counts them in the next queued frame (lost) and
+* in stats.spi_lost.
+*
+* The SPI is an SCB named SPI in the Device Configurator (SPI slave, mode 0,
+* 8-bit). The PSoC 4000T has two SCBs, so the SPI usually takes the SCB of the
+* UART, whose output is then compiled out. Without an SCB named SPI the
+* stream is compiled out and stats.spi_frame reads 0.
+*
+*******************************************************************************/
+#ifndef HUB_SPI_H
+#define HUB_SPI_H
+
+#include <stdint.h>
+#include "cycfg.h"
+#include "hub_regmap.h"
+
+#if defined(SPI_HW)
+#define HUB_SPI_AVAILABLE		(1u)
+#else
+#define HUB_SPI_AVAILABLE		(0u)
+#endif
+
+/* Queued frames, a power of two */
+#ifndef HUB_SPI_DEPTH
+#define HUB_SPI_DEPTH			(8u)
+#endif
+
+#define HUB_SPI_MAGIC			(0x5346u)	/* "FS" */
+
+/* hub_spi_frame_t.type values */
+#define HUB_SPI_IDLE			(0u)	/* no frame was waiting, the rest of the frame is zero */
+#define HUB_SPI_FRAME			(1u)
+
+/* One SPI transaction, stats.spi_frame bytes including any padding */
+typedef struct
+{
+	uint16_t magic;			/* HUB_SPI_MAGIC */
+	uint8_t  type;			/* HUB_SPI_IDLE / HUB_SPI_FRAME */
+	uint8_t  num_sensors;	/* N */
+	uint32_t seq;			/* status.seq of the frame */
+	uint16_t flags;			/* status.flags of the frame */
+	uint16_t lost;			/* frames dropped before this one, saturating */
+	uint8_t  mode;			/* HUB_MODE_* of the frame, from status.flags */
+	uint8_t  reserved;
+	hub_fields_t field;		/* per-field window of the frame */
+	uint16_t crc;			/* CRC-16/CCITT of the bytes before */
+} hub_spi_frame_t;
+
+void hub_spi_init(hub_regmap_t *map);
+
+/* Queues the frame just published in the map */
+void hub_spi_frame(void);
+
+#endif /* HUB_SPI_H */
@@ -0,0 +1,75 @@
+/*******************************************************************************
+* File Name:   hub_wdt.h
+*
+* Description: Scan-stall detection and watchdog. If the MSCLP hangs,
+* Cy_CapSense_IsBusy() never reports the end of the scan and the hub would
+* stop publishing for good. Every scan is given a deadline (its start delay
+* plus HUB_WDT_STALL_MS); a scan past its deadline is a stall, and the main
+* loop then re-initializes only the CAPSENSE block. The calibration cache
+* (see hub_cal.h) is restored like on a power-gated start, otherwise the
+* recovery recalibrates and lets the baselines converge again. Scanning
+* resumes in place, with the register map, the settings and the host
+* connection untouched.
+*
+* The WDT wakes the CPU at the deadline, so a stall is found within
+* milliseconds even when no other interrupt arrives, and it is fed from the
+* main loop before every sleep. If the main loop itself hangs, e.g. inside
+* a middleware call, the unserviced WDT resets the hub after two more
+* counter periods (about three seconds) as the last resort. The same goes
+* for a failed board init, which is retried by that reset.
+*
+* stats.stalls counts the recoveries, stats.recover_us holds the outage of
+* the last one (scan start to scanning again) and stats.reset_cause tells
+* whether the last reset came from the watchdog.
+*
+*******************************************************************************/
+#ifndef HUB_WDT_H
+#define HUB_WDT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hub_regmap.h"
+
+/* Longest scan of a frame, after its start delay */
+#ifndef HUB_WDT_STALL_MS
+#define HUB_WDT_STALL_MS		(50u)
+#endif
+
+/* Wake-up period of the watchdog while no scan runs, below one counter period */
+#ifndef HUB_WDT_IDLE_MS
+#define HUB_WDT_IDLE_MS			(1000u)
+#endif
+
+/* Nominal ILO frequency, the WDT clock */
+#ifndef HUB_WDT_ILO_HZ
+#define HUB_WDT_ILO_HZ			(40000u)
+#endif
+
+#ifndef HUB_WDT_IRQ
+#define HUB_WDT_IRQ				(srss_interrupt_wdt_IRQn)
+#endif
+
+/* Starts the watchdog, first thing after reset */
+void hub_wdt_enable(void);
+
+/* Stops the watchdog before a firmware update is installed */
+void hub_wdt_disable(void);
+
+void hub_wdt_init(hub_regmap_t *map);
+
+/* A scan was started with the given delay, or a frame was finished */
+void hub_wdt_arm(uint32_t delay_us);
+void hub_wdt_disarm(void);
+
+/* True if the armed scan is past its deadline */
+bool hub_wdt_stalled(void);
+
+/* Called before the CPU sleeps: services the watchdog and wakes the CPU at
+ * the deadline of the running scan
+ */
+void hub_wdt_feed(void);
+
+/* The CAPSENSE block was re-initialized after a stall */
+void hub_wdt_recovered(void);
+
+#endif /* HUB_WDT_H */
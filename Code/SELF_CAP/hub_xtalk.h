@@ -0,0 +1,37 @@
+/*******************************************************************************
+* File Name:   hub_xtalk.h
+*
+* Description: Cross-talk compensation of the diff counts. Neighbouring
+* electrodes couple into each other, so every published diff count is a
+* weighted sum of the measured ones:
+*
+*   diff'[i] = sum over j of M[i][j] * diff[j]
+*
+* M is an NxN matrix of signed Q14 coefficients (16384 = 1.0), kept in the
+* settings and loaded from the host in chunks. The identity matrix (the
+* default) skips the kernel altogether. The result is clamped to 0..65535.
+*
+*******************************************************************************/
+#ifndef HUB_XTALK_H
+#define HUB_XTALK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hub_regmap.h"
+
+void hub_xtalk_init(hub_regmap_t *map);
+
+/* Writes count coefficients, row-major from element first, into the working
+ * settings. Returns false if the range does not fit the matrix.
+ */
+bool hub_xtalk_set(uint32_t first, uint32_t count, const uint8_t *coeffs);
+
+/* Computes the compensated diff counts of all sensors. Disabled sensors
+ * contribute nothing.
+ */
+void hub_xtalk_apply(void);
+
+/* Compensated diff count of sensor i from the last hub_xtalk_apply() */
+uint16_t hub_xtalk_diff(uint32_t sensor);
+
+#endif /* HUB_XTALK_H */
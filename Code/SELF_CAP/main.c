@@ -49,19 +49,36 @@
 #include "cybsp.h"
 #include "cycfg.h"
 #include "cycfg_capsense.h"
+#include "hub_bist.h"
+#include "hub_boot.h"
+#include "hub_bsln.h"
+#include "hub_cal.h"
+#include "hub_cmd.h"
+#include "hub_config.h"
+#include "hub_filter.h"
+#include "hub_hop.h"
+#include "hub_noise.h"
+#include "hub_irq.h"
+#include "hub_rate.h"
+#include "hub_rec.h"
+#include "hub_regmap.h"
+#include "hub_scan.h"
+#include "hub_sched.h"
+#include "hub_settings.h"
+#include "hub_slope.h"
+#include "hub_spi.h"
+#include "hub_sync.h"
+#include "hub_time.h"
+#include "hub_trace.h"
+#include "hub_tune.h"
+#include "hub_wdt.h"
+#include "hub_xtalk.h"
 #include <stdio.h>
 
 //#include "cy_retarget_io.h"
-// Update NUM_OF_SENSORS to match your actual sensor count (can also be checked with cy_capsense_tuner.sensorContext size)
-#define NUM_OF_SENSORS (sizeof(cy_capsense_tuner.sensorContext) / sizeof(cy_capsense_tuner.sensorContext[0]))
 
-// Struct for storing the capsense values for sending it over I2C
-struct
-{
-	uint16_t rawcount[NUM_OF_SENSORS];
-	uint16_t diffcount[NUM_OF_SENSORS];
-	uint16_t baseline[NUM_OF_SENSORS];
-}capsense_data;
+// Register map for sending the capsense values over I2C, see hub_regmap.h
+hub_regmap_t capsense_data;
 
 
 
@@ -70,6 +87,47 @@ struct
 
 
 cy_stc_scb_ezi2c_context_t ezi2c_context;
+
+/* RAM copy of the generated EZI2C_config, so the sub-address size can be changed */
+cy_stc_scb_ezi2c_config_t ezi2c_config;
+
+/* Trigger time, sync epoch and mode of the running scan, published with its
+ * frame. scan_start_us is when the scan itself starts (trigger time plus the
+ * adaptive idle time), the sample time of the frame.
+ */
+static uint32_t scan_start_cycles;
+static uint64_t scan_start_us;
+static uint32_t scan_epoch;
+static uint8_t scan_mode;
+
+/* Tuner interface state, published as stats.tuner */
+#if HUB_TUNER_ENABLE
+static uint8_t tuner_state = HUB_TUNER_DETACHED;
+#else
+static uint8_t tuner_state = HUB_TUNER_COMPILED_OUT;
+#endif
+
+/* Frame timing for the stats block */
+static uint32_t frame_last_cycles;
+static uint32_t frame_window_cycles;
+static uint16_t frame_window_count;
+
+/* True while the slot runs of a frame are being scanned */
+static bool scan_running;
+
+/* UART dump state: frames since the last dump, line being sent, and the
+ * formatted line with its length and the part already in the TX FIFO. The
+ * dump is compiled out when the UART's SCB is used for the SPI stream.
+ */
+#if defined(UART_HW)
+#define UART_DUMP_FRAMES	(100u)
+#define UART_LINE_IDLE		(NUM_OF_SENSORS + 1u)
+static uint32_t uart_frames;
+static uint32_t uart_line = UART_LINE_IDLE;
+static char uart_buffer[200];
+static uint32_t uart_len;
+static uint32_t uart_pos;
+#endif
 /*******************************************************************************
 * Function Name: capsense_msc0_isr
 ********************************************************************************
@@ -79,81 +137,819 @@ cy_stc_scb_ezi2c_context_t ezi2c_context;
 *******************************************************************************/
 static void capsense_msc0_isr(void)
 {
+    uint32_t hold = hub_irq_hold_begin();
+
     Cy_CapSense_InterruptHandler(CY_MSCLP0_HW, &cy_capsense_context);
+    hub_irq_hold_end(hold);
 }
 
 /*******************************************************************************
 * Function Name: ezi2c_isr
 ********************************************************************************
 * Summary:
-* Wrapper function for handling interrupts from EZI2C block.
+* Wrapper function for handling interrupts from EZI2C block, measures how long
+* the handler waited and ran and traces the start and stop of transactions.
 *
 *******************************************************************************/
 static void ezi2c_isr(void)
 {
+    uint32_t start = hub_irq_ezi2c_begin();
+    uint32_t cause = Cy_SCB_GetSlaveInterruptStatusMasked(EZI2C_HW);
+
+    if(0u != (cause & CY_SCB_SLAVE_INTR_I2C_ADDR_MATCH))
+    {
+        hub_trace(HUB_TRACE_I2C_START);
+    }
     Cy_SCB_EZI2C_Interrupt(EZI2C_HW, &ezi2c_context);
+    if(0u != (cause & CY_SCB_SLAVE_INTR_I2C_STOP))
+    {
+        hub_trace(HUB_TRACE_I2C_STOP);
+    }
+    hub_irq_ezi2c_end(start);
+}
+
+/*******************************************************************************
+* Function Name: capsense_start
+********************************************************************************
+* Summary:
+*  Captures the MSC block, sets up its interrupt and enables the middleware.
+*  In between, the scan parameters of the optimizer and the calibration
+*  cache are applied: the cache at power-up for a power-gated start, after a
+*  restart whenever it is valid.
+*
+* Return:
+*  Status of Cy_CapSense_Init() or Cy_CapSense_Enable().
+*
+*******************************************************************************/
+static cy_capsense_status_t capsense_start(bool recover)
+{
+	/* CAPSENSE interrupt configuration MSC 0 */
+	const cy_stc_sysint_t capsense_msc0_interrupt_config =
+	{
+		.intrSrc = CY_MSCLP0_LP_IRQ,
+		.intrPriority = HUB_IRQ_PRIO_CAPSENSE,
+	};
+
+	/* Capture the MSC HW block and initialize it to the default state. */
+	cy_capsense_status_t status = Cy_CapSense_Init(&cy_capsense_context);
+
+	if (CY_CAPSENSE_STATUS_SUCCESS == status)
+	{
+		/* Initialize CAPSENSE interrupt for MSC 0 */
+		Cy_SysInt_Init(&capsense_msc0_interrupt_config, capsense_msc0_isr);
+		NVIC_ClearPendingIRQ(capsense_msc0_interrupt_config.intrSrc);
+		NVIC_EnableIRQ(capsense_msc0_interrupt_config.intrSrc);
+
+		hub_tune_apply();
+		if(recover)
+		{
+			hub_cal_recover();
+		}
+		else
+		{
+			/* A power-gated hub starts from its cached calibration */
+			hub_cal_restore();
+		}
+
+		/* Initialize the CAPSENSE firmware modules. */
+		status = Cy_CapSense_Enable(&cy_capsense_context);
+	}
+	return status;
+}
+
+/*******************************************************************************
+* Function Name: strap_offset
+********************************************************************************
+* Summary:
+*  Reads the optional address strap pins ADDR0..ADDR2 (inputs with pull-up,
+*  named in the Device Configurator). A pin tied to ground sets its bit, so an
+*  unstrapped board keeps offset 0.
+*
+*******************************************************************************/
+static uint8_t strap_offset(void)
+{
+	uint8_t offset = 0u;
+
+#if defined(ADDR0_PORT)
+	offset |= (0u == Cy_GPIO_Read(ADDR0_PORT, ADDR0_NUM)) ? 0x01u : 0u;
+#endif
+#if defined(ADDR1_PORT)
+	offset |= (0u == Cy_GPIO_Read(ADDR1_PORT, ADDR1_NUM)) ? 0x02u : 0u;
+#endif
+#if defined(ADDR2_PORT)
+	offset |= (0u == Cy_GPIO_Read(ADDR2_PORT, ADDR2_NUM)) ? 0x04u : 0u;
+#endif
+
+	return offset;
 }
 
+/*******************************************************************************
+* Function Name: ezi2c_select_address
+********************************************************************************
+* Summary:
+*  Picks the tuner / data address pair: an address stored in flash wins,
+*  otherwise the generated pair is moved up by two per strap offset, so up to
+*  eight hubs (0x08/0x09 .. 0x16/0x17) can share one bus.
+*  Without the Tuner interface only the data address of the pair is used.
+*
+*******************************************************************************/
+static void ezi2c_select_address(cy_stc_scb_ezi2c_config_t *config)
+{
+	uint8_t spacing = EZI2C_config.slaveAddress2 - EZI2C_config.slaveAddress1;
+	uint8_t addr;
 
+	if(0u != hub_settings.i2c_addr)
+	{
+		addr = hub_settings.i2c_addr;
+	}
+	else
+	{
+		addr = EZI2C_config.slaveAddress1 + (2u * strap_offset());
+	}
+
+	config->slaveAddress1 = addr;
+	config->slaveAddress2 = addr + spacing;
+	capsense_data.info.i2c_addr = addr;
+
+#if !HUB_TUNER_ENABLE
+	config->numberOfAddresses = CY_SCB_EZI2C_ONE_ADDRESS;
+	config->slaveAddress1 = config->slaveAddress2;
+#endif
+}
+
+/*******************************************************************************
+* Function Name: regmap_init
+********************************************************************************
+* Summary:
+*  Fills the info block of the register map, so the host can locate the
+*  per-field and per-sensor windows without hard coding the sensor count.
+*
+*******************************************************************************/
+static void regmap_init(void)
+{
+	capsense_data.info.magic = HUB_REGMAP_MAGIC;
+	capsense_data.info.version = HUB_REGMAP_VERSION;
+	capsense_data.info.num_sensors = (uint8_t)NUM_OF_SENSORS;
+	capsense_data.info.map_size = (uint16_t)sizeof(capsense_data);
+	capsense_data.info.field_base = (uint16_t)offsetof(hub_regmap_t, field);
+	capsense_data.info.field_stride = (uint16_t)sizeof(capsense_data.field.rawcount);
+	capsense_data.info.sensor_base = (uint16_t)offsetof(hub_regmap_t, sensor);
+	capsense_data.info.sensor_stride = (uint16_t)sizeof(capsense_data.sensor[0]);
+}
+
+/*******************************************************************************
+* Function Name: regmap_expose
+********************************************************************************
+* Summary:
+*  Hands the register map to the EZI2C slave. The host may write the first
+*  rw_size bytes.
+*
+*******************************************************************************/
+static void regmap_expose(uint32_t rw_size)
+{
+#if HUB_TUNER_ENABLE
+	Cy_SCB_EZI2C_SetBuffer2(EZI2C_HW, (uint8_t *)&capsense_data,
+							sizeof(capsense_data), rw_size,
+							&ezi2c_context);
+#else
+	Cy_SCB_EZI2C_SetBuffer1(EZI2C_HW, (uint8_t *)&capsense_data,
+							sizeof(capsense_data), rw_size,
+							&ezi2c_context);
+#endif
+}
+
+/*******************************************************************************
+* Function Name: trigger_pending
+********************************************************************************
+* Summary:
+*  Returns true if the given mode wants a scan to start now: always in
+*  free-run mode, on a host trigger in one-shot mode and on a sync edge in
+*  sync mode.
+*
+*******************************************************************************/
+static bool trigger_pending(uint8_t mode)
+{
+	switch(mode)
+	{
+		case HUB_MODE_ONE_SHOT:
+			return (0u != HUB_REG_READ8(capsense_data.ctrl.trigger));
+		case HUB_MODE_SYNC:
+			return hub_sync_pending();
+		default:
+			return true;
+	}
+}
+
+/*******************************************************************************
+* Function Name: scan_start
+********************************************************************************
+* Summary:
+*  Starts a new scan if the current mode has a trigger pending and consumes
+*  the trigger.
+*
+* Return:
+*  true if a scan was started.
+*
+*******************************************************************************/
+static bool scan_start(void)
+{
+	uint8_t mode = HUB_REG_READ8(capsense_data.ctrl.mode);
+	uint32_t start = hub_time_cycles();
+
+	/* A firmware update keeps the scanning stopped until the reset */
+	if(hub_boot_active() || !trigger_pending(mode))
+	{
+		return false;
+	}
+
+	if(HUB_MODE_ONE_SHOT == mode)
+	{
+		capsense_data.ctrl.trigger = 0u;
+	}
+	else if(HUB_MODE_SYNC == mode)
+	{
+		/* Measure the latency from the edge, not from when the loop noticed it */
+		(void)hub_sync_take(&scan_epoch, &start);
+	}
+
+	if(HUB_MODE_FREE_RUN != mode)
+	{
+		capsense_data.status.flags &= (uint16_t)~HUB_STATUS_DONE;
+	}
+
+	uint32_t delay_us = (HUB_MODE_FREE_RUN == mode) ? hub_rate_delay_us() : 0u;
+
+	scan_mode = mode;
+	scan_start_cycles = start;
+	scan_start_us = hub_time_us(start) + delay_us;
+	hub_trace(HUB_TRACE_SCAN_START);
+	hub_scan_start(delay_us);
+	hub_wdt_arm(delay_us);
+	return true;
+}
+
+/*******************************************************************************
+* Function Name: stats_update
+********************************************************************************
+* Summary:
+*  Publishes the frame period, the frames per second, where the time of the
+*  last frame went and the task overrun counters. frame_rate is counted over
+*  one-second windows, which avoids a division per frame.
+*
+*******************************************************************************/
+static void stats_update(uint32_t done_cycles, uint32_t tuner_cycles)
+{
+	uint32_t now = hub_time_cycles();
+
+	capsense_data.stats.frame_us = hub_time_cycles_to_us(now - frame_last_cycles);
+	capsense_data.stats.process_us = (uint16_t)hub_time_cycles_to_us(now - done_cycles);
+	capsense_data.stats.tuner_us = (uint16_t)hub_time_cycles_to_us(tuner_cycles);
+	capsense_data.stats.tuner = tuner_state;
+	frame_last_cycles = now;
+
+	frame_window_count++;
+	if((now - frame_window_cycles) >= SystemCoreClock)
+	{
+		capsense_data.stats.frame_rate = frame_window_count;
+		frame_window_count = 0u;
+		frame_window_cycles = now;
+	}
+
+	uint32_t count;
+	const hub_task_t *task = hub_sched_tasks(&count);
+	uint16_t overruns = 0u;
+
+	capsense_data.stats.task_count = (uint8_t)count;
+	for(uint32_t i = 0; i < count; i++)
+	{
+		overruns += task[i].overruns;
+		if(i < HUB_MAX_TASKS)
+		{
+			capsense_data.stats.task_overruns[i] = (task[i].overruns > UINT8_MAX) ? UINT8_MAX : (uint8_t)task[i].overruns;
+		}
+	}
+	capsense_data.stats.overruns = overruns;
+}
+
+/*******************************************************************************
+* Function Name: ezi2c_activity
+********************************************************************************
+* Summary:
+*  Reads (and clears) the EZI2C activity. The first access to the Tuner buffer
+*  enables the Tuner protocol.
+*
+*******************************************************************************/
+static uint32_t ezi2c_activity(void)
+{
+	uint32_t activity = Cy_SCB_EZI2C_GetActivity(EZI2C_HW, &ezi2c_context);
+
+#if HUB_TUNER_ENABLE
+	if(0u != (activity & (CY_SCB_EZI2C_STATUS_READ1 | CY_SCB_EZI2C_STATUS_WRITE1)))
+	{
+		tuner_state = HUB_TUNER_ATTACHED;
+	}
+#endif
+
+	return activity;
+}
+
+/*******************************************************************************
+* Function Name: regmap_publish
+********************************************************************************
+* Summary:
+*  Copies the processed values of the sensors scanned in this frame into both
+*  the per-field and the per-sensor windows of the register map, and stamps
+*  them with the sequence number and the per-frame status flags. The flags,
+*  including the baseline state and HUB_STATUS_FRAME_VALID, are complete
+*  before they are stored in one write, so a host never sees the flags of
+*  one frame with the sequence number of another.
+*
+*******************************************************************************/
+static void regmap_publish(void)
+{
+	uint32_t seq = capsense_data.status.seq + 1u;
+	uint16_t flags = (uint16_t)(capsense_data.status.flags &
+								(uint16_t)~(HUB_STATUS_SYNC_MISSED | HUB_STATUS_SCAN_ERROR | HUB_STATUS_OVERFLOW |
+											HUB_STATUS_MODE_Msk));
+
+	/* Diff counts are published with the cross-talk of the neighbours removed */
+	hub_xtalk_apply();
+
+	for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
+	{
+		/* Sensors not scanned in this frame keep their last values; disabled
+		 * sensors are never scanned, their windows stay zero
+		 */
+		if(!hub_scan_sensor_updated(i))
+		{
+			continue;
+		}
+
+		/* Get raw counts and diff counts from all sensors from the sensor context */
+		const cy_stc_capsense_sensor_context_t *sns = &cy_capsense_tuner.sensorContext[i];
+
+		if(0u != (sns->status & CY_CAPSENSE_SNS_OVERFLOW_MASK))
+		{
+			flags |= HUB_STATUS_OVERFLOW;
+		}
+
+		capsense_data.field.rawcount[i] = sns->raw;
+		capsense_data.field.diffcount[i] = hub_xtalk_diff(i);
+		capsense_data.field.baseline[i] = sns->bsln;
+
+		capsense_data.sensor[i].raw = sns->raw;
+		capsense_data.sensor[i].diff = hub_xtalk_diff(i);
+		capsense_data.sensor[i].bsln = sns->bsln;
+		capsense_data.sensor[i].seq = (uint16_t)seq;
+	}
+
+	if(HUB_MODE_FREE_RUN != scan_mode)
+	{
+		capsense_data.status.latency_us = hub_time_cycles_to_us(hub_time_cycles() - scan_start_cycles);
+	}
+	if(HUB_MODE_SYNC == scan_mode)
+	{
+		capsense_data.status.epoch = scan_epoch;
+	}
+	if(hub_sync_missed())
+	{
+		flags |= HUB_STATUS_SYNC_MISSED;
+	}
+	if(hub_scan_failed())
+	{
+		flags |= HUB_STATUS_SCAN_ERROR;
+	}
+	flags |= (uint16_t)((uint32_t)scan_mode << HUB_STATUS_MODE_Pos);
+	capsense_data.status.seq = seq;
+	capsense_data.status.flags = hub_cal_frame(hub_bsln_flags(flags)) | HUB_STATUS_DONE;
+}
+
+
+
+/*******************************************************************************
+* Function Name: capsense_restart
+********************************************************************************
+* Summary:
+*  Re-initializes only the CAPSENSE block while no scan runs. The register
+*  map and the EZI2C are not touched, so the host just sees a gap in the
+*  sequence numbers.
+*
+*******************************************************************************/
+static void capsense_restart(void)
+{
+	NVIC_DisableIRQ(CY_MSCLP0_LP_IRQ);
+	(void)Cy_CapSense_DeInit(&cy_capsense_context);
+	hub_cal_resume(capsense_start(true));
+	hub_scan_restart();
+}
+
+/*******************************************************************************
+* Function Name: recover_ready
+********************************************************************************
+* Summary:
+*  The recovery task is due when the running scan is past its deadline.
+*
+*******************************************************************************/
+static bool recover_ready(void)
+{
+	return scan_running && hub_wdt_stalled();
+}
+
+/*******************************************************************************
+* Function Name: task_recover
+********************************************************************************
+* Summary:
+*  Re-initializes the CAPSENSE block after a scan stall and starts the next
+*  scan.
+*
+*******************************************************************************/
+static void task_recover(void)
+{
+	capsense_restart();
+	hub_wdt_recovered();
+
+	scan_running = scan_start();
+}
+
+/*******************************************************************************
+* Function Name: tune_ready
+********************************************************************************
+* Summary:
+*  The tune task is due when the optimizer waits for a restart and the last
+*  scan has finished.
+*
+*******************************************************************************/
+static bool tune_ready(void)
+{
+	return hub_tune_pending() && !scan_running;
+}
+
+/*******************************************************************************
+* Function Name: task_tune
+********************************************************************************
+* Summary:
+*  Restarts the CAPSENSE block with the next setting of the optimizer, or
+*  with its stored result. Waits for the end of a host transaction, since
+*  the result is written to flash first.
+*
+*******************************************************************************/
+static void task_tune(void)
+{
+	if(0u == (ezi2c_activity() & CY_SCB_EZI2C_STATUS_BUSY))
+	{
+		hub_tune_restart();
+		capsense_restart();
+
+		scan_running = scan_start();
+	}
+}
+
+/*******************************************************************************
+* Function Name: frame_ready
+********************************************************************************
+* Summary:
+*  The frame task is due as soon as a slot run of the running frame has
+*  finished.
+*
+*******************************************************************************/
+static bool frame_ready(void)
+{
+	return scan_running && !hub_scan_busy();
+}
+
+/*******************************************************************************
+* Function Name: task_frame
+********************************************************************************
+* Summary:
+*  Starts the next slot run of the frame, or processes and publishes the
+*  finished frame, services the Tuner and starts the next scan. Highest
+*  priority task.
+*
+*******************************************************************************/
+static void task_frame(void)
+{
+	if(hub_scan_next())
+	{
+		return;
+	}
+
+	uint32_t done_cycles = hub_time_cycles();
+	uint32_t tuner_cycles = 0u;
+
+	hub_trace(HUB_TRACE_SCAN_END);
+	scan_running = false;
+	hub_wdt_disarm();
+
+	/* Reject raw count spikes before they reach the baselines and the map */
+	hub_filter_frame();
+
+	/* Process the widgets scanned in this frame, with the baselines as the
+	 * host wants them
+	 */
+	hub_scan_process(hub_bsln_frame());
+	hub_hop_frame();
+
+	/* Store raw counts and diff counts for each sensor */
+	regmap_publish();
+	hub_trace(HUB_TRACE_PUBLISH);
+	hub_slope_frame(scan_start_us);
+	hub_tune_frame();
+	hub_noise_frame();
+	hub_rate_frame(scan_mode);
+	hub_rec_frame();
+	hub_spi_frame();
+	hub_irq_frame();
+
+	(void)ezi2c_activity();
+
+#if HUB_TUNER_ENABLE
+	/* Establishes synchronized communication with the CAPSENSE Tuner tool,
+	 * skipped until a Tuner has accessed its buffer
+	 */
+	if(HUB_TUNER_ATTACHED == tuner_state)
+	{
+		tuner_cycles = hub_time_cycles();
+		Cy_CapSense_RunTuner(&cy_capsense_context);
+		tuner_cycles = hub_time_cycles() - tuner_cycles;
+	}
+#endif
+
+	/* Start the next scan, unless this slot belongs to a self-test step or
+	 * the optimizer restarts the CAPSENSE block first
+	 */
+	if(!hub_bist_frame() && !hub_tune_pending())
+	{
+		scan_running = scan_start();
+	}
+
+	stats_update(done_cycles, tuner_cycles);
+	hub_trace_frame(capsense_data.stats.frame_us);
+#if defined(UART_HW)
+	uart_frames++;
+#endif
+}
+
+/*******************************************************************************
+* Function Name: command_ready
+********************************************************************************
+* Summary:
+*  The command task is due while a host command is waiting.
+*
+*******************************************************************************/
+static bool command_ready(void)
+{
+	return (HUB_CMD_NONE != HUB_REG_READ8(capsense_data.ctrl.cmd));
+}
+
+/*******************************************************************************
+* Function Name: task_command
+********************************************************************************
+* Summary:
+*  Executes a host command once the transaction that wrote it has ended, so
+*  all of its arguments are in place. A started firmware update opens the
+*  whole map for writing, the image rows come through the record window;
+*  when the update ends without a reset only the control block stays
+*  writable.
+*
+*******************************************************************************/
+static void task_command(void)
+{
+	if(0u == (ezi2c_activity() & CY_SCB_EZI2C_STATUS_BUSY))
+	{
+		bool boot = hub_boot_active();
+
+		hub_cmd_execute(&capsense_data.ctrl);
+		if(hub_boot_active() != boot)
+		{
+			uint32_t start = hub_irq_mask_begin();
+			regmap_expose(hub_boot_active() ? sizeof(capsense_data) : sizeof(capsense_data.ctrl));
+			hub_irq_mask_end(start);
+		}
+	}
+}
+
+/*******************************************************************************
+* Function Name: bist_ready
+********************************************************************************
+* Summary:
+*  The self-test task is due when a step is pending and the scan hardware is
+*  free. A host trigger or sync edge waiting in one-shot or sync mode goes
+*  first.
+*
+*******************************************************************************/
+static bool bist_ready(void)
+{
+	uint8_t mode = HUB_REG_READ8(capsense_data.ctrl.mode);
+
+	return !scan_running && !hub_boot_active() && hub_bist_pending() &&
+		   ((HUB_MODE_FREE_RUN == mode) || !trigger_pending(mode));
+}
+
+/*******************************************************************************
+* Function Name: task_bist
+********************************************************************************
+* Summary:
+*  Runs one self-test step in the slot of a scan; the trigger task starts the
+*  delayed scan right after it.
+*
+*******************************************************************************/
+static void task_bist(void)
+{
+	hub_bist_step();
+}
+
+/*******************************************************************************
+* Function Name: trigger_ready
+********************************************************************************
+* Summary:
+*  The trigger task is due when no scan runs and the mode wants one: after a
+*  host trigger, a sync edge, or a switch back to free-run mode.
+*
+*******************************************************************************/
+static bool trigger_ready(void)
+{
+	return !scan_running && !hub_boot_active() && trigger_pending(HUB_REG_READ8(capsense_data.ctrl.mode));
+}
+
+/*******************************************************************************
+* Function Name: task_trigger
+********************************************************************************
+* Summary:
+*  Starts a scan outside of the frame task.
+*
+*******************************************************************************/
+static void task_trigger(void)
+{
+	scan_running = scan_start();
+}
+
+/*******************************************************************************
+* Function Name: rec_ready
+********************************************************************************
+* Summary:
+*  The recorder task is due when a full row waits for its flash write.
+*
+*******************************************************************************/
+static bool rec_ready(void)
+{
+	return hub_rec_pending();
+}
+
+/*******************************************************************************
+* Function Name: task_rec
+********************************************************************************
+* Summary:
+*  Writes the recorded row between two host transactions, since the flash
+*  write stalls the CPU and with it the EZI2C interrupt.
+*
+*******************************************************************************/
+static void task_rec(void)
+{
+	if(0u == (ezi2c_activity() & CY_SCB_EZI2C_STATUS_BUSY))
+	{
+		hub_rec_write();
+	}
+}
+
+#if defined(UART_HW)
+/*******************************************************************************
+* Function Name: uart_ready
+********************************************************************************
+* Summary:
+*  The UART task is due while a dump is in progress and the TX FIFO has room,
+*  or when the next dump is due.
+*
+*******************************************************************************/
+static bool uart_ready(void)
+{
+	if(uart_pos < uart_len)
+	{
+		return (Cy_SCB_UART_GetNumInTxFifo(UART_HW) < Cy_SCB_UART_GetFifoSize(UART_HW));
+	}
+	return (uart_line < UART_LINE_IDLE) || (uart_frames >= UART_DUMP_FRAMES);
+}
+
+/*******************************************************************************
+* Function Name: task_uart
+********************************************************************************
+* Summary:
+*  Sends the sensor values over UART every UART_DUMP_FRAMES frames. Only as
+*  much as fits into the TX FIFO is written per run, so the dump never blocks
+*  the loop and fills the idle time between frames instead.
+*
+*******************************************************************************/
+static void task_uart(void)
+{
+	if(uart_pos >= uart_len)
+	{
+		if(uart_line >= UART_LINE_IDLE)
+		{
+			uart_frames = 0u;
+			uart_line = 0u;
+//			Cy_GPIO_Inv(USER_LED_PORT, USER_LED_PIN);
+		}
+
+		// In case you want to access the sensor values over UART, you can also use printf
+		if(uart_line < NUM_OF_SENSORS)
+		{
+			uart_len = (uint32_t)sprintf(uart_buffer, "RAWcount_[%lu] content: %u | Diffcount_[%lu] content: %u\r\n",
+					uart_line, capsense_data.field.rawcount[uart_line], uart_line, capsense_data.field.diffcount[uart_line]);
+		}
+		else
+		{
+			/* Send separator line */
+			uart_len = (uint32_t)sprintf(uart_buffer, "---\r\n");
+		}
+		uart_line++;
+		uart_pos = 0u;
+	}
+
+	uart_pos += Cy_SCB_UART_PutArray(UART_HW, &uart_buffer[uart_pos], uart_len - uart_pos);
+}
+#endif
+
+/* Main loop tasks, highest priority first (see hub_sched.h). Scan processing
+ * always comes first, diagnostics and UART output fill the remaining time.
+ */
+static hub_task_t tasks[] =
+{
+	{ .run = task_recover, .ready = recover_ready, .budget_us = 0u },		/* recalibrates without a cache */
+	{ .run = task_tune,    .ready = tune_ready,    .budget_us = 0u },		/* recalibrates, flash writes */
+	{ .run = task_frame,   .ready = frame_ready,   .budget_us = 2000u },
+	{ .run = task_command, .ready = command_ready, .budget_us = 0u },		/* flash writes take milliseconds */
+	{ .run = task_bist,    .ready = bist_ready,    .budget_us = 5000u },
+	{ .run = task_trigger, .ready = trigger_ready, .budget_us = 200u },
+#if defined(UART_HW)
+	{ .run = task_uart,    .ready = uart_ready,    .budget_us = 200u },
+#endif
+	{ .run = task_rec,     .ready = rec_ready,     .budget_us = 0u },		/* flash row write */
+};
+
+#define TASK_COUNT	(sizeof(tasks) / sizeof(tasks[0]))
 
 int main(void)
 {
     cy_rslt_t result;
-    uint32_t cnt = 0;
-	char uart_buffer[200];
+
+    /* From here on a hang ends in a watchdog reset */
+    hub_wdt_enable();
+
     /* Initialize the device and board peripherals */
     result = cybsp_init() ;
     if (result != CY_RSLT_SUCCESS)
     {
-
+        /* Running with a half-configured board would only hide the fault,
+         * wait for the watchdog reset to try again
+         */
+        while(1);
     }
 
 	/* Enable global interrupts */
 	__enable_irq();
 
+	/* Time base of the latency and boot measurements. It starts only now,
+	 * with the CPU clock cybsp_init() selected, so stats.boot_us leaves out
+	 * the ROM boot, the startup code and the clock and board init.
+	 */
+	hub_time_init();
+
+	/* Invalid or missing settings leave the generated configuration in place */
+	(void)hub_settings_load();
+
     cy_capsense_status_t status = CY_CAPSENSE_STATUS_SUCCESS;
+    cy_capsense_status_t capsense_status;
 
+#if defined(UART_HW)
     Cy_SCB_UART_Init(UART_HW, &UART_config, NULL);
     Cy_SCB_UART_Enable(UART_HW);
+#endif
 //    cy_retarget_io_init(UART_HW);
 	
 //    printf("Started");
 
 
-	/* CAPSENSE interrupt configuration MSC 0 */
-	const cy_stc_sysint_t capsense_msc0_interrupt_config =
-	{
-		.intrSrc = CY_MSCLP0_LP_IRQ,
-		.intrPriority = 0x03,
-	};
-
-	/* Capture the MSC HW block and initialize it to the default state. */
-	status = Cy_CapSense_Init(&cy_capsense_context);
-
-	if (CY_CAPSENSE_STATUS_SUCCESS == status)
-	{
-		/* Initialize CAPSENSE interrupt for MSC 0 */
-		Cy_SysInt_Init(&capsense_msc0_interrupt_config, capsense_msc0_isr);
-		NVIC_ClearPendingIRQ(capsense_msc0_interrupt_config.intrSrc);
-		NVIC_EnableIRQ(capsense_msc0_interrupt_config.intrSrc);
-
-		/* Initialize the CAPSENSE firmware modules. */
-		status = Cy_CapSense_Enable(&cy_capsense_context);
-	}
+	capsense_status = capsense_start(false);
 
 
 	/* EZI2C interrupt configuration structure */
 	const cy_stc_sysint_t ezi2c_intr_config =
 	{
 		.intrSrc = EZI2C_IRQ,
-		.intrPriority = 0x03,
+		.intrPriority = HUB_IRQ_PRIO_EZI2C,
 	};
 
-	/* Initialize the EzI2C firmware module */
-	status = Cy_SCB_EZI2C_Init(EZI2C_HW, &EZI2C_config, &ezi2c_context);
+	/* Initialize the EzI2C firmware module. The register map is larger than an
+	 * 8-bit sub-address can reach, so both buffers use 16-bit sub-addresses.
+	 * The CAPSENSE Tuner has to be set to the same sub-address size.
+	 */
+	ezi2c_config = EZI2C_config;
+	ezi2c_config.subAddrSize = CY_SCB_EZI2C_SUB_ADDR16_BITS;
+	ezi2c_select_address(&ezi2c_config);
+	status = Cy_SCB_EZI2C_Init(EZI2C_HW, &ezi2c_config, &ezi2c_context);
 
 	if(status != CY_SCB_EZI2C_SUCCESS)
 	{
+		/* Reset by the watchdog */
 		while(1);
 	}
 
@@ -164,71 +960,65 @@ int main(void)
 	 * master on primary slave address interface. Any I2C host tools such as
 	 * the Tuner or the Bridge Control Panel can read this buffer but you can
 	 * connect only one tool at a time.
-	 * Address of this Buffer is 0x08
+	 * Address of this Buffer is 0x08 (moved by straps or the stored address)
 	 */
+#if HUB_TUNER_ENABLE
 	Cy_SCB_EZI2C_SetBuffer1(EZI2C_HW, (uint8_t *)&cy_capsense_tuner,
 							sizeof(cy_capsense_tuner), sizeof(cy_capsense_tuner),
 							&ezi2c_context);
+#endif
     
-    /* Set up the secondary buffer for our custom data structure
+    /* Set up the secondary buffer for our register map
      * so it can be read by another MCU via I2C
-     * Address of this Buffer is 0x09
-     * Can be accessed with a normal I2C read command
+     * Address of this Buffer is 0x09 (moved by straps or the stored address)
+     * Can be accessed with a normal I2C read command using a 16-bit
+     * sub-address, only the control window at the start is writable
+     * Without the Tuner interface the map is the only buffer, on the same address
      */
-    Cy_SCB_EZI2C_SetBuffer2(EZI2C_HW, (uint8_t *)&capsense_data,
-                            sizeof(capsense_data), sizeof(capsense_data),
-                            &ezi2c_context);
+    regmap_init();
+    hub_sync_init(&capsense_data.ctrl);
+    hub_bist_init(&capsense_data);
+    hub_scan_init(&capsense_data);
+    hub_rate_init();
+    hub_filter_init(&capsense_data);
+    hub_hop_init(&capsense_data);
+    hub_xtalk_init(&capsense_data);
+    hub_bsln_init(&capsense_data);
+    hub_cal_init(&capsense_data, capsense_status);
+    hub_rec_init(&capsense_data);
+    hub_boot_init(&capsense_data);
+    hub_spi_init(&capsense_data);
+    hub_irq_init(&capsense_data);
+    hub_wdt_init(&capsense_data);
+    hub_tune_init(&capsense_data);
+    hub_noise_init(&capsense_data);
+    hub_slope_init(&capsense_data);
+    hub_trace_init(&capsense_data);
+    (void)hub_rec_configure(0u != (hub_settings.recorder & 0x80u),
+                            (0u != (hub_settings.recorder & 0x80u)) ? (hub_settings.recorder & 0x0Fu) : HUB_REC_SHIFT);
+    if(!hub_scan_set_mask(hub_settings.sensor_mask))
+    {
+        /* A stored mask without any existing sensor would never finish a frame */
+        (void)hub_scan_set_mask(HUB_SENSOR_MASK_ALL);
+    }
+    regmap_expose(sizeof(capsense_data.ctrl));
 
     // Enable the I2C
 	Cy_SCB_EZI2C_Enable(EZI2C_HW);
 
 
 
-    /* Start the first scan */
-	Cy_CapSense_ScanAllSlots(&cy_capsense_context);
+    /* Start the first scan (the hub boots in free-run mode) */
+	scan_running = scan_start();
+
+	hub_sched_init(tasks, TASK_COUNT);
 
 	for (;;)
 	{
-		if(CY_CAPSENSE_NOT_BUSY == Cy_CapSense_IsBusy(&cy_capsense_context))
+		if(!hub_sched_step())
 		{
-			/* Process all widgets */
-			Cy_CapSense_ProcessAllWidgets(&cy_capsense_context);
-
-            /* Store raw counts and diff counts for each sensor */
-            for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
-            {
-                /* Get raw counts and diff counts from all sensors from the sensor context */
-                capsense_data.rawcount[i] = cy_capsense_tuner.sensorContext[i].raw;
-                capsense_data.diffcount[i] = cy_capsense_tuner.sensorContext[i].diff;
-                capsense_data.baseline[i] = cy_capsense_tuner.sensorContext[i].bsln;
-                //printf("RAWcount_[%d] content: %u | Diffcount_[%d] content: %u \r\n", i, capsense_data.rawcount[i], i, capsense_data.diffcount[i]);
-            }
-
-			/* Establishes synchronized communication with the CAPSENSE Tuner tool */
-			Cy_CapSense_RunTuner(&cy_capsense_context);
-
-			/* Start the next scan */
-			Cy_CapSense_ScanAllSlots(&cy_capsense_context);
-
-			cnt++;
-			if(cnt >= 100)
-			{
-				cnt = 0;
-//				Cy_GPIO_Inv(USER_LED_PORT, USER_LED_PIN);
-
-				// In case you want to access the sensor values over UART, you can also use printf
-                for(uint32_t i = 0; i < NUM_OF_SENSORS; i++)
-                {
-                    sprintf(uart_buffer, "RAWcount_[%lu] content: %u | Diffcount_[%lu] content: %u\r\n", 
-                            i, capsense_data.rawcount[i], i, capsense_data.diffcount[i]);
-                    Cy_SCB_UART_PutString(UART_HW, uart_buffer);
-                }
-
-                /* Send separator line */
-                Cy_SCB_UART_PutString(UART_HW, "---\r\n");
-			
-			}
+			hub_wdt_feed();
+			hub_sched_idle();
 		}
 	}
 }
-
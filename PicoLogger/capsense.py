@@ -10,6 +10,20 @@ Features:
 - Automatic sensor detection and connection retries
 - Customizable sensor configuration
 - Data output in various formats (raw, structured dict, CSV)
+- Random access to single sensors or fields through the hub register map
+
+Register map (16-bit sub-addresses, see Code/*/hub_regmap.h):
+- 0x0000 control window (RW)
+- 0x0020 info block: magic, version, sensor count and window offsets
+- 0x0030 status block: frame sequence number, flags and mode, scan idle
+  time, trigger latency, sync epoch
+- 0x0040 stats block: frame period and rate, processing and Tuner time,
+  main loop task overruns
+- field_base: rawcount[N], diffcount[N], baseline[N]
+- sensor_base: {raw, diff, bsln} per sensor
+
+Optional SPI frame stream (SpiStreamReader): every frame with its sequence
+number and field window, for full-rate recordings.
 
 Hardware connections:
 - Connect GND to GND
@@ -23,14 +37,125 @@ Requirements:
 """
 
 
+import os
 import struct
 import time
-from machine import Pin, I2C
+from machine import Pin, I2C, SPI
+
+# Register map constants (must match hub_regmap.h)
+REG_CTRL = 0x0000
+REG_INFO = 0x0020
+REG_STATUS = 0x0030
+REG_STATS = 0x0040
+REG_FIELD = 0x00C0
+REG_CTRL_MODE = REG_CTRL + 0
+REG_CTRL_TRIGGER = REG_CTRL + 1
+REG_CTRL_EPOCH = REG_CTRL + 4
+REG_CTRL_CMD = REG_CTRL + 8
+REGMAP_MAGIC = 0x5348
+INFO_FORMAT = '<HBBHHHHHBB'
+INFO_SIZE = 16
+STATUS_FORMAT = '<IHHII'
+STATUS_FORMAT_V18 = '<IHBBII'  # maps 18..25: mode byte, no idle time
+STATUS_SIZE = 16
+STATS_FORMAT = '<IHHHBBHBB8BIHHIBBHIIHHBBHHBBIIBBHHHHHHBBIBBBBHHBB3HBBHHHBBHI'
+STATS_SIZE = 128
+TUNER_STATES = {0: 'compiled out', 1: 'detached', 2: 'attached'}
+SUBADDR_SIZE = 16  # bits
+HUB_DATA_ADDRESSES = range(0x09, 0x18, 2)  # data addresses the strap pins select
+
+MODE_FREE_RUN = 0
+MODE_ONE_SHOT = 1
+MODE_SYNC = 2
+CMD_RESET = 0x01
+CMD_SAVE_SETTINGS = 0x02
+CMD_SET_I2C_ADDR = 0x10
+CMD_SET_BIST = 0x11
+CMD_SET_SENSOR_MASK = 0x12
+CMD_SET_SCAN_RATE = 0x13
+CMD_SET_ADAPTIVE = 0x14
+CMD_SET_FILTER = 0x15
+CMD_SET_XTALK = 0x16
+CMD_BSLN_FREEZE = 0x17
+CMD_BSLN_RESET = 0x18
+CMD_BSLN_CONVERGE = 0x19
+CMD_REC_CONFIG = 0x1A
+CMD_REC_READ = 0x1B
+REC_MAGIC = 0x4252
+REC_ROW_FORMAT = '<HHIBBBB'  # magic, counter, seq, shift, count, sensors, reserved
+REC_ROW_SIZE = 128
+CMD_BOOT_BEGIN = 0x1C
+CMD_BOOT_WRITE = 0x1D
+CMD_BOOT_COMMIT = 0x1E
+CMD_BOOT_ABORT = 0x26
+BOOT_IDLE = 0
+BOOT_RECEIVING = 1
+CMD_SET_POWER = 0x1F
+CMD_CAL_SAVE = 0x20
+POWER_CONTINUOUS = 0
+POWER_GATED = 1
+CAL_STATES = {0: 'none', 1: 'stored', 2: 'restored'}
+RESET_CAUSES = {0: 'power', 1: 'watchdog', 2: 'software'}
+CMD_TUNE = 0x21
+TUNE_STATES = {0: 'idle', 1: 'running', 2: 'done', 3: 'failed'}
+CMD_NOISE = 0x22
+CMD_NOISE_SAVE = 0x23
+NOISE_STATES = {0: 'idle', 1: 'running', 2: 'done', 3: 'stored'}
+CMD_TRACE = 0x24
+CMD_TRACE_READ = 0x25
+TRACE_OFF = 0
+TRACE_RUNNING = 1
+TRACE_ARMED = 2
+TRACE_STATES = {0: 'off', 1: 'running', 2: 'armed', 3: 'triggered'}
+TRACE_CHUNK = 32  # events per CMD_TRACE_READ
+TRACE_RAW_HEADER = '<4sBBHI'  # "HTRC", CPU MHz, reserved, depth, events recorded (Tools/hub_trace.cpp)
+SPI_MAGIC = 0x5346
+SPI_HEADER_FORMAT = '<HBBIHHBx'  # magic, type, num_sensors, seq, flags, lost, mode
+SPI_IDLE = 0
+SPI_FRAME = 1
+XTALK_ONE = 16384  # 1.0 in the Q14 cross-talk coefficients
+RESULT_NAMES = {0: 'OK', 1: 'BAD_CMD', 2: 'BAD_ARG', 3: 'FAILED'}
+
+STATUS_DONE = 0x01
+STATUS_SYNC_MISSED = 0x02
+STATUS_BSLN_FROZEN = 0x04
+STATUS_BSLN_RESET = 0x08
+STATUS_BSLN_CONVERGING = 0x10
+STATUS_READY = 0x20
+STATUS_INIT_OK = 0x40
+STATUS_CAL_OK = 0x80
+STATUS_BSLN_CONVERGED = 0x100
+STATUS_SCAN_ERROR = 0x200
+STATUS_OVERFLOW = 0x400
+STATUS_FRAME_VALID = 0x8000
+STATUS_MAP_VERSION = 18  # first register map with the frame validity flags
+STATUS_MODE_SHIFT = 12  # mode of the frame in bits 13..12 of the flags
+STATUS_MODE_MASK = 0x3000
+IDLE_MAP_VERSION = 26  # first register map with the mode in the flags and idle_ms in the status block
+
+SENSOR_CP_OFFSET = 6  # cp and bist follow raw, diff, bsln in a sensor window
+SENSOR_SEQ_OFFSET = 10  # low half of the frame sequence number of the last update
+SENSOR_REJECTS_OFFSET = 12  # spikes rejected by the filter
+SENSOR_HOP_OFFSET = 14  # frequency channel rejected in the last scan, 0 = none
+HOP_MAP_VERSION = 22  # first register map with the hop field in the sensor windows
+SENSOR_NOISE_OFFSET = 16  # noise_pp, noise_rms, snr of the noise measurement
+SENSOR_SLOPE_OFFSET = 22  # rate of change of diff in counts per minute, signed
+SLOPE_MAP_VERSION = 24  # first register map with the slope field in the sensor windows
+
+FILTER_OFF = 0
+FILTER_MEDIAN3 = 1
+FILTER_MEDIAN5 = 2
+FILTER_HAMPEL = 3
+FILTER_NAMES = {0: 'off', 1: 'median3', 2: 'median5', 3: 'hampel'}
+BIST_TESTED = 0x0001
+BIST_SHORT = 0x0002
+BIST_CP_FAIL = 0x0004
+BIST_CRC_FAIL = 0x0008
 
 # Default configuration - easily modifiable
 DEFAULT_CONFIG = {
     'sensor_address': 0x09,
-    'register': 0x00,
+    'register': REG_FIELD,
     'num_sensors': 3,
     'values_per_sensor': 3,  # rawcount, diffcount, baseline
     'value_size': 2,  # 2 bytes per value (uint16)
@@ -69,9 +194,12 @@ class CapsenseReader:
             print("Created new I2C instance")
             
         self.is_available = False
+        self.info = None
         
         # Check sensor availability
         self._check_sensor_availability()
+        if self.is_available:
+            self._read_info()
     
     def _check_sensor_availability(self, max_attempts=3, delay=0.5):
         """Check if sensor is available, retry a few times"""
@@ -95,17 +223,50 @@ class CapsenseReader:
         if not self.is_available:
             print("Capsense sensor not available after retries.")
     
+    def _read_mem(self, subaddr, nbytes):
+        """Read nbytes from the hub register map at a 16-bit sub-address"""
+        return self.i2c.readfrom_mem(self.config['sensor_address'], subaddr,
+                                     nbytes, addrsize=SUBADDR_SIZE)
+    
+    def _write_mem(self, subaddr, data):
+        """Write bytes into the control window of the hub register map"""
+        self.i2c.writeto_mem(self.config['sensor_address'], subaddr, data,
+                             addrsize=SUBADDR_SIZE)
+    
+    def _read_info(self):
+        """Read the info block and take the window layout from the hub"""
+        try:
+            fields = struct.unpack(INFO_FORMAT, self._read_mem(REG_INFO, INFO_SIZE))
+        except Exception as e:
+            print(f"Reading register map info failed: {e}")
+            return
+        if fields[0] != REGMAP_MAGIC:
+            print(f"Unexpected register map magic 0x{fields[0]:04X}, using defaults")
+            return
+        self.info = {
+            'version': fields[1],
+            'num_sensors': fields[2],
+            'map_size': fields[3],
+            'field_base': fields[4],
+            'field_stride': fields[5],
+            'sensor_base': fields[6],
+            'sensor_stride': fields[7],
+            'i2c_addr': fields[8],
+        }
+        if fields[2] != self.config['num_sensors']:
+            print(f"Hub reports {fields[2]} sensors, config expects {self.config['num_sensors']}")
+        self.config['register'] = self.info['field_base']
+    
     def read_raw_data(self):
-        """Read raw bytes from sensor"""
+        """Read raw bytes from sensor, once the hub publishes a valid frame"""
         if not self.is_available:
             raise Exception("Sensor not available")
         
+        if self.info and self.info['version'] >= STATUS_MAP_VERSION:
+            self.wait_valid()
+        
         try:
-            data = self.i2c.readfrom_mem(
-                self.config['sensor_address'], 
-                self.config['register'], 
-                self.buffer_size
-            )
+            data = self._read_mem(self.config['register'], self.buffer_size)
             
             if len(data) != self.buffer_size:
                 raise ValueError(f"Expected {self.buffer_size} bytes, got {len(data)}")
@@ -166,6 +327,699 @@ class CapsenseReader:
         
         return sensor_data
     
+    def read_status(self):
+        """
+        Read the frame status block
+        
+        Returns:
+            dict: seq, flags (STATUS_*), mode, latency_us and epoch of the
+                  last published frame, and idle_ms, the idle time of the
+                  adaptive scan rate before the current scan (0 = full
+                  rate, None on hubs before map version 26)
+        """
+        data = self._read_mem(REG_STATUS, STATUS_SIZE)
+        if self.info and self.info['version'] < IDLE_MAP_VERSION:
+            seq, flags, mode, _, latency_us, epoch = struct.unpack(STATUS_FORMAT_V18, data)
+            idle_ms = None
+        else:
+            seq, flags, idle_ms, latency_us, epoch = struct.unpack(STATUS_FORMAT, data)
+            mode = (flags & STATUS_MODE_MASK) >> STATUS_MODE_SHIFT
+        return {'seq': seq, 'flags': flags, 'mode': mode, 'idle_ms': idle_ms,
+                'latency_us': latency_us, 'epoch': epoch}
+    
+    def read_stats(self):
+        """
+        Read the firmware statistics block
+        
+        Returns:
+            dict with the keys
+                frame_us: frame period in µs
+                frame_rate: frames published during the last full second
+                process_us: processing, publishing and Tuner time of the
+                    last frame in µs
+                tuner_us: Tuner time of the last frame in µs
+                tuner: Tuner state (TUNER_STATES)
+                overruns: main loop task runs over their budget, all tasks
+                task_overruns: list of overruns per task in priority order
+                health: self-test bitmap, bit i set = sensor i passed
+                bist_passes: completed self-test passes, 0 = no result yet
+                sensor_mask: sensor enable mask, bit i = sensor i
+                active_sensors: number of sensors scanned per frame
+                filter: spike filter (FILTER_NAMES)
+                rejects: spikes the filter rejected, all sensors
+                xtalk_cycles: CPU cycles of the cross-talk compensation in
+                    the last frame
+                rec_base: sub-address of the recorder's record window
+                rec_rows: flash rows holding records
+                recording: True while the recorder is on
+                rec_frames: frames per record
+                boot_rows: largest update image in flash rows, 0 = no
+                    updater
+                boot_state: firmware updater state (BOOT_*)
+                spi_frame: bytes per SPI stream frame, 0 = no SPI stream
+                spi_lost: frames the SPI stream dropped
+                boot_us: end of the hub's clock and board init to the
+                    first ready frame in µs (without ROM boot and startup),
+                    0 = not ready yet
+                power_gated: True in power-gated mode
+                cal_state: calibration cache state (CAL_STATES)
+                i2c_wait_us: worst EZI2C interrupt waiting time in µs
+                i2c_isr_us: worst EZI2C handler time in µs
+                i2c_stretch_us: worst measured clock stretch in µs (waiting
+                    plus handler, a partial measurement, not a bound)
+                i2c_delayed: EZI2C interrupts that had to wait
+                stalls: scan stalls recovered by re-initializing CAPSENSE
+                reset_cause: cause of the last reset (RESET_CAUSES)
+                recover_us: outage of the last stall in µs
+                tune_state: scan-parameter optimizer state (TUNE_STATES)
+                tune_widget: widget under test
+                tune_step: setting under test
+                tune_snr: lowest SNR of the chosen settings
+                tune_noise: peak-to-peak noise of the last measured setting
+                    in raw counts
+                hop_channels: frequency channels, 1 = no frequency hopping
+                hop_rejects: list of rejections per frequency channel
+                noise_state: noise measurement state (NOISE_STATES)
+                noise_frames: frames per sensor of the noise measurement
+                noise_signal: signal of the noise measurement in raw
+                    counts, 0 = finger thresholds
+                trace_state: event trace state (TRACE_STATES)
+                trace_mhz: CPU clock in MHz, the trace time base
+                trace_depth: events in the trace ring, 0 = compiled out
+                trace_count: events recorded since the trace was started
+        """
+        data = self._read_mem(REG_STATS, STATS_SIZE)
+        fields = struct.unpack(STATS_FORMAT, data[:struct.calcsize(STATS_FORMAT)])
+        task_count = fields[7]
+        return {'frame_us': fields[0], 'frame_rate': fields[1],
+                'process_us': fields[2], 'tuner_us': fields[3],
+                'tuner': TUNER_STATES.get(fields[4], fields[4]),
+                'overruns': fields[6],
+                'task_overruns': list(fields[9:9 + min(task_count, 8)]),
+                'health': fields[17], 'bist_passes': fields[18],
+                'sensor_mask': fields[20], 'active_sensors': fields[21],
+                'filter': FILTER_NAMES.get(fields[22], fields[22]), 'rejects': fields[24],
+                'xtalk_cycles': fields[25], 'rec_base': fields[26], 'rec_rows': fields[27],
+                'recording': fields[28] == 1, 'rec_frames': 1 << fields[29],
+                'boot_rows': fields[31], 'boot_state': fields[32],
+                'spi_frame': fields[30], 'spi_lost': fields[34],
+                'boot_us': fields[35], 'power_gated': fields[36] == POWER_GATED,
+                'cal_state': CAL_STATES.get(fields[37], fields[37]),
+                'i2c_wait_us': fields[39], 'i2c_isr_us': fields[40],
+                'i2c_stretch_us': fields[41], 'i2c_delayed': fields[42],
+                'stalls': fields[43],
+                'reset_cause': RESET_CAUSES.get(fields[44], fields[44]),
+                'recover_us': fields[46],
+                'tune_state': TUNE_STATES.get(fields[47], fields[47]),
+                'tune_widget': fields[48], 'tune_step': fields[49],
+                'tune_snr': fields[51] / 10, 'tune_noise': fields[52],
+                'hop_channels': fields[53], 'hop_rejects': list(fields[55:58]),
+                'noise_state': NOISE_STATES.get(fields[58], fields[58]),
+                'noise_frames': fields[60], 'noise_signal': fields[61],
+                'trace_state': TRACE_STATES.get(fields[63], fields[63]),
+                'trace_mhz': fields[64], 'trace_depth': fields[65], 'trace_count': fields[66]}
+    
+    def set_mode(self, mode):
+        """Select MODE_FREE_RUN, MODE_ONE_SHOT or MODE_SYNC scanning"""
+        if not self.is_available:
+            raise Exception("Sensor not available")
+        self._write_mem(REG_CTRL_MODE, bytes([mode]))
+    
+    def command(self, cmd, args=b'', timeout_ms=500):
+        """
+        Run a hub command and wait for its result
+        
+        Args:
+            cmd (int): One of the CMD_* opcodes
+            args (bytes): Command arguments
+            timeout_ms (int): Give up after this time (flash writes take a while)
+        """
+        if not self.is_available:
+            raise Exception("Sensor not available")
+        self._write_mem(REG_CTRL_CMD, bytes([cmd, 0]) + bytes(args))
+        if cmd == CMD_RESET:
+            return
+        start = time.ticks_ms()
+        while time.ticks_diff(time.ticks_ms(), start) < timeout_ms:
+            pending, result = self._read_mem(REG_CTRL_CMD, 2)
+            if pending == 0:
+                if result != 0:
+                    raise Exception(f"Command 0x{cmd:02X} failed: {RESULT_NAMES.get(result, result)}")
+                return
+            time.sleep_ms(2)
+        raise Exception(f"Command 0x{cmd:02X} timed out")
+    
+    def set_i2c_address(self, tuner_address, reset=True):
+        """
+        Store a new address pair in the hub's flash (data address = tuner_address + 1)
+        
+        Args:
+            tuner_address (int): New tuner address, 0 returns to strap pins / default
+            reset (bool): Reset the hub so the new address takes effect
+        """
+        self.command(CMD_SET_I2C_ADDR, bytes([tuner_address]))
+        self.command(CMD_SAVE_SETTINGS)
+        if reset:
+            self.command(CMD_RESET)
+            if tuner_address:
+                self.config['sensor_address'] = tuner_address + 1
+    
+    @staticmethod
+    def discover(i2c, addresses=HUB_DATA_ADDRESSES):
+        """
+        Find all Sensor Hubs on a bus
+        
+        A hub has the register map magic in the info block of its data
+        address, which tells it apart from other devices (and from its own
+        Tuner address, if the firmware has one). Only the given addresses
+        are probed: the probe writes a 16-bit sub-address, which a device
+        with 8-bit register addresses (e.g. an EEPROM) takes as a data write.
+        
+        Args:
+            i2c: I2C instance of the bus to scan
+            addresses: Candidate data addresses, default the strap pin range
+                0x09..0x17; add addresses set with set_i2c_address()
+        
+        Returns:
+            list: Data addresses of all hubs found
+        """
+        devices = i2c.scan()
+        hubs = []
+        for addr in devices:
+            if addr not in addresses:
+                continue
+            try:
+                magic = struct.unpack('<H', i2c.readfrom_mem(addr, REG_INFO, 2,
+                                                            addrsize=SUBADDR_SIZE))[0]
+            except Exception:
+                continue
+            if magic == REGMAP_MAGIC:
+                hubs.append(addr)
+        return hubs
+    
+    def set_epoch(self, epoch):
+        """Set the epoch the next sync edge will be stamped with"""
+        if not self.is_available:
+            raise Exception("Sensor not available")
+        self._write_mem(REG_CTRL_EPOCH, struct.pack('<I', epoch))
+    
+    def trigger_scan(self, timeout_ms=1000, poll_ms=2):
+        """
+        Start exactly one scan in one-shot mode and wait for its frame
+        
+        Args:
+            timeout_ms (int): Give up after this time
+            poll_ms (int): Interval between status polls
+        
+        Returns:
+            dict: Status of the new frame (seq, flags, mode, latency_us)
+        """
+        if not self.is_available:
+            raise Exception("Sensor not available")
+        
+        last_seq = self.read_status()['seq']
+        self._write_mem(REG_CTRL_TRIGGER, b'\x01')
+        start = time.ticks_ms()
+        while time.ticks_diff(time.ticks_ms(), start) < timeout_ms:
+            status = self.read_status()
+            if (status['flags'] & STATUS_DONE) and status['seq'] != last_seq:
+                return status
+            time.sleep_ms(poll_ms)
+        raise Exception("Triggered scan timed out")
+    
+    def read_sensor(self, index):
+        """
+        Read all values of a single sensor from its per-sensor window
+        
+        Args:
+            index (int): Sensor index in the hub's sensor order
+        
+        Returns:
+            dict: Value name -> value for that sensor, plus 'seq', the low
+                  16 bits of the frame sequence number of its last update,
+                  'rejects', the spikes the filter removed, 'hop', the
+                  frequency channel (1..3) the median rejected in its last
+                  scan or 0, and 'slope', the rate of change of its diff
+                  count in counts per minute
+        """
+        if not self.is_available:
+            raise Exception("Sensor not available")
+        if self.info is None:
+            raise Exception("Register map info not available")
+        if not 0 <= index < self.info['num_sensors']:
+            raise ValueError(f"Sensor index {index} out of range")
+        
+        num_values = self.config['values_per_sensor']
+        subaddr = self.info['sensor_base'] + index * self.info['sensor_stride']
+        hop = self.info['version'] >= HOP_MAP_VERSION
+        slope = self.info['version'] >= SLOPE_MAP_VERSION
+        end = SENSOR_SLOPE_OFFSET if slope else SENSOR_HOP_OFFSET if hop else SENSOR_REJECTS_OFFSET
+        data = self._read_mem(subaddr, end + 2)
+        values = dict(zip(self.config['value_names'], struct.unpack(f'<{num_values}H', data[:2 * num_values])))
+        values['seq'], values['rejects'] = struct.unpack('<HH', data[SENSOR_SEQ_OFFSET:SENSOR_REJECTS_OFFSET + 2])
+        values['hop'] = struct.unpack('<H', data[SENSOR_HOP_OFFSET:SENSOR_HOP_OFFSET + 2])[0] if hop else 0
+        values['slope'] = struct.unpack('<h', data[SENSOR_SLOPE_OFFSET:])[0] if slope else 0
+        return values
+    
+    def read_bist(self, index):
+        """
+        Read the self-test result of a single sensor
+        
+        Args:
+            index (int): Sensor index in the hub's sensor order
+        
+        Returns:
+            dict: cp_ff (electrode capacitance in fF), flags (BIST_* bits)
+                  and ok (tested without any failure)
+        """
+        if not self.is_available:
+            raise Exception("Sensor not available")
+        if self.info is None:
+            raise Exception("Register map info not available")
+        if not 0 <= index < self.info['num_sensors']:
+            raise ValueError(f"Sensor index {index} out of range")
+        
+        subaddr = self.info['sensor_base'] + index * self.info['sensor_stride'] + SENSOR_CP_OFFSET
+        cp, flags = struct.unpack('<HH', self._read_mem(subaddr, 4))
+        return {'cp_ff': cp * 10, 'flags': flags, 'ok': flags == BIST_TESTED}
+    
+    def read_noise(self, index):
+        """
+        Read the noise measurement result of a single sensor
+        
+        Args:
+            index (int): Sensor index in the hub's sensor order
+        
+        Returns:
+            dict: pp (peak-to-peak noise), rms (RMS noise) in raw counts
+                  and snr (signal / peak-to-peak noise)
+        """
+        if not self.is_available:
+            raise Exception("Sensor not available")
+        if self.info is None:
+            raise Exception("Register map info not available")
+        if not 0 <= index < self.info['num_sensors']:
+            raise ValueError(f"Sensor index {index} out of range")
+        
+        subaddr = self.info['sensor_base'] + index * self.info['sensor_stride'] + SENSOR_NOISE_OFFSET
+        pp, rms, snr = struct.unpack('<HHH', self._read_mem(subaddr, 6))
+        return {'pp': pp, 'rms': rms / 10, 'snr': snr / 10}
+    
+    def measure_noise(self, frames=0, signal=0, save=True, timeout_ms=30000, poll_ms=50):
+        """
+        Measure noise and SNR of every sensor on the hub, e.g. at the end of
+        line. The sensors must not be touched until it returns.
+        
+        Args:
+            frames (int): Frames per sensor (2..4096), 0 = firmware default
+            signal (int): Touch signal in raw counts, 0 = derived from the
+                finger thresholds
+            save (bool): Store the results in the hub's flash as board metadata
+            timeout_ms (int): Give up after this time
+        
+        Returns:
+            list: read_noise() result per sensor
+        """
+        self.command(CMD_NOISE, struct.pack('<HH', frames, signal))
+        start = time.ticks_ms()
+        while self.read_stats()['noise_state'] == 'running':
+            if time.ticks_diff(time.ticks_ms(), start) >= timeout_ms:
+                raise Exception("Noise measurement timed out")
+            time.sleep_ms(poll_ms)
+        if save:
+            self.command(CMD_NOISE_SAVE, timeout_ms=1000)
+        return [self.read_noise(i) for i in range(self.info['num_sensors'])]
+    
+    def set_bist_interval(self, frames):
+        """Run a background self-test step every `frames` frames, 0 = off"""
+        self.command(CMD_SET_BIST, struct.pack('<H', frames))
+    
+    def set_sensor_mask(self, mask, save=True):
+        """
+        Select the sensors the hub scans; disabled sensors read as zero
+        
+        Args:
+            mask (int): Bit i enables sensor i
+            save (bool): Keep the mask in the hub's flash across resets
+        """
+        self.command(CMD_SET_SENSOR_MASK, struct.pack('<I', mask))
+        if save:
+            self.command(CMD_SAVE_SETTINGS)
+    
+    def set_scan_rate(self, first_sensor, dividers):
+        """
+        Scan sensors at reduced rates, e.g. set_scan_rate(2, [8]) scans
+        sensor 2 only every 8th frame
+        
+        Args:
+            first_sensor (int): Index of the first sensor to change
+            dividers (list): Scan every d-th frame (1..255), one per sensor
+        """
+        for start in range(0, len(dividers), 20):
+            chunk = dividers[start:start + 20]
+            self.command(CMD_SET_SCAN_RATE, bytes([first_sensor + start, len(chunk)] + list(chunk)))
+    
+    def set_adaptive_rate(self, quiet_ms, max_idle_ms=128, threshold=64):
+        """
+        Let the hub slow down in free-run mode while the sensors are quiet
+        
+        Args:
+            quiet_ms (int): Quiet time before each slow-down step, 0 = always full rate
+            max_idle_ms (int): Longest idle time between two frames, up to
+                1600 ms (MSCLP wake-up timer range)
+            threshold (int): Sum of squared diff count changes per frame that counts as activity
+        """
+        self.command(CMD_SET_ADAPTIVE, struct.pack('<HHH', quiet_ms, max_idle_ms, threshold))
+    
+    def set_filter(self, mode, mask=0xFFFFFFFF):
+        """
+        Select the spike filter the hub applies to the raw counts
+        
+        Args:
+            mode (int): FILTER_OFF, FILTER_MEDIAN3, FILTER_MEDIAN5 or FILTER_HAMPEL
+            mask (int): Bit i filters sensor i
+        """
+        self.command(CMD_SET_FILTER, struct.pack('<BI', mode, mask))
+    
+    def set_crosstalk(self, matrix, save=True):
+        """
+        Load the cross-talk compensation matrix: published diff[i] is
+        sum(matrix[i][j] * diff[j])
+        
+        Args:
+            matrix (list): N rows of N floats (-2.0 .. <2.0), identity = no compensation
+            save (bool): Keep the matrix in the hub's flash across resets
+        """
+        coeffs = []
+        for row in matrix:
+            for value in row:
+                coeffs.append(max(-32768, min(32767, round(value * XTALK_ONE))))
+        for start in range(0, len(coeffs), 10):
+            chunk = coeffs[start:start + 10]
+            self.command(CMD_SET_XTALK, bytes([start, len(chunk)]) + struct.pack(f'<{len(chunk)}h', *chunk))
+        if save:
+            self.command(CMD_SAVE_SETTINGS)
+    
+    def freeze_baselines(self, freeze=True):
+        """Stop (or resume) baseline tracking, e.g. while a tank fills or drains"""
+        self.command(CMD_BSLN_FREEZE, bytes([1 if freeze else 0]))
+    
+    def reset_baselines(self):
+        """Set all baselines to the current raw counts"""
+        self.command(CMD_BSLN_RESET)
+    
+    def converge_baselines(self, frames=50):
+        """Let the baselines follow the raw counts directly for a number of frames"""
+        self.command(CMD_BSLN_CONVERGE, struct.pack('<H', frames))
+    
+    def set_power_gated(self, gated=True):
+        """
+        Prepare the hub for being powered only around each sample. Call it
+        while the sensors are at rest: it stores the current calibration and
+        baselines, which power-gated boots start from. Takes effect at the
+        next power-on.
+        """
+        if gated:
+            self.command(CMD_CAL_SAVE, timeout_ms=1000)
+        self.command(CMD_SET_POWER, bytes([POWER_GATED if gated else POWER_CONTINUOUS]))
+        self.command(CMD_SAVE_SETTINGS)
+    
+    def optimize_scan(self, snr=5.0, signal=0, timeout_ms=120000, poll_ms=100):
+        """
+        Let the hub find the fastest scan parameters that still reach an SNR
+        target, and store them in its flash. The sensors must not be touched
+        until it returns.
+        
+        Args:
+            snr (float): SNR target, 0 returns to the generated parameters
+            signal (int): Touch signal in raw counts at the current
+                parameters, 0 = derived from the finger thresholds
+            timeout_ms (int): Give up after this time
+        
+        Returns:
+            dict: The statistics block at the end of the sweep
+        """
+        self.command(CMD_TUNE, struct.pack('<HH', int(snr * 10), signal))
+        if snr == 0:
+            self.command(CMD_SAVE_SETTINGS)
+            return self.read_stats()
+        start = time.ticks_ms()
+        while time.ticks_diff(time.ticks_ms(), start) < timeout_ms:
+            time.sleep_ms(poll_ms)
+            stats = self.read_stats()
+            if stats['tune_state'] == 'done':
+                return stats
+            if stats['tune_state'] == 'failed':
+                raise Exception(f"SNR {snr} not reached on every widget, the others keep their result")
+        raise Exception("Scan optimization timed out")
+    
+    def wait_ready(self, timeout_ms=2000, poll_ms=2):
+        """
+        Wait until the hub answers and publishes valid frames, e.g. right
+        after switching on its power
+        
+        Returns:
+            int: Milliseconds from the call until the hub was ready
+        """
+        start = time.ticks_ms()
+        while time.ticks_diff(time.ticks_ms(), start) < timeout_ms:
+            try:
+                if self.read_status()['flags'] & STATUS_READY:
+                    self.is_available = True
+                    return time.ticks_diff(time.ticks_ms(), start)
+            except OSError:
+                pass  # not answering on the bus yet
+            time.sleep_ms(poll_ms)
+        raise Exception("Hub not ready")
+    
+    def wait_valid(self, timeout_ms=1000, poll_ms=2):
+        """
+        Wait until the last published frame is valid: CAPSENSE initialized
+        and calibrated, baselines converged, no scan error and no overflow
+        
+        Returns:
+            int: Status flags of the valid frame
+        """
+        start = time.ticks_ms()
+        while True:
+            status = self.read_status()
+            flags = status['flags']
+            if flags & STATUS_FRAME_VALID:
+                return flags
+            if status['seq'] and not flags & STATUS_INIT_OK:
+                raise Exception(f"Hub CAPSENSE init failed (flags 0x{flags:04X})")
+            if time.ticks_diff(time.ticks_ms(), start) >= timeout_ms:
+                raise Exception(f"No valid frame (flags 0x{flags:04X})")
+            time.sleep_ms(poll_ms)
+    
+    def measure_i2c_response(self, seconds=300, poll_ms=1):
+        """
+        Measure the worst I2C response times of the hub under full scan load
+        
+        Resets the hub so the worst cases start from zero, lets it scan in
+        free-run mode and reads every sensor as fast as poll_ms allows.
+        
+        Args:
+            seconds (int): Measurement time
+            poll_ms (int): Pause between two reads
+        
+        Returns:
+            dict: i2c_wait_us, i2c_isr_us, i2c_stretch_us, i2c_delayed and
+                  frame_rate of read_stats() at the end, and reads, the
+                  number of sensor reads made
+        """
+        self.command(CMD_RESET)
+        time.sleep_ms(100)
+        self.wait_ready()
+        self.set_mode(MODE_FREE_RUN)
+        reads = 0
+        start = time.ticks_ms()
+        while time.ticks_diff(time.ticks_ms(), start) < seconds * 1000:
+            self.read_sensor_data()
+            reads += 1
+            time.sleep_ms(poll_ms)
+        stats = self.read_stats()
+        result = {key: stats[key] for key in
+                  ('i2c_wait_us', 'i2c_isr_us', 'i2c_stretch_us', 'i2c_delayed', 'frame_rate')}
+        result['reads'] = reads
+        return result
+    
+    def set_recorder(self, enable=True, frames_log2=7, save=True):
+        """
+        Start or stop the hub's black-box recorder
+        
+        Args:
+            enable (bool): Record into the hub's flash
+            frames_log2 (int): Average 2**frames_log2 frames per record (0..15)
+            save (bool): Keep recording after a hub reset
+        """
+        self.command(CMD_REC_CONFIG, bytes([1 if enable else 0, frames_log2]))
+        if save:
+            self.command(CMD_SAVE_SETTINGS)
+    
+    def read_records(self, after_seq=None):
+        """
+        Read all records stored in the hub's flash, oldest first
+        
+        Args:
+            after_seq (int): Only return records newer than this frame sequence number
+        
+        Returns:
+            list: (seq, raw list, diff list) per record; seq is the last frame of the record
+        """
+        stats = self.read_stats()
+        records = []
+        for index in range(stats['rec_rows']):
+            self.command(CMD_REC_READ, struct.pack('<H', index))
+            row = self._read_mem(stats['rec_base'] + 4, REC_ROW_SIZE)
+            magic, _, seq, shift, count, sensors, _ = struct.unpack(REC_ROW_FORMAT, row[:12])
+            if magic != REC_MAGIC:
+                continue
+            values = struct.unpack(f'<{2 * sensors * count}H', row[12:12 + 4 * sensors * count])
+            for k in range(count):
+                record_seq = seq + (k << shift)
+                if after_seq is not None and record_seq <= after_seq:
+                    continue
+                chunk = values[2 * sensors * k:2 * sensors * (k + 1)]
+                records.append((record_seq, list(chunk[0::2]), list(chunk[1::2])))
+        return records
+    
+    def start_trace(self, late_us=0):
+        """
+        Clear the hub's event trace and start recording
+        
+        Args:
+            late_us (int): Stop at the first frame period above this,
+                0 = record until read_trace()
+        """
+        state = TRACE_ARMED if late_us else TRACE_RUNNING
+        self.command(CMD_TRACE, struct.pack('<BI', state, late_us))
+    
+    def read_trace(self):
+        """
+        Stop the event trace and read its events, oldest first
+        
+        Returns:
+            list: raw 32-bit events (code << 24 | SysTick counter), see
+                  Code/*/hub_trace.h; save_trace() writes them for
+                  Tools/hub_trace
+        """
+        stats = self.read_stats()
+        if stats['trace_depth'] == 0:
+            raise Exception("Hub firmware has no event trace")
+        if stats['trace_state'] in ('running', 'armed'):
+            self.command(CMD_TRACE, bytes([TRACE_OFF]))
+            stats = self.read_stats()
+        
+        valid = min(stats['trace_count'], stats['trace_depth'])
+        events = []
+        for chunk in range((valid + TRACE_CHUNK - 1) // TRACE_CHUNK):
+            self.command(CMD_TRACE_READ, struct.pack('<H', chunk))
+            events.extend(struct.unpack(f'<{TRACE_CHUNK}I',
+                                        self._read_mem(stats['rec_base'] + 4, 4 * TRACE_CHUNK)))
+        return events[:valid]
+    
+    def save_trace(self, path):
+        """Read the event trace into a raw trace file for Tools/hub_trace convert"""
+        events = self.read_trace()
+        stats = self.read_stats()
+        with open(path, 'wb') as f:
+            f.write(struct.pack(TRACE_RAW_HEADER, b'HTRC', stats['trace_mhz'], 0,
+                                stats['trace_depth'], stats['trace_count']))
+            for event in events:
+                f.write(struct.pack('<I', event))
+        return len(events)
+    
+    def update_firmware(self, path, retries=3, timeout_ms=15000):
+        """
+        Install a signed update image (made by Tools/hub_update.py pack)
+        
+        Stages the image row by row in the hub's flash, then lets the hub
+        check and install it. The hub resets into the new firmware and keeps
+        its settings and I2C address.
+        
+        Args:
+            path (str): Image file on the Pico's file system
+            retries (int): Attempts per row if the hub reports a bad CRC
+            timeout_ms (int): Time the hub may take to check, install and reset
+        """
+        stats = self.read_stats()
+        size = os.stat(path)[6]
+        rows = size // REC_ROW_SIZE
+        if size % REC_ROW_SIZE or rows < 2:
+            raise Exception(f"{path} is not an update image")
+        if stats['boot_rows'] == 0:
+            raise Exception("Hub firmware has no updater")
+        if rows > stats['boot_rows']:
+            raise Exception(f"Image has {rows} rows, the hub stages at most {stats['boot_rows']}")
+        
+        self.command(CMD_BOOT_BEGIN, struct.pack('<H', rows))
+        try:
+            with open(path, 'rb') as f:
+                for index in range(rows):
+                    row = f.read(REC_ROW_SIZE)
+                    frame = struct.pack('<HH', index, _crc16_ccitt(row)) + row
+                    for attempt in range(retries):
+                        self._write_mem(stats['rec_base'], frame)
+                        try:
+                            self.command(CMD_BOOT_WRITE)
+                            break
+                        except Exception:
+                            if attempt == retries - 1:
+                                raise
+        except Exception:
+            self._abort_update()
+            raise
+        
+        # No answer while the hub installs and resets; a rejected image keeps
+        # the old firmware running and ends the update, unless rows were
+        # missing
+        self._write_mem(REG_CTRL_CMD, bytes([CMD_BOOT_COMMIT, 0]))
+        start = time.ticks_ms()
+        while time.ticks_diff(time.ticks_ms(), start) < timeout_ms:
+            time.sleep_ms(100)
+            try:
+                pending, result = self._read_mem(REG_CTRL_CMD, 2)
+                state = self.read_stats()['boot_state']
+            except OSError:
+                continue
+            if pending:
+                continue
+            if result:
+                if state == BOOT_RECEIVING:
+                    self._abort_update()
+                raise Exception(f"Image rejected: {RESULT_NAMES.get(result, result)}")
+            self._read_info()
+            return
+        raise Exception("Hub did not come back after the update")
+    
+    def _abort_update(self):
+        """End an open firmware update so the hub scans again, best effort"""
+        try:
+            self.command(CMD_BOOT_ABORT)
+        except Exception:
+            pass
+    
+    def read_field(self, value_name):
+        """
+        Read one value type of all sensors from its per-field window
+        
+        Args:
+            value_name (str): One of config['value_names'], e.g. 'DiffCount'
+        
+        Returns:
+            list: Values in the hub's sensor order
+        """
+        if not self.is_available:
+            raise Exception("Sensor not available")
+        if self.info is None:
+            raise Exception("Register map info not available")
+        
+        field = self.config['value_names'].index(value_name)
+        num_sensors = self.info['num_sensors']
+        subaddr = self.info['field_base'] + field * self.info['field_stride']
+        return list(struct.unpack(f'<{num_sensors}H', self._read_mem(subaddr, 2 * num_sensors)))
+    
     def get_raw_data(self):
         """
         Get only the raw count values from all sensors.
@@ -240,11 +1094,116 @@ class CapsenseReader:
                     
             except Exception as e:
                 print(f"Error reading sample {i+1}: {e}")
+
+class SyncLine:
+    """Drives the shared SYNC line of several hubs (falling edge starts a scan)"""
+    
+    def __init__(self, pin=6):
+        self.pin = Pin(pin, Pin.OPEN_DRAIN, value=1)
+    
+    def start(self, readers, epoch=0):
+        """Put all hubs into sync mode with the same epoch"""
+        for reader in readers:
+            reader.set_mode(MODE_SYNC)
+            reader.set_epoch(epoch)
+    
+    def pulse(self):
+        """Start one synchronized scan on all hubs"""
+        self.pin.value(0)
+        time.sleep_us(10)
+        self.pin.value(1)
+
+class SpiStreamReader:
+    """
+    Reads every frame from the SPI frame stream of a hub (SPI mode 0).
+    The hub queues a few frames; call read_frames() at least that often per
+    frame period, e.g. from a timer, so none are dropped.
+    """
+    
+    def __init__(self, reader, spi_id=0, sck_pin=18, mosi_pin=19, miso_pin=16,
+                 cs_pin=17, baudrate=4000000):
+        """
+        Args:
+            reader (CapsenseReader): I2C reader of the same hub, for the frame size
+            baudrate (int): SPI clock, a few MHz
+        """
+        self.frame_size = reader.read_stats()['spi_frame']
+        if not self.frame_size:
+            raise RuntimeError("Hub firmware has no SPI stream")
+        self.spi = SPI(spi_id, baudrate=baudrate, polarity=0, phase=0,
+                       sck=Pin(sck_pin), mosi=Pin(mosi_pin), miso=Pin(miso_pin))
+        self.cs = Pin(cs_pin, Pin.OUT, value=1)
+        self.buffer = bytearray(self.frame_size)
+        self.header_size = struct.calcsize(SPI_HEADER_FORMAT)
+        self.crc_errors = 0
+        self.lost = 0
+    
+    def read_frame(self):
+        """
+        Read one frame
+        
+        Returns:
+            dict: seq, flags, mode, lost (frames the hub dropped before this
+                  one) and the rawcount, diffcount and baseline lists, or None
+                  if no frame was waiting or the frame was damaged
+        """
+        self.cs.value(0)
+        self.spi.readinto(self.buffer)
+        self.cs.value(1)
+        # Give the hub time to load the next frame before the next read
+        time.sleep_us(20)
+        
+        magic, kind, n, seq, flags, lost, mode = struct.unpack_from(SPI_HEADER_FORMAT, self.buffer)
+        crc_offset = self.header_size + 6 * n
+        if magic != SPI_MAGIC or crc_offset + 2 > self.frame_size:
+            self.crc_errors += 1
+            return None
+        crc = struct.unpack_from('<H', self.buffer, crc_offset)[0]
+        if crc != _crc16_ccitt(memoryview(self.buffer)[:crc_offset]):
+            self.crc_errors += 1
+            return None
+        if kind != SPI_FRAME:
+            return None
+        
+        values = struct.unpack_from('<%dH' % (3 * n), self.buffer, self.header_size)
+        self.lost += lost
+        return {'seq': seq, 'flags': flags, 'mode': mode, 'lost': lost,
+                'rawcount': list(values[0:n]), 'diffcount': list(values[n:2 * n]),
+                'baseline': list(values[2 * n:3 * n])}
+    
+    def read_frames(self, limit=64):
+        """Read all queued frames, oldest first"""
+        frames = []
+        while len(frames) < limit:
+            frame = self.read_frame()
+            if frame is None:
+                break
+            frames.append(frame)
+        return frames
+
+def _crc16_ccitt(data):
+    """CRC-16/CCITT (poly 0x1021, init 0xFFFF) of an update row or SPI frame, as in the hub"""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
 # Convenience functions
 def create_capsense_reader(scl_pin=3, sda_pin=2, freq=40000, config=None, i2c_instance=None):
     """Create capsense reader with optional custom configuration"""
     return CapsenseReader(scl_pin, sda_pin, freq, config, i2c_instance)
 
+def create_capsense_readers(i2c_instance, config=None, addresses=HUB_DATA_ADDRESSES):
+    """Create one reader for every Sensor Hub found on the bus (see CapsenseReader.discover)"""
+    readers = []
+    for addr in CapsenseReader.discover(i2c_instance, addresses):
+        hub_config = config.copy() if config else DEFAULT_CONFIG.copy()
+        hub_config['sensor_address'] = addr
+        readers.append(CapsenseReader(config=hub_config, i2c_instance=i2c_instance))
+    return readers
+
 def create_custom_config(sensor_names, value_names=['RawCount', 'DiffCount'], sensor_address=0x09):
     """
     Create custom sensor configuration
@@ -259,7 +1218,7 @@ def create_custom_config(sensor_names, value_names=['RawCount', 'DiffCount'], se
     """
     return {
         'sensor_address': sensor_address,
-        'register': 0x00,
+        'register': REG_FIELD,
         'num_sensors': len(sensor_names),
         'values_per_sensor': len(value_names),
         'value_size': 2,
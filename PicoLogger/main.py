@@ -53,6 +53,11 @@ VCC_PIN_1 = Pin(28, Pin.OUT)
 VCC_PIN_1.on()
 print("VCC pins 28 set high for power supply")
 
+# Power the capsense board only around each sample. Prepare the hub once
+# with capsense_reader.set_power_gated() while its sensors are at rest.
+POWER_GATED = False
+capsense_ready_ms = None
+
 # Initialize hardware with basic error handling
 try:
     i2c = I2C(0, scl=Pin(5), sda=Pin(4), freq=10000)    # I2C0 for BME280
@@ -64,6 +69,9 @@ except Exception as e:
     print(f"Sensor init error: {e}")
     capsense_reader = None
 
+if POWER_GATED and capsense_reader:
+    VCC_PIN_1.off()
+
 
 
 # Create logs directory
@@ -263,10 +271,14 @@ def getBMEdata():
 
 def get_capsense_data():
     """Get capsense data with error handling"""
+    global capsense_ready_ms
     if capsense_reader is None:
         return "NO_SENSOR," * 11 + "NO_SENSOR"  # 12 values
     
     try:
+        if POWER_GATED:
+            VCC_PIN_1.on()
+            capsense_ready_ms = capsense_reader.wait_ready()
         capsense_csv = capsense_reader.get_csv_string()
         if capsense_csv:
             return capsense_csv
@@ -275,6 +287,9 @@ def get_capsense_data():
     except Exception as e:
         print(f"Capsense error: {e}")
         return "ERROR," * 11 + "ERROR"
+    finally:
+        if POWER_GATED:
+            VCC_PIN_1.off()
 
 async def record_batch_data(duration, sample_rate, label, clock_time, start_date):
     """Record 4 batches of data asynchronously."""
@@ -443,6 +458,8 @@ async def execute_logging(duration, sample_rate, label, clock_time, start_date):
                 # Only print every 10th sample to reduce overhead
                 if i % 10 == 0 or i < 3:
                     print(f"Logging sample {i+1}/{total_samples}...")
+                    if POWER_GATED and capsense_ready_ms is not None:
+                        print(f"Capsense power-on to ready: {capsense_ready_ms} ms")
 
                 # Get sensor data
                 temperature, humidity, pressure = getBMEdata()
@@ -0,0 +1,838 @@
+/*******************************************************************************
+* File Name:   hub_trace.cpp
+*
+* Description: Event trace tool for the Sensor Hub (Linux host).
+*
+* Starts the firmware event trace over I2C, reads the trace ring back and
+* converts it to the Chrome trace format, which chrome://tracing and
+* https://ui.perfetto.dev display as a timeline (see Code/SELF_CAP/hub_trace.h).
+* Needs only a C++17 compiler and an I2C bus device (/dev/i2c-N); build with
+* "make -C Tools".
+*
+* Usage:
+*   hub_trace start --bus 1 --addr 0x09
+*   hub_trace start --late-us 15000          stop at the first frame > 15 ms
+*   hub_trace read trace.json --wait 60      wait for that frame, then read
+*   hub_trace read trace.json --raw trace.bin
+*   hub_trace convert trace.bin trace.json
+*
+* The timeline has one row each for the main loop tasks and CPU sleep, the
+* interrupt handlers, the frame scans and the host's I2C transactions. Task
+* names follow the task table of main.c; pass --tasks for a build with a
+* different table. Interrupts are named by their IRQ number, --irq 8=EZI2C
+* names them.
+*
+* Raw trace file (written by --raw and by the PicoLogger's save_trace()):
+*   header: "HTRC", CPU clock in MHz, reserved, ring depth, events recorded
+*   events: 32-bit little-endian, oldest first
+*
+*******************************************************************************/
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/i2c-dev.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace
+{
+
+/* Register map (Code/SELF_CAP/hub_regmap.h) */
+constexpr uint16_t REG_CTRL_CMD = 0x0008;
+constexpr uint16_t REG_INFO = 0x0020;
+constexpr uint16_t REG_STATS = 0x0040;
+constexpr uint16_t REGMAP_MAGIC = 0x5348;
+constexpr uint8_t REGMAP_MIN_VERSION = 25;
+constexpr uint16_t STATS_REC_BASE = REG_STATS + 0x30;
+constexpr uint16_t STATS_TRACE = REG_STATS + 0x70;	/* state, CPU MHz, depth, events recorded */
+constexpr uint8_t CMD_TRACE = 0x24;
+constexpr uint8_t CMD_TRACE_READ = 0x25;
+constexpr uint8_t RESULT_OK = 0;
+const char *const RESULT_NAMES[] = {"OK", "BAD_CMD", "BAD_ARG", "FAILED"};
+
+constexpr uint8_t TRACE_OFF = 0;
+constexpr uint8_t TRACE_RUNNING = 1;
+constexpr uint8_t TRACE_ARMED = 2;
+constexpr uint32_t TRACE_CHUNK = 32;	/* events per record window */
+
+constexpr char RAW_MAGIC[4] = {'H', 'T', 'R', 'C'};
+constexpr size_t RAW_HEADER_SIZE = 12;	/* magic, MHz, reserved, depth (u16), events recorded (u32) */
+
+/* Event codes, bits 31..24 (hub_trace.h) */
+constexpr uint32_t EV_SCAN_START = 0x01;
+constexpr uint32_t EV_SCAN_END = 0x02;
+constexpr uint32_t EV_PUBLISH = 0x03;
+constexpr uint32_t EV_I2C_START = 0x04;
+constexpr uint32_t EV_I2C_STOP = 0x05;
+constexpr uint32_t EV_SLEEP = 0x06;
+constexpr uint32_t EV_WAKE = 0x07;
+constexpr uint32_t EV_WRAP = 0x08;
+constexpr uint32_t EV_LATE = 0x09;
+constexpr uint32_t EV_TASK_BEGIN = 0x10;
+constexpr uint32_t EV_TASK_END = 0x20;
+constexpr uint32_t EV_ISR_ENTER = 0x40;
+constexpr uint32_t EV_ISR_EXIT = 0x80;
+
+constexpr uint32_t SYSTICK_MAX = 0xFFFFFF;
+const char *const DEFAULT_TASKS = "recover,tune,frame,command,bist,trigger,uart,rec";
+
+enum Track { TID_LOOP = 1, TID_IRQ, TID_SCAN, TID_I2C };
+const std::map<int, std::string> TRACK_NAMES = {
+	{TID_LOOP, "main loop"}, {TID_IRQ, "interrupts"}, {TID_SCAN, "CAPSENSE scan"}, {TID_I2C, "I2C"},
+};
+
+struct Options
+{
+	std::string action;
+	std::vector<std::string> files;
+	int bus = 1;
+	int addr = 0x09;
+	uint32_t late_us = 0;
+	double wait = 0.0;
+	unsigned mhz = 0;
+	std::string tasks = DEFAULT_TASKS;
+	std::map<int, std::string> irqs;
+	std::string raw;
+};
+
+struct Trace
+{
+	unsigned mhz = 0;
+	uint16_t depth = 0;
+	uint32_t count = 0;
+	std::vector<uint32_t> events;
+};
+
+[[noreturn]] void fail(const std::string &msg)
+{
+	throw std::runtime_error(msg);
+}
+
+std::string result_name(uint8_t result)
+{
+	return (result < 4) ? RESULT_NAMES[result] : std::to_string(result);
+}
+
+std::string hex(unsigned value, int width)
+{
+	char buf[16];
+	std::snprintf(buf, sizeof(buf), "0x%0*X", width, value);
+	return buf;
+}
+
+uint16_t get16(const uint8_t *p)
+{
+	return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t get32(const uint8_t *p)
+{
+	return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+		   (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void put16(std::vector<uint8_t> &out, uint16_t v)
+{
+	out.push_back(static_cast<uint8_t>(v));
+	out.push_back(static_cast<uint8_t>(v >> 8));
+}
+
+void put32(std::vector<uint8_t> &out, uint32_t v)
+{
+	put16(out, static_cast<uint16_t>(v));
+	put16(out, static_cast<uint16_t>(v >> 16));
+}
+
+/* ---------------------------------------------------------------------------
+ * Conversion
+ * ------------------------------------------------------------------------ */
+
+/* Continuous cycle counts of the events. SysTick counts down and wraps every
+ * 2^24 cycles. A wrap shows either as a WRAP event or as a cycle count below
+ * the one of the previous event, whichever comes first: events of handlers
+ * that ran before the SysTick interrupt already carry the new wrap.
+ */
+std::vector<uint64_t> timestamps(const std::vector<uint32_t> &events)
+{
+	std::vector<uint64_t> out;
+	uint64_t wraps = 0;
+	uint32_t last = 0;
+	bool have_last = false;
+	bool counted = false;
+
+	out.reserve(events.size());
+	for(uint32_t event : events)
+	{
+		uint32_t cycles = SYSTICK_MAX - (event & SYSTICK_MAX);
+
+		if((event >> 24) == EV_WRAP)
+		{
+			if(counted)
+			{
+				counted = false;
+			}
+			else
+			{
+				wraps++;
+			}
+		}
+		else if(have_last && (cycles < last))
+		{
+			wraps++;
+			counted = true;
+		}
+		last = cycles;
+		have_last = true;
+		out.push_back((wraps << 24) + cycles);
+	}
+	return out;
+}
+
+std::string event_name(uint32_t code, const std::vector<std::string> &tasks, const std::map<int, std::string> &irqs)
+{
+	if(code >= EV_ISR_ENTER)
+	{
+		int irq = static_cast<int>(code & 0x3F) - 16;
+		auto it = irqs.find(irq);
+
+		if(it != irqs.end())
+		{
+			return it->second;
+		}
+		return (irq == -1) ? "SysTick" : "IRQ " + std::to_string(irq);
+	}
+	uint32_t index = code & 0x0F;
+	return (index < tasks.size()) ? tasks[index] : "task " + std::to_string(index);
+}
+
+std::string json_string(const std::string &s)
+{
+	std::string out = "\"";
+
+	for(char c : s)
+	{
+		if((c == '"') || (c == '\\'))
+		{
+			out += '\\';
+			out += c;
+		}
+		else if(static_cast<unsigned char>(c) < 0x20)
+		{
+			char buf[8];
+			std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+			out += buf;
+		}
+		else
+		{
+			out += c;
+		}
+	}
+	return out + "\"";
+}
+
+/* Chrome trace event list of the raw events, one JSON object per entry */
+class ChromeWriter
+{
+public:
+	explicit ChromeWriter(std::vector<std::string> &out) : out_(out)
+	{
+		for(const auto &track : TRACK_NAMES)
+		{
+			out_.push_back("{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " +
+						   std::to_string(track.first) + ", \"args\": {\"name\": " + json_string(track.second) + "}}");
+		}
+	}
+
+	void at(double ts)
+	{
+		ts_ = ts;
+	}
+
+	void begin(int tid, const std::string &name, bool nests = true)
+	{
+		if(!nests && !open_[tid].empty())
+		{
+			end(tid);
+		}
+		open_[tid].push_back(name);
+		span("B", tid, name);
+	}
+
+	/* Spans that began before the oldest event in the ring are dropped */
+	void end(int tid)
+	{
+		if(!open_[tid].empty())
+		{
+			span("E", tid, open_[tid].back());
+			open_[tid].pop_back();
+		}
+	}
+
+	void instant(int tid, const std::string &name, const char *scope = "t")
+	{
+		out_.push_back("{\"name\": " + json_string(name) + ", \"ph\": \"i\", \"s\": \"" + scope +
+					   "\", \"ts\": " + number(ts_) + ", \"pid\": 0, \"tid\": " + std::to_string(tid) + "}");
+	}
+
+	/* Closes what was still running when the trace stopped */
+	void close_all()
+	{
+		for(const auto &track : TRACK_NAMES)
+		{
+			while(!open_[track.first].empty())
+			{
+				end(track.first);
+			}
+		}
+	}
+
+private:
+	static std::string number(double v)
+	{
+		std::ostringstream s;
+		s.precision(12);
+		s << v;
+		return s.str();
+	}
+
+	void span(const char *ph, int tid, const std::string &name)
+	{
+		out_.push_back("{\"name\": " + json_string(name) + ", \"ph\": \"" + ph + "\", \"ts\": " + number(ts_) +
+					   ", \"pid\": 0, \"tid\": " + std::to_string(tid) + "}");
+	}
+
+	std::vector<std::string> &out_;
+	std::map<int, std::vector<std::string>> open_;
+	double ts_ = 0.0;
+};
+
+std::vector<std::string> to_chrome(std::vector<uint32_t> events, unsigned mhz,
+								   const std::vector<std::string> &tasks, const std::map<int, std::string> &irqs)
+{
+	std::vector<std::string> out;
+	ChromeWriter w(out);
+
+	events.erase(std::remove(events.begin(), events.end(), 0u), events.end());
+	if(events.empty())
+	{
+		return out;
+	}
+
+	std::vector<uint64_t> cycles = timestamps(events);
+	uint64_t t0 = cycles[0];
+
+	for(size_t i = 0; i < events.size(); i++)
+	{
+		uint32_t code = events[i] >> 24;
+
+		w.at(static_cast<double>(cycles[i] - t0) / mhz);
+		if(code >= EV_ISR_EXIT)
+		{
+			w.end(TID_IRQ);
+		}
+		else if(code >= EV_ISR_ENTER)
+		{
+			w.begin(TID_IRQ, event_name(code, tasks, irqs));
+		}
+		else if(code >= EV_TASK_END)
+		{
+			w.end(TID_LOOP);
+		}
+		else if(code >= EV_TASK_BEGIN)
+		{
+			w.begin(TID_LOOP, event_name(code, tasks, irqs), false);
+		}
+		else if(code == EV_SLEEP)
+		{
+			w.begin(TID_LOOP, "sleep", false);
+		}
+		else if(code == EV_WAKE)
+		{
+			w.end(TID_LOOP);
+		}
+		else if(code == EV_SCAN_START)
+		{
+			w.begin(TID_SCAN, "scan", false);
+		}
+		else if(code == EV_SCAN_END)
+		{
+			w.end(TID_SCAN);
+		}
+		else if(code == EV_I2C_START)
+		{
+			/* A repeated start ends the previous part of the transaction */
+			w.begin(TID_I2C, "transaction", false);
+		}
+		else if(code == EV_I2C_STOP)
+		{
+			w.end(TID_I2C);
+		}
+		else if(code == EV_PUBLISH)
+		{
+			w.instant(TID_LOOP, "publish");
+		}
+		else if(code == EV_LATE)
+		{
+			w.instant(TID_LOOP, "late frame", "g");
+		}
+	}
+	w.close_all();
+	return out;
+}
+
+std::vector<std::string> split(const std::string &s, char sep)
+{
+	std::vector<std::string> out;
+	std::stringstream in(s);
+	std::string item;
+
+	while(std::getline(in, item, sep))
+	{
+		out.push_back(item);
+	}
+	return out;
+}
+
+void write_chrome(const std::string &path, const std::vector<uint32_t> &events, unsigned mhz, const Options &opt)
+{
+	if(mhz == 0)
+	{
+		fail("CPU clock unknown, pass --mhz");
+	}
+
+	std::vector<std::string> entries = to_chrome(events, mhz, split(opt.tasks, ','), opt.irqs);
+	size_t recorded = events.size() - std::count(events.begin(), events.end(), 0u);
+	std::ofstream f(path);
+
+	if(!f)
+	{
+		fail(path + ": cannot write");
+	}
+	f << "{\"traceEvents\": [";
+	for(size_t i = 0; i < entries.size(); i++)
+	{
+		f << (i ? ", " : "") << entries[i];
+	}
+	f << "], \"displayTimeUnit\": \"ns\", \"otherData\": {\"cpu_mhz\": " << mhz << ", \"events\": " << recorded
+	  << "}}";
+	if(!f)
+	{
+		fail(path + ": write failed");
+	}
+	std::printf("%s: %zu events\n", path.c_str(), recorded);
+}
+
+Trace read_raw(const std::string &path)
+{
+	std::ifstream f(path, std::ios::binary);
+
+	if(!f)
+	{
+		fail(path + ": cannot read");
+	}
+
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+	Trace t;
+
+	if((data.size() < RAW_HEADER_SIZE) || (std::memcmp(data.data(), RAW_MAGIC, 4) != 0) ||
+	   ((data.size() - RAW_HEADER_SIZE) % 4))
+	{
+		fail(path + ": not a raw trace file");
+	}
+	t.mhz = data[4];
+	t.depth = get16(&data[6]);
+	t.count = get32(&data[8]);
+	for(size_t i = RAW_HEADER_SIZE; i < data.size(); i += 4)
+	{
+		t.events.push_back(get32(&data[i]));
+	}
+	return t;
+}
+
+void write_raw(const std::string &path, const Trace &t)
+{
+	std::vector<uint8_t> data(RAW_MAGIC, RAW_MAGIC + 4);
+
+	data.push_back(static_cast<uint8_t>(t.mhz));
+	data.push_back(0);
+	put16(data, t.depth);
+	put32(data, t.count);
+	for(uint32_t event : t.events)
+	{
+		put32(data, event);
+	}
+
+	std::ofstream f(path, std::ios::binary);
+	f.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+	if(!f)
+	{
+		fail(path + ": write failed");
+	}
+}
+
+/* ---------------------------------------------------------------------------
+ * Hub access
+ * ------------------------------------------------------------------------ */
+
+/* Register map access through /dev/i2c-N (16-bit sub-addresses) */
+class Hub
+{
+public:
+	Hub(int bus, int addr) : addr_(addr)
+	{
+		std::string dev = "/dev/i2c-" + std::to_string(bus);
+
+		fd_ = ::open(dev.c_str(), O_RDWR);
+		if(fd_ < 0)
+		{
+			fail(dev + ": " + std::strerror(errno));
+		}
+		if(::ioctl(fd_, I2C_SLAVE, addr) < 0)
+		{
+			std::string msg = dev + ": " + std::strerror(errno);
+			::close(fd_);
+			fail(msg);
+		}
+	}
+
+	~Hub()
+	{
+		::close(fd_);
+	}
+
+	Hub(const Hub &) = delete;
+	Hub &operator=(const Hub &) = delete;
+
+	int addr() const
+	{
+		return addr_;
+	}
+
+	void write(uint16_t subaddr, const std::vector<uint8_t> &data)
+	{
+		std::vector<uint8_t> buf = {static_cast<uint8_t>(subaddr >> 8), static_cast<uint8_t>(subaddr)};
+
+		buf.insert(buf.end(), data.begin(), data.end());
+		if(::write(fd_, buf.data(), buf.size()) != static_cast<ssize_t>(buf.size()))
+		{
+			fail(std::string("I2C write: ") + std::strerror(errno));
+		}
+	}
+
+	std::vector<uint8_t> read(uint16_t subaddr, size_t n)
+	{
+		std::vector<uint8_t> buf(n);
+
+		write(subaddr, {});
+		if(::read(fd_, buf.data(), n) != static_cast<ssize_t>(n))
+		{
+			fail(std::string("I2C read: ") + std::strerror(errno));
+		}
+		return buf;
+	}
+
+	/* Runs a command, throws on a result other than OK */
+	void command(uint8_t cmd, const std::vector<uint8_t> &args = {}, double timeout = 1.0)
+	{
+		std::vector<uint8_t> frame = {cmd, 0};
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+
+		frame.insert(frame.end(), args.begin(), args.end());
+		write(REG_CTRL_CMD, frame);
+		while(std::chrono::steady_clock::now() < deadline)
+		{
+			std::vector<uint8_t> r = read(REG_CTRL_CMD, 2);
+
+			if(r[0] == 0)
+			{
+				if(r[1] != RESULT_OK)
+				{
+					fail("command " + hex(cmd, 2) + ": " + result_name(r[1]));
+				}
+				return;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		fail("command " + hex(cmd, 2) + " timed out");
+	}
+
+	/* State, CPU MHz, depth and events recorded of the trace */
+	uint8_t trace_stats(Trace &t)
+	{
+		std::vector<uint8_t> info = read(REG_INFO, 3);
+		uint16_t magic = get16(&info[0]);
+
+		if((magic != REGMAP_MAGIC) || (info[2] < REGMAP_MIN_VERSION))
+		{
+			fail("no hub with the event trace (magic " + hex(magic, 4) + ", version " + std::to_string(info[2]) + ")");
+		}
+
+		std::vector<uint8_t> s = read(STATS_TRACE, 8);
+
+		t.mhz = s[1];
+		t.depth = get16(&s[2]);
+		t.count = get32(&s[4]);
+		if(t.depth == 0)
+		{
+			fail("firmware built without the event trace (HUB_TRACE_ENABLE = 0)");
+		}
+		return s[0];
+	}
+
+private:
+	int fd_;
+	int addr_;
+};
+
+void start(const Options &opt)
+{
+	Hub hub(opt.bus, opt.addr);
+	Trace t;
+	uint8_t state = (opt.late_us != 0) ? TRACE_ARMED : TRACE_RUNNING;
+	std::vector<uint8_t> args = {state};
+
+	hub.trace_stats(t);
+	put32(args, opt.late_us);
+	hub.command(CMD_TRACE, args);
+	std::printf("%s\n", (opt.late_us != 0) ? "armed" : "recording");
+}
+
+void read(const Options &opt)
+{
+	Trace t;
+
+	try
+	{
+		Hub hub(opt.bus, opt.addr);
+		uint8_t state = hub.trace_stats(t);
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(opt.wait);
+
+		while((state == TRACE_ARMED) && (std::chrono::steady_clock::now() < deadline))
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			state = hub.trace_stats(t);
+		}
+		if(state == TRACE_ARMED)
+		{
+			std::fprintf(stderr, "no late frame yet, reading what was recorded\n");
+		}
+		if((state == TRACE_RUNNING) || (state == TRACE_ARMED))
+		{
+			hub.command(CMD_TRACE, {TRACE_OFF});
+			hub.trace_stats(t);
+		}
+
+		uint16_t rec_base = get16(hub.read(STATS_REC_BASE, 2).data());
+		uint32_t valid = (t.count < t.depth) ? t.count : t.depth;
+
+		for(uint32_t chunk = 0; chunk < (valid + TRACE_CHUNK - 1) / TRACE_CHUNK; chunk++)
+		{
+			std::vector<uint8_t> args;
+
+			put16(args, static_cast<uint16_t>(chunk));
+			hub.command(CMD_TRACE_READ, args);
+
+			std::vector<uint8_t> data = hub.read(static_cast<uint16_t>(rec_base + 4), 4 * TRACE_CHUNK);
+			for(uint32_t i = 0; i < TRACE_CHUNK; i++)
+			{
+				t.events.push_back(get32(&data[4 * i]));
+			}
+		}
+		t.events.resize(valid);
+	}
+	catch(const std::runtime_error &e)
+	{
+		fail(hex(static_cast<unsigned>(opt.addr), 2) + ": " + e.what());
+	}
+
+	if(t.count > t.depth)
+	{
+		std::fprintf(stderr, "%u older events were overwritten\n", t.count - t.depth);
+	}
+	if(!opt.raw.empty())
+	{
+		write_raw(opt.raw, t);
+	}
+	write_chrome(opt.files[0], t.events, opt.mhz ? opt.mhz : t.mhz, opt);
+}
+
+void convert(const Options &opt)
+{
+	Trace t = read_raw(opt.files[0]);
+
+	write_chrome(opt.files[1], t.events, opt.mhz ? opt.mhz : t.mhz, opt);
+}
+
+/* ---------------------------------------------------------------------------
+ * Command line
+ * ------------------------------------------------------------------------ */
+
+void usage(FILE *out)
+{
+	std::fprintf(out,
+		"usage: hub_trace start   [--bus N] [--addr A] [--late-us US]\n"
+		"       hub_trace read    JSON [--bus N] [--addr A] [--raw FILE] [--wait S] [chrome options]\n"
+		"       hub_trace convert RAW JSON [chrome options]\n"
+		"\n"
+		"  start    clear the trace ring and start recording; --late-us stops it at\n"
+		"           the first frame period above US, 0 = record until read\n"
+		"  read     stop the trace and write it as Chrome trace JSON; --raw also\n"
+		"           writes the raw events, --wait waits for an armed trace to trigger\n"
+		"  convert  convert a raw trace file to Chrome trace JSON\n"
+		"\n"
+		"  --bus N        I2C bus number (/dev/i2c-N), default 1\n"
+		"  --addr A       data address of the hub, default 0x09\n"
+		"chrome options:\n"
+		"  --mhz M        CPU clock, default as published by the hub\n"
+		"  --tasks LIST   task names in priority order, default %s\n"
+		"  --irq N=NAME   name of IRQ number N, may be repeated\n",
+		DEFAULT_TASKS);
+}
+
+long number_arg(const std::string &opt, const std::string &value)
+{
+	char *end = nullptr;
+	long v = std::strtol(value.c_str(), &end, 0);
+
+	if(value.empty() || (*end != '\0') || (v < 0))
+	{
+		fail(opt + ": not a number: " + value);
+	}
+	return v;
+}
+
+Options parse(int argc, char **argv)
+{
+	Options opt;
+
+	if(argc < 2)
+	{
+		usage(stderr);
+		std::exit(2);
+	}
+	opt.action = argv[1];
+	if((opt.action == "-h") || (opt.action == "--help"))
+	{
+		usage(stdout);
+		std::exit(0);
+	}
+	if((opt.action != "start") && (opt.action != "read") && (opt.action != "convert"))
+	{
+		fail("unknown action " + opt.action);
+	}
+
+	bool hub_opts = (opt.action != "convert");
+	bool chrome_opts = (opt.action != "start");
+
+	for(int i = 2; i < argc; i++)
+	{
+		std::string a = argv[i];
+		auto value = [&]() -> std::string
+		{
+			if(i + 1 >= argc)
+			{
+				fail(a + " needs a value");
+			}
+			return argv[++i];
+		};
+
+		if(hub_opts && (a == "--bus"))
+		{
+			opt.bus = static_cast<int>(number_arg(a, value()));
+		}
+		else if(hub_opts && (a == "--addr"))
+		{
+			opt.addr = static_cast<int>(number_arg(a, value()));
+		}
+		else if((opt.action == "start") && (a == "--late-us"))
+		{
+			opt.late_us = static_cast<uint32_t>(number_arg(a, value()));
+		}
+		else if((opt.action == "read") && (a == "--raw"))
+		{
+			opt.raw = value();
+		}
+		else if((opt.action == "read") && (a == "--wait"))
+		{
+			opt.wait = std::strtod(value().c_str(), nullptr);
+		}
+		else if(chrome_opts && (a == "--mhz"))
+		{
+			opt.mhz = static_cast<unsigned>(number_arg(a, value()));
+		}
+		else if(chrome_opts && (a == "--tasks"))
+		{
+			opt.tasks = value();
+		}
+		else if(chrome_opts && (a == "--irq"))
+		{
+			std::string item = value();
+			size_t eq = item.find('=');
+
+			if(eq == std::string::npos)
+			{
+				fail("--irq expects N=NAME");
+			}
+			opt.irqs[static_cast<int>(std::strtol(item.substr(0, eq).c_str(), nullptr, 0))] = item.substr(eq + 1);
+		}
+		else if((a.size() > 1) && (a[0] == '-'))
+		{
+			fail("unknown option " + a);
+		}
+		else
+		{
+			opt.files.push_back(a);
+		}
+	}
+
+	size_t files = (opt.action == "start") ? 0 : (opt.action == "read") ? 1 : 2;
+	if(opt.files.size() != files)
+	{
+		usage(stderr);
+		std::exit(2);
+	}
+	return opt;
+}
+
+} /* namespace */
+
+int main(int argc, char **argv)
+{
+	try
+	{
+		Options opt = parse(argc, argv);
+
+		if(opt.action == "start")
+		{
+			start(opt);
+		}
+		else if(opt.action == "read")
+		{
+			read(opt);
+		}
+		else
+		{
+			convert(opt);
+		}
+	}
+	catch(const std::exception &e)
+	{
+		std::fprintf(stderr, "hub_trace: %s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,350 @@
+#!/usr/bin/env python3
+"""
+Firmware update tool for the Sensor Hub (Linux host)
+
+Makes signed update images from the firmware ELF file and uploads them over
+I2C into hubs that already run a firmware with the updater (see
+Code/*/hub_boot.h). Needs only the Python 3 standard library and an I2C bus
+device (/dev/i2c-N); run the bus at 400 kHz for the fastest transfer, e.g.
+dtparam=i2c_arm_baudrate=400000 on a Raspberry Pi.
+
+Usage:
+    hub_update.py keygen fleet.key Code/SELF_CAP/hub_boot_key.h Code/MUTUAL_CAP/hub_boot_key.h
+    hub_update.py pack fleet.key build/APP_.../Debug/SELF_CAP.elf SELF_CAP.hubimg
+    hub_update.py flash SELF_CAP.hubimg --bus 1 --addr 0x09 0x0B
+
+The key file and the generated hub_boot_key.h are secrets: anyone who has
+them can sign images for your hubs. Keep them out of the repository.
+
+Image layout (one 128-byte flash row per line):
+    application flash from __hub_app_start up to the .cy_em_eeprom section
+    manifest: magic, size, CRC-32, settings address, recorder address and
+              size, application start, HMAC-SHA256 over the image and the
+              manifest
+
+The firmware has to be linked with hub_boot.ld (the Makefile does that when
+hub_boot_key.h exists). The resident loader below __hub_app_start and the
+boot area behind the application are never part of an image.
+"""
+
+import argparse
+import fcntl
+import hashlib
+import hmac
+import os
+import secrets
+import struct
+import sys
+import time
+import zlib
+
+ROW_SIZE = 128
+FLASH_SIZE = 0x10000
+EM_EEPROM_SECTION = '.cy_em_eeprom'
+BOOT_SECTION = '.hub_boot'
+APP_START_SYMBOL = '__hub_app_start'
+SETTINGS_SYMBOL = 'hub_settings_storage'
+RECORDER_SYMBOL = 'rec_storage'
+
+BOOT_MAGIC = 0x32425548
+MANIFEST_FORMAT = '<IIIIIII'
+MAC_SIZE = 32
+
+REG_INFO = 0x0020
+REG_STATS = 0x0040
+REG_CTRL_CMD = 0x0008
+REGMAP_MAGIC = 0x5348
+REGMAP_MIN_VERSION = 15
+STATS_REC_BASE = REG_STATS + 0x30
+STATS_BOOT = REG_STATS + 0x38
+CMD_BOOT_BEGIN = 0x1C
+CMD_BOOT_WRITE = 0x1D
+CMD_BOOT_COMMIT = 0x1E
+CMD_BOOT_ABORT = 0x26
+RESULT_OK = 0
+RESULT_BAD_ARG = 2
+BOOT_RECEIVING = 1
+RESULT_NAMES = {0: 'OK', 1: 'BAD_CMD', 2: 'BAD_ARG', 3: 'FAILED'}
+
+I2C_SLAVE = 0x0703
+
+
+def crc16_ccitt(data):
+    """CRC-16/CCITT (poly 0x1021, init 0xFFFF), as hub_crc16()"""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+# ---------------------------------------------------------------------------
+# Keys and images
+# ---------------------------------------------------------------------------
+
+def read_key(path):
+    with open(path) as f:
+        key = bytes.fromhex(f.read().strip())
+    if len(key) != 32:
+        raise SystemExit(f'{path}: expected 32 key bytes')
+    return key
+
+
+def keygen(args):
+    if os.path.exists(args.key):
+        raise SystemExit(f'{args.key} exists, not overwriting a fleet key')
+    key = secrets.token_bytes(32)
+    with open(args.key, 'w') as f:
+        f.write(key.hex() + '\n')
+    write_headers(key, args.headers)
+
+
+def write_headers(key, paths):
+    body = ', '.join(f'0x{b:02X}' for b in key)
+    for path in paths:
+        with open(path, 'w') as f:
+            f.write('/* Firmware update signing key, made by Tools/hub_update.py keygen.\n'
+                    ' * Secret: do not commit this file.\n */\n'
+                    f'#define HUB_BOOT_KEY\t{{ {body} }}\n')
+
+
+def header(args):
+    write_headers(read_key(args.key), args.headers)
+
+
+class Elf32:
+    """Just enough of an ELF32 little-endian reader for the firmware file"""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+        if self.data[:4] != b'\x7fELF' or self.data[4] != 1 or self.data[5] != 1:
+            raise SystemExit(f'{path}: not a 32-bit little-endian ELF file')
+        (self.phoff, self.shoff, _, _, self.phentsize, self.phnum,
+         self.shentsize, self.shnum, self.shstrndx) = struct.unpack_from('<IIIHHHHHH', self.data, 28)
+        self.sections = {}
+        names = self._section(self.shstrndx)
+        for i in range(self.shnum):
+            sh = self._section(i)
+            self.sections[self._string(names['offset'], sh['name'])] = sh
+
+    def _section(self, i):
+        name, stype, _, addr, offset, size, link = struct.unpack_from(
+            '<IIIIIII', self.data, self.shoff + i * self.shentsize)
+        return {'name': name, 'type': stype, 'addr': addr, 'offset': offset, 'size': size, 'link': link}
+
+    def _string(self, table, offset):
+        end = self.data.index(b'\0', table + offset)
+        return self.data[table + offset:end].decode()
+
+    def segments(self):
+        """(load address, bytes) of all PT_LOAD segments with file content"""
+        for i in range(self.phnum):
+            ptype, offset, _, paddr, filesz = struct.unpack_from(
+                '<IIIII', self.data, self.phoff + i * self.phentsize)
+            if ptype == 1 and filesz:
+                yield paddr, self.data[offset:offset + filesz]
+
+    def symbol(self, name):
+        """(value, size) of a symbol, also a file-local one"""
+        symtab = self.sections['.symtab']
+        strtab = self._section(symtab['link'])
+        for pos in range(symtab['offset'], symtab['offset'] + symtab['size'], 16):
+            st_name, value, size = struct.unpack_from('<III', self.data, pos)
+            if st_name and self._string(strtab['offset'], st_name) == name:
+                return value, size
+        return 0, 0
+
+
+def pack(args):
+    key = read_key(args.key)
+    elf = Elf32(args.elf)
+    if EM_EEPROM_SECTION not in elf.sections:
+        raise SystemExit(f'{args.elf}: no {EM_EEPROM_SECTION} section')
+    base, _ = elf.symbol(APP_START_SYMBOL)
+    if not base or BOOT_SECTION not in elf.sections:
+        raise SystemExit(f'{args.elf}: not linked with hub_boot.ld, no resident loader')
+    em = elf.sections[EM_EEPROM_SECTION]
+    em_start, em_end = em['addr'], em['addr'] + em['size']
+    boot = elf.sections[BOOT_SECTION]
+    boot_start, boot_end = boot['addr'], boot['addr'] + boot['size']
+
+    flash = bytearray(em_start - base)
+    for addr, data in elf.segments():
+        for pos in range(len(data)):
+            a = addr + pos
+            if a < base or boot_start <= a < boot_end:
+                continue
+            if a < em_start:
+                flash[a - base] = data[pos]
+            elif a >= em_end and a < args.flash_size:
+                raise SystemExit(f'flash content at 0x{a:05X} behind {EM_EEPROM_SECTION}, '
+                                 'the updater cannot install this image')
+    flash.extend(bytes(-len(flash) % ROW_SIZE))
+    image = bytes(flash)
+
+    settings_addr, _ = elf.symbol(SETTINGS_SYMBOL)
+    clear_addr, clear_size = elf.symbol(RECORDER_SYMBOL)
+    if not settings_addr:
+        print(f'warning: no {SETTINGS_SYMBOL}, the hub settings are not carried over', file=sys.stderr)
+    manifest = struct.pack(MANIFEST_FORMAT, BOOT_MAGIC, len(image), zlib.crc32(image),
+                           settings_addr, clear_addr, clear_size, base)
+    manifest += bytes(ROW_SIZE - MAC_SIZE - len(manifest))
+    manifest += hmac.new(key, image + manifest, hashlib.sha256).digest()
+
+    with open(args.image, 'wb') as f:
+        f.write(image + manifest)
+    print(f'{args.image}: {len(image) // ROW_SIZE + 1} rows, {len(image)} bytes application')
+
+
+# ---------------------------------------------------------------------------
+# Upload
+# ---------------------------------------------------------------------------
+
+class Hub:
+    """Register map access through /dev/i2c-N (16-bit sub-addresses)"""
+
+    def __init__(self, bus, addr):
+        self.addr = addr
+        self.fd = os.open(f'/dev/i2c-{bus}', os.O_RDWR)
+        fcntl.ioctl(self.fd, I2C_SLAVE, addr)
+
+    def close(self):
+        os.close(self.fd)
+
+    def write(self, subaddr, data):
+        os.write(self.fd, struct.pack('>H', subaddr) + bytes(data))
+
+    def read(self, subaddr, n):
+        os.write(self.fd, struct.pack('>H', subaddr))
+        return os.read(self.fd, n)
+
+    def command(self, cmd, args=b'', timeout=1.0):
+        """Runs a command, returns its result code"""
+        self.write(REG_CTRL_CMD, bytes([cmd, 0]) + bytes(args))
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            pending, result = self.read(REG_CTRL_CMD, 2)
+            if pending == 0:
+                return result
+            time.sleep(0.001)
+        raise TimeoutError(f'command 0x{cmd:02X} timed out')
+
+
+def abort(hub):
+    """Ends an open update so the hub scans again, best effort"""
+    try:
+        hub.command(CMD_BOOT_ABORT)
+    except (OSError, TimeoutError):
+        pass
+
+
+def upload(hub, image, retries=3):
+    magic, version = struct.unpack('<HB', hub.read(REG_INFO, 3))
+    if magic != REGMAP_MAGIC or version < REGMAP_MIN_VERSION:
+        raise RuntimeError('no Sensor Hub with a firmware update interface')
+    rec_base, = struct.unpack('<H', hub.read(STATS_REC_BASE, 2))
+    boot_rows, _ = struct.unpack('<HB', hub.read(STATS_BOOT, 3))
+    rows = len(image) // ROW_SIZE
+    if boot_rows == 0:
+        raise RuntimeError('the running firmware was built without the updater')
+    if rows > boot_rows:
+        raise RuntimeError(f'image has {rows} rows, the hub stages at most {boot_rows}')
+
+    result = hub.command(CMD_BOOT_BEGIN, struct.pack('<H', rows))
+    if result != RESULT_OK:
+        raise RuntimeError(f'BOOT_BEGIN: {RESULT_NAMES.get(result, result)}')
+
+    try:
+        start = time.monotonic()
+        for index in range(rows):
+            row = image[index * ROW_SIZE:(index + 1) * ROW_SIZE]
+            for attempt in range(retries):
+                hub.write(rec_base, struct.pack('<HH', index, crc16_ccitt(row)) + row)
+                result = hub.command(CMD_BOOT_WRITE)
+                if result == RESULT_OK:
+                    break
+                if result != RESULT_BAD_ARG or attempt == retries - 1:
+                    raise RuntimeError(f'row {index}: {RESULT_NAMES.get(result, result)}')
+            print(f'\r0x{hub.addr:02X}: {index + 1}/{rows} rows', end='', flush=True)
+        print(f' in {time.monotonic() - start:.1f} s')
+    except (RuntimeError, TimeoutError):
+        abort(hub)
+        raise
+
+    # The hub checks the image, installs it and resets; it only answers the
+    # command if the image was rejected, and is off the bus meanwhile
+    hub.write(REG_CTRL_CMD, bytes([CMD_BOOT_COMMIT, 0]))
+    deadline = time.monotonic() + 15.0
+    while time.monotonic() < deadline:
+        time.sleep(0.1)
+        try:
+            pending, result = hub.read(REG_CTRL_CMD, 2)
+            _, state = struct.unpack('<HB', hub.read(STATS_BOOT, 3))
+        except OSError:
+            continue
+        if pending:
+            continue
+        if result != RESULT_OK:
+            if state == BOOT_RECEIVING:
+                abort(hub)
+            raise RuntimeError(f'image rejected: {RESULT_NAMES.get(result, result)}')
+        return
+    raise RuntimeError('hub did not come back after the install')
+
+
+def flash(args):
+    with open(args.image, 'rb') as f:
+        image = f.read()
+    if len(image) % ROW_SIZE or len(image) < 2 * ROW_SIZE:
+        raise SystemExit(f'{args.image}: not an update image')
+    failed = 0
+    for addr in args.addr:
+        hub = Hub(args.bus, addr)
+        try:
+            upload(hub, image)
+            print(f'0x{addr:02X}: updated')
+        except (OSError, RuntimeError, TimeoutError) as e:
+            print(f'\n0x{addr:02X}: {e}', file=sys.stderr)
+            failed += 1
+        finally:
+            hub.close()
+    return 1 if failed else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    sub = parser.add_subparsers(dest='action', required=True)
+
+    p = sub.add_parser('keygen', help='make a new signing key and its firmware header')
+    p.add_argument('key')
+    p.add_argument('headers', nargs='*', help='hub_boot_key.h files to write')
+    p.set_defaults(func=keygen)
+
+    p = sub.add_parser('header', help='write hub_boot_key.h for an existing key')
+    p.add_argument('key')
+    p.add_argument('headers', nargs='+')
+    p.set_defaults(func=header)
+
+    p = sub.add_parser('pack', help='make a signed update image from a firmware ELF file')
+    p.add_argument('key')
+    p.add_argument('elf')
+    p.add_argument('image')
+    p.add_argument('--flash-size', type=lambda s: int(s, 0), default=FLASH_SIZE)
+    p.set_defaults(func=pack)
+
+    p = sub.add_parser('flash', help='upload an update image into one or more hubs')
+    p.add_argument('image')
+    p.add_argument('--bus', type=int, default=1, help='I2C bus number (/dev/i2c-N)')
+    p.add_argument('--addr', type=lambda s: int(s, 0), nargs='+', default=[0x09],
+                   help='data addresses of the hubs')
+    p.set_defaults(func=flash)
+
+    args = parser.parse_args()
+    sys.exit(args.func(args) or 0)
+
+
+if __name__ == '__main__':
+    main()